@@ -0,0 +1,13 @@
+#ifndef __WAVOS__COMMON__IOVEC_H
+#define __WAVOS__COMMON__IOVEC_H
+#include <common/types.h>
+
+// one segment of a vectored write
+typedef struct {
+    const char* base;
+    size_t len;
+} iovec_t;
+
+// the most segments a single writev takes
+#define IOV_MAX 64
+#endif
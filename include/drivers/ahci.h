@@ -0,0 +1,91 @@
+#ifndef __WAVOS__DRIVERS__AHCI_H
+#define __WAVOS__DRIVERS__AHCI_H
+#include <common/types.h>
+#include <drivers/blockdev.h>
+#include <multitasking.h>
+#include <spinlock.h>
+
+#define AHCI_MAX_PORTS 32
+#define AHCI_MAX_SLOTS 32
+#define AHCI_PRDT_ENTRIES 17 // a 64k transfer at any alignment
+#define AHCI_MAX_SECTORS 128 // per command
+#define AHCI_TABLE_SIZE 512 // a command table with its prdt, rounded to keep them aligned
+
+// a command slot's entry in the port's command list
+typedef struct {
+    uint16_t flags; // the fis length in dwords, write, ...
+    uint16_t prdtLength;
+    volatile uint32_t prdByteCount; // bytes moved, filled in by the hba
+    uint32_t tableBase; // 128 byte aligned
+    uint32_t tableBaseHigh;
+    uint32_t reserved[4];
+} __attribute__((packed)) ahci_cmd_header;
+
+typedef struct {
+    uint32_t address;
+    uint32_t addressHigh;
+    uint32_t reserved;
+    uint32_t byteCount; // bytes - 1, bit 31 asks for an interrupt
+} __attribute__((packed)) ahci_prd;
+
+typedef struct {
+    uint8_t commandFis[64];
+    uint8_t atapiCommand[16];
+    uint8_t reserved[48];
+    ahci_prd prdt[AHCI_PRDT_ENTRIES];
+} __attribute__((packed)) ahci_cmd_table;
+
+// a register fis from the host to the device
+typedef struct {
+    uint8_t type;
+    uint8_t flags; // bit 7 says it carries a command
+    uint8_t command;
+    uint8_t featureLow;
+    uint8_t lba0;
+    uint8_t lba1;
+    uint8_t lba2;
+    uint8_t device;
+    uint8_t lba3;
+    uint8_t lba4;
+    uint8_t lba5;
+    uint8_t featureHigh;
+    uint8_t countLow;
+    uint8_t countHigh;
+    uint8_t icc;
+    uint8_t control;
+    uint8_t reserved[4];
+} __attribute__((packed)) ahci_fis_h2d;
+
+// a port with a sata disk on it
+typedef struct {
+    block_device dev;
+    volatile uint32_t* regs;
+    uint32_t number;
+    bool present;
+
+    ahci_cmd_header* cmdList;
+    uint8_t* fis;
+    ahci_cmd_table* tables[AHCI_MAX_SLOTS];
+
+    char model[41];
+    uint64_t sectors;
+    bool lba48;
+    bool ncq;
+    uint32_t depth; // commands in flight at most, 1 without ncq
+
+    spinlock_t lock;
+    uint32_t busySlots; // handed out to callers
+    uint32_t busyCount;
+    uint32_t issuedSlots; // at the hba
+    uint32_t doneSlots; // finished, waiting for their caller
+    uint32_t failedSlots;
+    bool exclusive; // a non queued command owns the port
+    bool draining; // a non queued command waits for the queue to empty
+    volatile uint32_t irqStatus; // interrupt bits gathered by the top half
+    wait_queue_t waiters;
+} ahci_port;
+
+bool ahci_init(void);
+int ahci_disk_count(void);
+ahci_port* ahci_get_disk(int index);
+#endif
@@ -2,6 +2,13 @@
 #define __WAVOS__DRIVERS__ATA_H
 #include <common/types.h>
 
+// how data moves between the drive and memory, fastest last
+typedef enum {
+    ATA_MODE_PIO, // one data request per sector
+    ATA_MODE_PIO_MULTIPLE, // one data request per multipleSectors block
+    ATA_MODE_DMA, // the ide bus master moves the data
+} ata_transfer_mode;
+
 typedef struct ata_drive {
     // 16 bit port
     uint16_t dataPort;
@@ -16,14 +23,38 @@ typedef struct ata_drive {
     uint16_t controlPort;
     
     bool master;
+    // parsed from IDENTIFY
+    bool identified;
+    char model[41];
+    char serial[21];
+    uint32_t lba28Sectors;
+    uint64_t lba48Sectors;
+    uint64_t totalSectors; // whichever of the two the drive is addressed with
+    uint8_t maxMultiple; // the largest READ/WRITE MULTIPLE block, 0 if unsupported
+    uint8_t dmaModes; // bit n set if multiword dma mode n is supported
+    uint8_t udmaModes; // bit n set if ultra dma mode n is supported
+    bool lba48; // takes the EXT commands, 48 bit sectors and 16 bit counts
+    bool writeCache; // has a volatile write cache that needs flushing
+    bool flushExt; // has FLUSH CACHE EXT
+
+    // sectors moved per data request by READ/WRITE MULTIPLE, 0 if unsupported
+    uint8_t multipleSectors;
+    ata_transfer_mode mode;
+    uint16_t busMasterPort; // the channel's bus master registers, 0 without dma
 } ata_drive;
 
+#define ATA_MAX_SECTORS 256 // per lba28 command
+#define ATA_MAX_SECTORS_EXT 65536 // per lba48 command
 
 ata_drive create_ata(bool master, uint16_t portBase);
 
-void identify(ata_drive drive);
+void ata_identify_string(char* dest, uint16_t* data, int first, int words);
+bool identify(ata_drive* drive);
+bool ata_dma_init(ata_drive* drive);
+bool ata_read(ata_drive* drive, uint32_t* directory, uint64_t lba, uint32_t count, uint8_t* buff);
+bool ata_write(ata_drive* drive, uint32_t* directory, uint64_t lba, uint32_t count, const uint8_t* data);
 void read28(ata_drive drive, uint32_t sectorNum, uint8_t* buff, int count);
 void write28(ata_drive drive, uint32_t sectorNum, uint8_t *data, uint32_t count);
-void flush(ata_drive drive);
+bool flush(ata_drive drive);
 
 #endif
\ No newline at end of file
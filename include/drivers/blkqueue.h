@@ -0,0 +1,70 @@
+#ifndef __WAVOS__DRIVERS__BLKQUEUE_H
+#define __WAVOS__DRIVERS__BLKQUEUE_H
+#include <common/types.h>
+#include <drivers/ata.h>
+#include <drivers/blockdev.h>
+#include <multitasking.h>
+#include <spinlock.h>
+
+#define BLK_MAX_QUEUES 2
+#define BLK_MAX_SECTORS 128 // per merged request, the size of the bounce buffer
+#define BLK_MAX_WRITES 64 // queued writes before writers have to wait
+#define BLK_READ_EXPIRE_MS 500
+#define BLK_WRITE_EXPIRE_MS 5000
+#define BLK_WRITES_STARVED 8 // reads sent in a row while writes wait
+
+enum BLK_OPS {
+    BLK_OP_READ = 0,
+    BLK_OP_WRITE = 1,
+    BLK_OP_FLUSH = 2,
+};
+
+// one caller's part of a request
+typedef struct blk_bio {
+    struct blk_bio* next;
+    uint64_t lba;
+    uint32_t count;
+    uint8_t* buff;
+    uint32_t* directory; // the address space buff is in, the worker translates it there for dma
+    bool async; // a write the queue owns, freed with its data once done
+    volatile bool ok;
+    volatile bool done;
+} blk_bio;
+
+// adjacent bios of one op, sent to the drive as a single command
+typedef struct blk_request {
+    struct blk_request* next;
+    uint64_t lba;
+    uint32_t count;
+    uint8_t op;
+    uint32_t deadline; // in timer ticks
+    blk_bio* bios;
+    blk_bio* lastBio;
+} blk_request;
+
+typedef struct {
+    uint32_t submitted; // bios
+    uint32_t merged; // bios that joined a queued request
+    uint32_t dispatched; // commands sent to the drive
+    uint32_t expired; // requests dispatched because of their deadline
+    uint64_t seekDistance; // sum of the lba jumps between commands
+} blk_stats_t;
+
+typedef struct {
+    block_device dev; // how the filesystem reaches the queue
+    ata_drive drive;
+    spinlock_t lock;
+    blk_request* pending; // in arrival order
+    blk_request* active; // the request at the drive
+    uint32_t queuedWrites;
+    bool writeError; // an async write failed since the last flush
+    uint64_t head; // the sector after the last command, where c-look goes on from
+    int writesStarved;
+    wait_queue_t completed; // woken when requests finish
+    blk_stats_t stats;
+    uint8_t bounce[BLK_MAX_SECTORS * 512] __attribute__((aligned(16)));
+} blk_queue;
+
+block_device* blk_queue_init(ata_drive drive);
+blk_stats_t blk_get_stats(block_device* dev);
+#endif
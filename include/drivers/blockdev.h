@@ -0,0 +1,31 @@
+#ifndef __WAVOS__DRIVERS__BLOCKDEV_H
+#define __WAVOS__DRIVERS__BLOCKDEV_H
+#include <common/types.h>
+
+#define BLOCK_SECTOR_SIZE 512 // the sector size the filesystem code works in
+
+struct block_device;
+
+// what a driver implements to carry a filesystem, lba and count are in its sectors
+typedef struct {
+    bool (*read)(struct block_device* dev, uint64_t lba, uint32_t count, uint8_t* buff);
+    bool (*write)(struct block_device* dev, uint64_t lba, uint32_t count, const uint8_t* data);
+    bool (*flush)(struct block_device* dev);
+    uint32_t (*sector_size)(struct block_device* dev);
+    uint64_t (*capacity)(struct block_device* dev); // in sectors
+} block_device_ops;
+
+typedef struct block_device {
+    const char* name;
+    const block_device_ops* ops;
+    void* data; // the driver's state
+} block_device;
+
+bool bdev_read(block_device* dev, uint64_t lba, uint32_t count, uint8_t* buff);
+bool bdev_write(block_device* dev, uint64_t lba, uint32_t count, const uint8_t* data);
+bool bdev_flush(block_device* dev);
+uint32_t bdev_sector_size(block_device* dev);
+uint64_t bdev_capacity(block_device* dev);
+void bdev_read_sector(block_device* dev, uint32_t sectorNum, uint8_t* buff, int count);
+void bdev_write_sector(block_device* dev, uint32_t sectorNum, uint8_t* data, uint32_t count);
+#endif
@@ -0,0 +1,16 @@
+#ifndef __WAVOS__DRIVERS__RAMDISK_H
+#define __WAVOS__DRIVERS__RAMDISK_H
+#include <common/types.h>
+#include <drivers/blockdev.h>
+
+typedef struct {
+    block_device dev;
+    uint8_t* data;
+    uint32_t sectors;
+    bool owned; // the data was allocated by the ramdisk
+} ramdisk;
+
+block_device* ramdisk_create(uint32_t sectors);
+block_device* ramdisk_create_from(uint8_t* image, uint32_t sectors);
+void ramdisk_destroy(block_device* dev);
+#endif
@@ -0,0 +1,11 @@
+#ifndef __WAVOS__DRIVERS__SERIAL_H
+#define __WAVOS__DRIVERS__SERIAL_H
+#include <common/types.h>
+
+#define COM1_PORT 0x3F8
+
+bool serial_init(void);
+void serial_write(const char* data, size_t size);
+void serial_write_string(const char* data);
+void serial_write_int(uint32_t value, int base);
+#endif
@@ -0,0 +1,98 @@
+#ifndef __WAVOS__DRIVERS__VIRTIO_H
+#define __WAVOS__DRIVERS__VIRTIO_H
+#include <common/types.h>
+#include <hardwarecomms/pci.h>
+
+#define VIRTIO_VENDOR 0x1AF4
+
+// the legacy registers, in the io bar
+enum VIRTIO_REGS {
+    VIRTIO_REG_HOST_FEATURES = 0x00,
+    VIRTIO_REG_GUEST_FEATURES = 0x04,
+    VIRTIO_REG_QUEUE_ADDRESS = 0x08, // the queue's frame number
+    VIRTIO_REG_QUEUE_SIZE = 0x0C,
+    VIRTIO_REG_QUEUE_SELECT = 0x0E,
+    VIRTIO_REG_QUEUE_NOTIFY = 0x10,
+    VIRTIO_REG_DEVICE_STATUS = 0x12,
+    VIRTIO_REG_ISR_STATUS = 0x13, // cleared by reading it
+    VIRTIO_REG_DEVICE_CONFIG = 0x14, // while msi-x is off
+};
+
+enum VIRTIO_STATUS {
+    VIRTIO_STATUS_ACKNOWLEDGE = 0x01,
+    VIRTIO_STATUS_DRIVER = 0x02,
+    VIRTIO_STATUS_DRIVER_OK = 0x04,
+    VIRTIO_STATUS_FAILED = 0x80,
+};
+
+#define VIRTIO_F_RING_INDIRECT_DESC (1u << 28)
+#define VIRTIO_F_RING_EVENT_IDX (1u << 29)
+
+#define VRING_DESC_F_NEXT 0x1
+#define VRING_DESC_F_WRITE 0x2 // the device writes the buffer
+#define VRING_DESC_F_INDIRECT 0x4 // the buffer is a table of descriptors
+#define VRING_AVAIL_F_NO_INTERRUPT 0x1
+#define VRING_USED_F_NO_NOTIFY 0x1
+
+typedef struct {
+    uint64_t address;
+    uint32_t length;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) vring_desc;
+
+// after the ring, used_event when event idx was negotiated
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+} __attribute__((packed)) vring_avail;
+
+typedef struct {
+    uint32_t id; // the head descriptor of the chain
+    uint32_t length; // bytes the device wrote
+} __attribute__((packed)) vring_used_elem;
+
+// after the ring, avail_event when event idx was negotiated
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    vring_used_elem ring[];
+} __attribute__((packed)) vring_used;
+
+typedef struct {
+    pci_entry_desc_t pci;
+    uint16_t ioBase;
+    uint32_t features; // the ones both sides agreed on
+} virtio_device;
+
+// a split virtqueue in the legacy layout, the used ring starts on its own page
+typedef struct {
+    uint16_t index;
+    uint16_t size;
+    vring_desc* desc;
+    volatile vring_avail* avail;
+    volatile vring_used* used;
+    uint16_t availIdx; // the next free avail entry, published by virtq_publish
+    uint16_t publishedIdx; // avail idx the device last saw
+    uint16_t lastUsed; // the next used entry to pop
+    bool eventIdx;
+    bool irqOff; // interrupts suppressed while the ring is polled
+} virtqueue;
+
+bool virtio_start(virtio_device* dev, pci_entry_desc_t* pci);
+uint32_t virtio_negotiate(virtio_device* dev, uint32_t wanted);
+void virtio_driver_ok(virtio_device* dev);
+void virtio_fail(virtio_device* dev);
+uint8_t virtio_isr(virtio_device* dev);
+uint32_t virtio_config_read32(virtio_device* dev, uint32_t offset);
+uint64_t virtio_config_read64(virtio_device* dev, uint32_t offset);
+void virtio_notify(virtio_device* dev, virtqueue* vq);
+
+bool virtq_init(virtio_device* dev, virtqueue* vq, uint16_t index);
+void virtq_push(virtqueue* vq, uint16_t head);
+bool virtq_publish(virtqueue* vq);
+bool virtq_pop(virtqueue* vq, uint16_t* head, uint32_t* length);
+void virtq_disable_irq(virtqueue* vq);
+bool virtq_enable_irq(virtqueue* vq);
+#endif
@@ -0,0 +1,61 @@
+#ifndef __WAVOS__DRIVERS__VIRTIOBLK_H
+#define __WAVOS__DRIVERS__VIRTIOBLK_H
+#include <common/types.h>
+#include <drivers/blockdev.h>
+#include <drivers/virtio.h>
+#include <multitasking.h>
+#include <spinlock.h>
+
+#define VIRTIO_BLK_MAX_DISKS 4
+#define VIRTIO_BLK_MAX_REQUESTS 32 // in flight per disk
+#define VIRTIO_BLK_MAX_SECTORS 128 // per request
+#define VIRTIO_BLK_SEGMENTS 17 // data descriptors of a request, a 64k buffer at any alignment
+#define VIRTIO_BLK_SPIN_POLLS 2000 // used ring polls with the interrupt off before sleeping
+
+// the header the device reads before the data
+typedef struct {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector; // in 512 byte units whatever the block size
+} __attribute__((packed)) virtio_blk_header;
+
+// a request slot, with the header, the status and the indirect table it points the device at
+typedef struct {
+    virtio_blk_header header;
+    vring_desc table[VIRTIO_BLK_SEGMENTS + 2];
+    volatile uint8_t status;
+    volatile bool done;
+} virtio_blk_request;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t notifies; // queue notifies, each a vm exit
+    uint32_t interrupts;
+} virtio_blk_stats_t;
+
+typedef struct {
+    block_device dev;
+    virtio_device virtio;
+    virtqueue queue;
+    uint64_t sectors;
+    uint32_t maxSectors; // per request, lower if the device takes fewer segments
+    bool indirect;
+    bool readOnly;
+    bool flush;
+
+    spinlock_t lock;
+    virtio_blk_request* requests;
+    uint32_t slots; // usable request slots
+    uint32_t busySlots;
+    bool irqReady;
+    uint32_t polling; // tasks spinning on the used ring, interrupts are off while there are any
+    volatile bool irqPending;
+    wait_queue_t waiters;
+    virtio_blk_stats_t stats;
+} virtio_blk;
+
+bool virtio_blk_init(void);
+int virtio_blk_disk_count(void);
+virtio_blk* virtio_blk_get_disk(int index);
+virtio_blk_stats_t virtio_blk_get_stats(block_device* dev);
+#endif
@@ -0,0 +1,67 @@
+#ifndef __WAVOS__ELF_H
+#define __WAVOS__ELF_H
+#include <common/types.h>
+#include <drivers/blockdev.h>
+#include <filesystem/fat.h>
+#include <multitasking.h>
+
+#define ELF_MAX_SEGMENTS 8
+#define USER_STACK_SIZE 0x40000 // grows down from USER_TOP, paged in on touch
+
+typedef struct {
+    uint8_t ident[16];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;
+    uint32_t phoff;
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} __attribute__((packed)) elf32_header;
+
+typedef struct {
+    uint32_t type;
+    uint32_t offset;
+    uint32_t vaddr;
+    uint32_t paddr;
+    uint32_t filesz;
+    uint32_t memsz;
+    uint32_t flags;
+    uint32_t align;
+} __attribute__((packed)) elf32_program_header;
+
+#define ELF_CLASS_32 1
+#define ELF_DATA_LSB 1
+#define ELF_TYPE_EXEC 2
+#define ELF_MACHINE_386 3
+#define ELF_PT_LOAD 1
+#define ELF_PF_W 0x2
+
+// a loadable segment, read from the file page by page as it is touched
+typedef struct {
+    uint32_t vaddr;
+    uint32_t memsz;
+    uint32_t offset;
+    uint32_t filesz;
+    bool writable;
+} elf_segment;
+
+// the program a task runs, where its pages come from
+typedef struct elf_image {
+    block_device* hd;
+    partition_descr* partDesc;
+    char dirPath[256];
+    char fileName[64];
+    elf_segment segments[ELF_MAX_SEGMENTS];
+    int segmentCount;
+} elf_image;
+
+bool elf_exec(block_device* hd, const char* dirPath, const char* fileName, partition_descr* partDesc);
+bool elf_handle_fault(task_t* task, uint32_t addr);
+#endif
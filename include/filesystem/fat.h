@@ -2,7 +2,8 @@
 #define __WAVOS__FILESYSTEM__FAT_H
 
 #include <common/types.h>
-#include <drivers/ata.h>
+#include <drivers/blockdev.h>
+#include <sync.h>
 typedef struct {
     // common biosParameter for fat12/16/32
     uint8_t jump[3];
@@ -93,16 +94,26 @@ typedef struct {
     char CWDString[512];
 } partition_descr;
 
-partition_descr read_BPB(ata_drive hd, uint32_t partitionOffset);
-void change_current_working_dir(ata_drive hd, const char* path, partition_descr *partDesc);
-void read_dir(ata_drive hd, const char* path, partition_descr *partDesc);
-void tree(ata_drive hd, partition_descr *partDesc);
-void create_file(ata_drive hd, char* path, char* fileName, partition_descr *partDesc);
-void delete_file(ata_drive hd, char* dirPath, char* fileName, partition_descr *partDesc);
-void create_dir(ata_drive hd, char* path, char* dirName, partition_descr *partDesc);
-void delete_dir(ata_drive hd, char* dirPath, char* dirName, partition_descr *partDesc);
-void read_file(ata_drive hd, const char* dirPath, const char* fileName, partition_descr *partDesc);
-void write_to_file(ata_drive hd, const char* dirPath, const char *fileName, const char *data, uint32_t size, bool append, partition_descr *partDesc);
-bool is_file_exist(ata_drive hd, const char* dirPath, const char *fileName, partition_descr *partDesc);
-bool is_dir_exist(ata_drive hd, const char* dirPath, partition_descr *partDesc);
+typedef struct {
+    uint32_t size;
+    uint32_t firstCluster;
+    uint8_t attributes;
+} fat_stat_t;
+
+partition_descr read_BPB(block_device* hd, uint32_t partitionOffset);
+void change_current_working_dir(block_device* hd, const char* path, partition_descr *partDesc);
+void read_dir(block_device* hd, const char* path, partition_descr *partDesc);
+void tree(block_device* hd, partition_descr *partDesc);
+void create_file(block_device* hd, char* path, char* fileName, partition_descr *partDesc);
+void delete_file(block_device* hd, char* dirPath, char* fileName, partition_descr *partDesc);
+void create_dir(block_device* hd, char* path, char* dirName, partition_descr *partDesc);
+void delete_dir(block_device* hd, char* dirPath, char* dirName, partition_descr *partDesc);
+void read_file(block_device* hd, const char* dirPath, const char* fileName, partition_descr *partDesc);
+void write_to_file(block_device* hd, const char* dirPath, const char *fileName, const char *data, uint32_t size, bool append, partition_descr *partDesc);
+bool is_file_exist(block_device* hd, const char* dirPath, const char *fileName, partition_descr *partDesc);
+bool is_dir_exist(block_device* hd, const char* dirPath, partition_descr *partDesc);
+int32_t fat_read(block_device* hd, const char* dirPath, const char* fileName, uint32_t offset, uint8_t* buff, uint32_t len, partition_descr *partDesc);
+bool fat_stat(block_device* hd, const char* dirPath, const char* fileName, fat_stat_t* stat, partition_descr *partDesc);
+
+extern mutex_t fat_lock;
 #endif
\ No newline at end of file
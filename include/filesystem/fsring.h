@@ -0,0 +1,85 @@
+#ifndef __WAVOS__FILESYSTEM__FSRING_H
+#define __WAVOS__FILESYSTEM__FSRING_H
+#include <common/types.h>
+#include <drivers/blockdev.h>
+#include <filesystem/fat.h>
+#include <multitasking.h>
+
+// submission/completion rings shared between a task and the kernel.
+// the task fills sqes and rings the doorbell, a kernel worker runs them
+// in order and posts a cqe for each
+#define FSRING_ENTRIES 32 // must be a power of 2
+#define FSRING_MASK (FSRING_ENTRIES - 1)
+#define FSRING_MAX_RINGS 8
+
+typedef enum {
+    FSRING_OP_READ,   // len bytes at offset into buff
+    FSRING_OP_WRITE,  // len bytes from buff, appended when FSRING_F_APPEND is set
+    FSRING_OP_CREATE, // creates an empty file
+    FSRING_OP_STAT,   // fills the fat_stat_t at buff
+} fsring_op;
+
+#define FSRING_F_APPEND 0x1
+
+typedef struct {
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t reserved;
+    const char* dirPath;
+    const char* fileName;
+    void* buff;
+    uint32_t offset;
+    uint32_t len;
+    uint32_t user_data; // copied to the completion
+} fsring_sqe;
+
+typedef struct {
+    uint32_t user_data;
+    int32_t result; // bytes moved or 0, -1 on failure
+} fsring_cqe;
+
+typedef struct {
+    volatile uint32_t sq_head; // advanced by the kernel
+    volatile uint32_t sq_tail; // advanced by the task
+    volatile uint32_t cq_head; // advanced by the task
+    volatile uint32_t cq_tail; // advanced by the kernel
+    fsring_sqe sq[FSRING_ENTRIES];
+    fsring_cqe cq[FSRING_ENTRIES];
+} fsring_t;
+
+/// @brief returns the next free sqe, 0 if the submission ring is full
+static inline fsring_sqe* fsring_get_sqe(fsring_t* ring)
+{
+    if (ring->sq_tail - ring->sq_head >= FSRING_ENTRIES)
+        return 0;
+    return &ring->sq[ring->sq_tail & FSRING_MASK];
+}
+
+/// @brief publishes the sqe returned by fsring_get_sqe
+static inline void fsring_queue_sqe(fsring_t* ring)
+{
+    asm volatile("" : : : "memory");
+    ring->sq_tail++;
+}
+
+/// @brief returns the oldest unseen completion, 0 if there is none
+static inline fsring_cqe* fsring_peek_cqe(fsring_t* ring)
+{
+    if (ring->cq_head == ring->cq_tail)
+        return 0;
+    return &ring->cq[ring->cq_head & FSRING_MASK];
+}
+
+/// @brief hands the completion returned by fsring_peek_cqe back to the kernel
+static inline void fsring_cqe_seen(fsring_t* ring)
+{
+    asm volatile("" : : : "memory");
+    ring->cq_head++;
+}
+
+void fsring_init();
+int fsring_setup(fsring_t* ring, block_device* hd, partition_descr* partDesc);
+int fsring_enter(fsring_t* ring);
+int fsring_teardown(fsring_t* ring);
+void fsring_release_task(task_t* task);
+#endif
@@ -2,7 +2,7 @@
 #define __WAVOS__FILESYSTEM__MSDOSPART_H
 #include <common/types.h>
 #include <filesystem/fat.h>
-#include <drivers/ata.h>
+#include <drivers/blockdev.h>
 typedef struct {
     uint8_t bootable;
 
@@ -31,5 +31,5 @@ typedef struct {
 
 } __attribute__((packed)) master_boot_record;
 
-partition_descr* read_partitions(ata_drive drive);
+partition_descr* read_partitions(block_device* drive);
 #endif
\ No newline at end of file
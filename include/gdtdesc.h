@@ -2,7 +2,9 @@
 #define __WAVOS__GDTDESC_H
 #include <common/types.h>
 void gdt_setup(void);
+void gdt_load_cpu(uint32_t cpu);
 void change_tss_esp0(uint32_t);
+uint32_t* get_tss_esp0_ptr(void);
 enum gdt_gate_offsets {
 	KERNEL_CS = 0x8,
 	KERNEL_DS = 0x10,
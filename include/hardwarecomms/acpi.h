@@ -0,0 +1,47 @@
+#ifndef __WAVOS__HARDWARECOMMS__ACPI_H
+#define __WAVOS__HARDWARECOMMS__ACPI_H
+#include <common/types.h>
+
+typedef struct {
+    char signature[8];
+    uint8_t checksum;
+    char oemId[6];
+    uint8_t revision;
+    uint32_t rsdtAddress;
+} __attribute__((packed)) acpi_rsdp;
+
+typedef struct {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oemId[6];
+    char oemTableId[8];
+    uint32_t oemRevision;
+    uint32_t creatorId;
+    uint32_t creatorRevision;
+} __attribute__((packed)) acpi_sdt_header;
+
+typedef struct {
+    acpi_sdt_header header;
+    uint32_t lapicAddress;
+    uint32_t flags;
+    // followed by variable length entries
+} __attribute__((packed)) acpi_madt;
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed)) madt_entry_header;
+
+#define MADT_ENTRY_LAPIC 0
+
+typedef struct {
+    madt_entry_header header;
+    uint8_t acpiProcessorId;
+    uint8_t apicId;
+    uint32_t flags; // bit 0 enabled
+} __attribute__((packed)) madt_lapic_entry;
+
+acpi_sdt_header* acpi_find_table(const char* signature);
+#endif
@@ -0,0 +1,60 @@
+#ifndef __WAVOS__HARDWARECOMMS__CPU_H
+#define __WAVOS__HARDWARECOMMS__CPU_H
+#include <common/types.h>
+
+/// @brief disables interrupts and returns the previous eflags
+static inline uint32_t irq_save(void)
+{
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r" (flags) : : "memory");
+    return flags;
+}
+
+/// @brief restores the interrupt flag saved by irq_save
+static inline void irq_restore(uint32_t flags)
+{
+    if (flags & 0x200)
+        asm volatile("sti" : : : "memory");
+}
+
+/// @brief reads the time stamp counter
+static inline uint64_t rdtsc(void)
+{
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t) hi << 32) | lo;
+}
+
+/// @brief reads a model specific register
+static inline uint64_t rdmsr(uint32_t msr)
+{
+    uint32_t lo, hi;
+    asm volatile("rdmsr" : "=a" (lo), "=d" (hi) : "c" (msr));
+    return ((uint64_t) hi << 32) | lo;
+}
+
+/// @brief writes a model specific register
+static inline void wrmsr(uint32_t msr, uint64_t value)
+{
+    asm volatile("wrmsr" : : "c" (msr), "a" ((uint32_t) value), "d" ((uint32_t) (value >> 32)));
+}
+
+/// @brief executes cpuid for the specified leaf
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx)
+{
+    asm volatile("cpuid" : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx) : "a" (leaf), "c" (0));
+}
+
+/// @brief checks if the cpu supports sysenter/sysexit
+static inline bool cpu_has_sysenter(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & (1 << 11)))
+        return false;
+    // early pentium pros report SEP without supporting it
+    uint32_t family = (eax >> 8) & 0xF, model = (eax >> 4) & 0xF, stepping = eax & 0xF;
+    return !(family == 6 && model < 3 && stepping < 3);
+}
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef __WAVOS__HARDWARECOMMS__FPU_H
+#define __WAVOS__HARDWARECOMMS__FPU_H
+#include <common/types.h>
+#include <multitasking.h>
+
+#define FPU_STATE_SIZE 512 // an fxsave area, fsave needs less
+#define FPU_NO_CPU 0xFFFFFFFF
+
+void fpu_init(void);
+void fpu_switch(task_t* old, task_t* next);
+void fpu_release(task_t* task);
+#endif
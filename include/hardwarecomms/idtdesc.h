@@ -2,5 +2,6 @@
 #define __WAVOS__HARDWARECOMMS__IDTDESC_H
 
 void idt_setup(void);
+void idt_load(void);
 void interrupts_activate();
 #endif
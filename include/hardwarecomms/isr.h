@@ -1,5 +1,6 @@
 #ifndef __WAVOS__HARDWARECOMMS__ISR_H
 #define __WAVOS__HARDWARECOMMS__ISR_H
+#include <multitasking.h>
 #define IRQ0 32
 #define IRQ1 33
 #define IRQ2 34
@@ -17,8 +18,12 @@
 #define IRQ14 46
 #define IRQ15 47
 
+#define IRQ_MAX_SHARED 4 // devices on one pci interrupt line
+
 
 
 void register_irq_callback(int irq,void (*callback)());
+bool register_shared_irq_callback(int irq,void (*callback)());
+void register_interrupt_handler(uint8_t vector, void (*handler)(registers_t*));
 
 #endif
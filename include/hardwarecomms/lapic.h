@@ -0,0 +1,19 @@
+#ifndef __WAVOS__HARDWARECOMMS__LAPIC_H
+#define __WAVOS__HARDWARECOMMS__LAPIC_H
+#include <common/types.h>
+
+#define LAPIC_TIMER_VECTOR 0xEF
+#define RESCHED_VECTOR 0xF0
+#define LAPIC_SPURIOUS_VECTOR 0xFF
+
+void lapic_init(uint32_t base);
+void lapic_enable(void);
+uint8_t lapic_id(void);
+void lapic_eoi(void);
+void lapic_send_init(uint8_t apic_id);
+void lapic_send_init_deassert(uint8_t apic_id);
+void lapic_send_startup(uint8_t apic_id, uint8_t vector);
+void lapic_send_ipi(uint8_t apic_id, uint8_t vector);
+void lapic_timer_calibrate(uint32_t hz);
+void lapic_timer_start(void);
+#endif
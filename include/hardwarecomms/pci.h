@@ -1,7 +1,47 @@
 #ifndef __WAVOS__HARDWARECOMMS__PCI_H
 #define __WAVOS__HARDWARECOMMS__PCI_H
 #include <common/types.h>
+
+typedef enum BaseAddressRegisterType {
+    BAR_MEM_MAP = 0,
+    BAR_IO = 1,
+} bar_type_t;
+
+typedef struct pci_entry_desc {
+    uint16_t portBase;
+    uint16_t interrupt;
+
+    uint8_t bus;
+    uint8_t device;
+    uint8_t function;
+
+    uint16_t vendorID;
+    uint16_t deviceID;
+
+    uint8_t classID;
+    uint8_t subclassID;
+    uint8_t interfaceID;
+
+    uint8_t revision;
+
+} pci_entry_desc_t;
+
+typedef struct base_addrs_reg {
+    bool prefetchable;
+    uint8_t* addrs;
+    uint32_t size;
+    bar_type_t type;
+} bar_t;
+
+#define PCI_COMMAND_IO 0x1
+#define PCI_COMMAND_MEMORY 0x2
+#define PCI_COMMAND_BUS_MASTER 0x4
+
 uint32_t pci_read(uint8_t bus, uint8_t device, uint8_t function, uint8_t registeroffset);
 void pci_write(uint8_t bus, uint8_t device, uint8_t function, uint8_t registeroffset, uint32_t data);
 void select_drivers();
+bool pci_find_class(uint8_t classID, uint8_t subclassID, uint32_t index, pci_entry_desc_t* out);
+bool pci_find_device(uint16_t vendorID, uint16_t deviceID, uint32_t index, pci_entry_desc_t* out);
+bar_t get_base_address_register(uint8_t bus, uint8_t device, uint8_t func, size_t bar);
+void pci_enable(pci_entry_desc_t* entry, uint16_t command);
 #endif
@@ -0,0 +1,15 @@
+#ifndef __WAVOS__HARDWARECOMMS__PIT_H
+#define __WAVOS__HARDWARECOMMS__PIT_H
+#include <common/types.h>
+
+#define TIMER_HZ 1000
+
+void pit_init(uint32_t hz);
+void timer_interrupt(void);
+uint32_t get_ticks(void);
+uint32_t ns_to_ticks(uint64_t ns);
+void timer_delay_ms(uint32_t ms);
+void tsc_calibrate(void);
+uint32_t get_tsc_khz(void);
+uint64_t cycles_to_ns(uint64_t cycles);
+#endif
@@ -9,4 +9,22 @@ void outl(uint16_t port, uint32_t value);
 uint8_t inb(uint16_t port);
 uint16_t inw(uint16_t port);
 uint32_t inl(uint16_t port);
+
+/// @brief reads count words from a port straight into memory
+/// @param port 
+/// @param buff 
+/// @param count 
+static inline void insw(uint16_t port, void* buff, uint32_t count)
+{
+    asm volatile("cld; rep insw" : "+D" (buff), "+c" (count) : "d" (port) : "memory");
+}
+
+/// @brief writes count words from memory to a port
+/// @param port 
+/// @param buff 
+/// @param count 
+static inline void outsw(uint16_t port, const void* buff, uint32_t count)
+{
+    asm volatile("cld; rep outsw" : "+S" (buff), "+c" (count) : "d" (port) : "memory");
+}
 #endif
\ No newline at end of file
@@ -0,0 +1,17 @@
+#ifndef __WAVOS__HARDWARECOMMS__SOFTIRQ_H
+#define __WAVOS__HARDWARECOMMS__SOFTIRQ_H
+#include <common/types.h>
+
+// a unit of deferred irq work, queued by a top half and ran after EOI
+typedef struct tasklet {
+    void (*func)(uint32_t data);
+    uint32_t data;
+    bool scheduled; // already on the pending list
+    struct tasklet* next;
+} tasklet_t;
+
+void tasklet_init(tasklet_t* tasklet, void (*func)(uint32_t), uint32_t data);
+void tasklet_schedule(tasklet_t* tasklet);
+void do_softirq(void);
+bool softirq_active(void);
+#endif
@@ -2,6 +2,8 @@
 #define __WAVOS__MULTITASKING_H
 
 #include <common/types.h>
+#include <spinlock.h>
+#include <timer.h>
 typedef struct registers
 {
 	uint32_t gs, fs, es, ds;
@@ -10,12 +12,87 @@ typedef struct registers
 	uint32_t eip, cs, eflags, useresp, ss;
 } registers_t;
 
+#define NUM_PRIORITIES 8 // 0 is the highest
+#define TASK_PRIO_INTERACTIVE 1
+#define TASK_PRIO_DEFAULT 4
+#define TASK_PRIO_BATCH 7
+
+typedef enum {
+	TASK_RUNNING,
+	TASK_READY,
+	TASK_BLOCKED,
+	TASK_DEAD,
+} task_state;
+
+struct task;
+struct elf_image;
+
+// tasks waiting for some event, in the order they started waiting
+typedef struct {
+	spinlock_t lock;
+	struct task* head;
+	struct task* tail;
+} wait_queue_t;
+
+#define WAIT_QUEUE_INIT { .lock = SPINLOCK_INIT(0), .head = 0, .tail = 0 }
+
+// wakes a waiting task once its time is up, see wait_event_timeout
+typedef struct {
+	ktimer_t timer;
+	struct task* task;
+	volatile bool expired;
+} wait_timeout_t;
+
 typedef struct task
 {
-    uint32_t kstack; // kernel stack
+    uint32_t kstack; // kernel stack, must stay first for switch_context
 	uint32_t kstack_bottom; // kernel stack bottom
+	uint32_t* page_directory; // the address space, shared kernel one for kernel tasks
+	struct elf_image* image; // the program paged into the user window, 0 if none
+	bool user; // runs in ring 3, memory it hands the kernel has to be its own
+	void* fpu_area; // fpu and sse registers, allocated on first use
+	uint32_t fpu_cpu; // the cpu whose fpu last held its registers
+	uint32_t id;
+	const char* name;
+	task_state state;
+	uint8_t priority;
+	uint32_t time_slice; // ticks left before preemption
+	uint32_t cpu; // the run queue it is on or last ran from
+	volatile bool on_cpu; // still running or switching out, no other cpu may pick it up
+	bool pinned; // stays on the cpu that added it, never stolen
+	struct task* next; // run queue link
+	uint32_t ready_tick; // when it was last queued, for run_queue_pop to see it starving
+	struct task* wait_next; // wait queue link
+	ktimer_t sleep_timer; // wakes the task out of task_sleep
+	void* owned_memory; // freed by the reaper once the task is dead, 0 if caller owned
+	wait_queue_t exit_waiters; // woken by task_exit
+
+	// cpu accounting, in tsc cycles
+	uint64_t user_cycles;
+	uint64_t kernel_cycles;
+	uint64_t cycle_stamp; // when the running task was last charged
+	uint64_t last_run; // when it was last switched in
+	uint64_t wake_stamp; // when it was last made ready by task_wake
+	uint64_t top_mark; // user + kernel cycles at the previous task_snapshot
+	uint32_t voluntary_switches; // blocked, slept or exited
+	uint32_t involuntary_switches; // preempted or yielded while still runnable
 } task_t;
 
+// a copy of a task for listing, see task_snapshot
+typedef struct {
+	uint32_t id;
+	const char* name;
+	task_state state;
+	uint8_t priority;
+	uint32_t cpu;
+	uint64_t user_cycles;
+	uint64_t kernel_cycles;
+	uint64_t window_cycles; // cycles used since the previous snapshot
+	uint64_t last_run;
+	uint32_t voluntary_switches;
+	uint32_t involuntary_switches;
+} task_info_t;
+
 typedef struct 
 {
 	uint32_t ebp, edi, esi, ebx;
@@ -32,7 +109,65 @@ typedef struct
 
 extern void new_task_setup();
 extern void switch_context();
+void init_multitasking();
+void init_cpu_scheduler(uint32_t cpu);
+void idle_main();
 bool add_task(task_t* task);
+bool is_task_alive(task_t* task);
 task_t create_task(uint32_t callback, uint32_t user_stack,  uint32_t kernel_stack, bool is_kernel_task);
+task_t* get_current_task();
+void set_task_priority(task_t* task, uint8_t priority);
+void set_task_name(task_t* task, const char* name);
+int task_snapshot(task_info_t* out, int max);
+void account_kernel_entry();
+void account_kernel_exit();
 void schedule();
+void scheduler_tick();
+void schedule_if_needed();
+void request_resched();
+void task_yield();
+void task_block();
+void task_wake(task_t* task);
+void task_exit();
+task_t* spawn_kernel_task(void (*func)(), uint8_t priority);
+void task_use_address_space(task_t* owner);
+void task_join(task_t* task);
+void task_sleep(uint64_t ns);
+
+void wait_queue_init(wait_queue_t* queue);
+void wait_queue_prepare(wait_queue_t* queue);
+void wait_queue_finish(wait_queue_t* queue);
+void wake_one(wait_queue_t* queue);
+void wake_all(wait_queue_t* queue);
+void wait_timeout_start(wait_timeout_t* timeout, uint32_t ticks);
+void wait_timeout_stop(wait_timeout_t* timeout);
+
+/// @brief blocks the running task on a queue until condition is true,
+/// must be called with interrupts disabled. the task is queued before the
+/// condition is checked, so a wakeup from another cpu in between isnt lost
+#define wait_event(queue, condition) \
+	while (!(condition)) { \
+		wait_queue_prepare(queue); \
+		if (condition) \
+			wait_queue_finish(queue); \
+		else \
+			schedule(); \
+	}
+
+/// @brief wait_event that gives up after the given amount of timer ticks,
+/// must be called with interrupts disabled. evaluates to the condition,
+/// so false means it timed out
+#define wait_event_timeout(queue, condition, ticks) ({ \
+	wait_timeout_t __timeout; \
+	wait_timeout_start(&__timeout, (ticks)); \
+	while (!(condition) && !__timeout.expired) { \
+		wait_queue_prepare(queue); \
+		if (!(condition) && !__timeout.expired) \
+			schedule(); \
+		/* a timeout wakes the task while it is still queued */ \
+		wait_queue_finish(queue); \
+	} \
+	wait_timeout_stop(&__timeout); \
+	(condition); \
+})
 #endif
@@ -0,0 +1,45 @@
+#ifndef __WAVOS__PAGING_H
+#define __WAVOS__PAGING_H
+#include <common/types.h>
+
+#define PAGE_SIZE 0x1000
+#define LARGE_PAGE_SIZE 0x400000
+
+#define PAGE_PRESENT 0x001
+#define PAGE_WRITE 0x002
+#define PAGE_USER 0x004
+#define PAGE_WRITETHROUGH 0x008
+#define PAGE_NOCACHE 0x010
+#define PAGE_LARGE 0x080 // a 4mb page straight from the directory
+#define PAGE_GLOBAL 0x100 // kept in the tlb across cr3 switches
+
+// every address space maps physical memory 1:1 below USER_BASE and devices
+// 1:1 from USER_TOP up, both shared, global and kernel only. the window
+// between them is private to each address space
+#define USER_BASE 0x80000000
+#define USER_TOP 0xC0000000
+
+// ring 3 code linked into the kernel image sees its code and constants read only,
+// everything it writes, its stack too, has to be put in here
+#define USER_DATA __attribute__((section(".user")))
+
+extern uint32_t* kernel_directory;
+struct task;
+
+bool paging_init(size_t frames_start, size_t frames_size);
+void paging_enable_cpu(void);
+uint32_t frame_alloc(void);
+uint32_t frame_alloc_zeroed(void);
+void frame_free(uint32_t frame);
+uint32_t* address_space_create(void);
+void address_space_destroy(uint32_t* directory);
+bool paging_map(uint32_t* directory, uint32_t virt, uint32_t phys, uint32_t flags);
+uint32_t paging_unmap(uint32_t* directory, uint32_t virt);
+uint32_t paging_translate(uint32_t* directory, uint32_t virt);
+uint32_t virt_to_phys_in(uint32_t* directory, const void* addr);
+uint32_t virt_to_phys(const void* addr);
+bool map_user_page(uint32_t* directory, uint32_t virt, uint32_t flags);
+bool user_range_ok(struct task* task, const void* addr, uint32_t len, bool write);
+bool user_string_ok(struct task* task, const char* str, uint32_t max);
+void* map_mmio(uint32_t phys, size_t size);
+#endif
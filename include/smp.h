@@ -0,0 +1,25 @@
+#ifndef __WAVOS__SMP_H
+#define __WAVOS__SMP_H
+#include <common/types.h>
+#include <gdtdesc.h>
+
+#define MAX_CPUS 8
+
+typedef struct {
+    uint8_t apic_id;
+    bool online;
+} cpu_info_t;
+
+/// @brief the index of the running cpu, 0 is the boot cpu.
+/// read from the task register so it works before the local apic is set up
+static inline uint32_t cpu_id(void)
+{
+    uint16_t selector;
+    asm volatile("str %0" : "=r"(selector));
+    return selector ? (uint32_t) (selector - TSS_SEG) >> 3 : 0;
+}
+
+void smp_init(void);
+uint32_t cpu_count(void);
+void smp_send_resched(uint32_t cpu);
+#endif
@@ -0,0 +1,87 @@
+#ifndef __WAVOS__SPINLOCK_H
+#define __WAVOS__SPINLOCK_H
+#include <common/types.h>
+#include <hardwarecomms/cpu.h>
+
+// counters kept by every lock, named locks show up in lock_stats_first
+typedef struct lock_stats {
+    const char* name;
+    volatile uint32_t registered;
+    uint32_t acquisitions;
+    uint32_t contended; // acquisitions that had to wait
+    uint64_t wait_cycles; // tsc cycles spent spinning or sleeping
+    struct lock_stats* next;
+} lock_stats_t;
+
+// a ticket lock, cpus get the lock in the order they asked for it
+typedef struct {
+    union {
+        volatile uint32_t ticket;
+        struct {
+            volatile uint16_t owner; // the ticket being served
+            volatile uint16_t next; // the next ticket handed out
+        } half;
+    };
+    lock_stats_t stats;
+} spinlock_t;
+
+#define LOCK_STATS_INIT(lock_name) { .name = (lock_name), .registered = 0, .acquisitions = 0, \
+    .contended = 0, .wait_cycles = 0, .next = 0 }
+#define SPINLOCK_INIT(lock_name) { .ticket = 0, .stats = LOCK_STATS_INIT(lock_name) }
+
+void spin_init(spinlock_t* lock, const char* name);
+void spin_lock_contended(spinlock_t* lock, uint16_t ticket);
+void lock_stats_register(lock_stats_t* stats);
+lock_stats_t* lock_stats_first(void);
+
+/// @brief counts an acquisition, the lock (or the stats) must be owned by the caller
+/// @param stats 
+static inline void lock_stats_acquired(lock_stats_t* stats)
+{
+    stats->acquisitions++;
+    if (stats->name && !stats->registered)
+        lock_stats_register(stats);
+}
+
+static inline void spin_lock(spinlock_t* lock)
+{
+    uint16_t ticket = __sync_fetch_and_add(&lock->half.next, 1);
+    if (lock->half.owner != ticket)
+        spin_lock_contended(lock, ticket);
+    lock_stats_acquired(&lock->stats);
+}
+
+/// @brief takes the lock only if it is free
+/// @return true if the lock was taken
+static inline bool spin_trylock(spinlock_t* lock)
+{
+    uint32_t old = lock->ticket;
+    if ((old & 0xFFFF) != (old >> 16))
+        return false;
+    if (!__sync_bool_compare_and_swap(&lock->ticket, old, old + 0x10000))
+        return false;
+    lock_stats_acquired(&lock->stats);
+    return true;
+}
+
+static inline void spin_unlock(spinlock_t* lock)
+{
+    __sync_fetch_and_add(&lock->half.owner, 1);
+}
+
+/// @brief disables interrupts on this cpu and takes the lock
+/// @return the flags to hand to spin_unlock_irqrestore
+static inline uint32_t spin_lock_irqsave(spinlock_t* lock)
+{
+    uint32_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags)
+{
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+#endif
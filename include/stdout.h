@@ -2,25 +2,30 @@
 #define __WAVOS__STDOUT_H
 
 #include <common/types.h>
-#include <drivers/ata.h>
+#include <drivers/blockdev.h>
 #include <filesystem/fat.h>
 typedef enum {
     STDOUT_SCREEN,
     STDOUT_FILE
 } stdout_mode;
 
-// a descriptor for stdout
+#define STDOUT_PATH_MAX 256
+#define STDOUT_NAME_MAX 64
+
+// a descriptor for stdout, file writers get a copy so a redirection
+// cant change the names under them
 typedef struct {
     stdout_mode mode; // file or terminal
-    char* dirPath; // path of dir in which the file is located
-    char* fileName; // the fileName
+    char dirPath[STDOUT_PATH_MAX]; // path of dir in which the file is located
+    char fileName[STDOUT_NAME_MAX]; // the fileName
     partition_descr* part_desc;
-    ata_drive hd;
+    block_device* hd;
     bool  rewrite; // to rewrite
 } stdout_desc;
 
 void set_stdout_to_terminal();
-void set_stdout_to_file(char* dirPath, char* fileName, partition_descr* part_desc, ata_drive hd, bool rewrite);
+void set_stdout_to_file(char* dirPath, char* fileName, partition_descr* part_desc, block_device* hd, bool rewrite);
 void set_stdout_rewrite(bool rewrite);
 stdout_desc get_stdout();
+stdout_mode get_stdout_for_write(stdout_desc* out);
 #endif
\ No newline at end of file
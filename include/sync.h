@@ -0,0 +1,49 @@
+#ifndef __WAVOS__SYNC_H
+#define __WAVOS__SYNC_H
+#include <common/types.h>
+#include <spinlock.h>
+#include <multitasking.h>
+
+// a sleeping lock for task context, the owner may take it again
+typedef struct {
+    task_t* volatile owner;
+    uint32_t depth;
+    wait_queue_t waiters;
+    lock_stats_t stats;
+} mutex_t;
+
+// a counting semaphore, up is safe from irq context
+typedef struct {
+    volatile int32_t count;
+    wait_queue_t waiters;
+    lock_stats_t stats;
+} semaphore_t;
+
+// a one shot event tasks can wait for, complete is safe from irq context
+typedef struct {
+    volatile bool done;
+    wait_queue_t waiters;
+} completion_t;
+
+#define MUTEX_INIT(lock_name) { .owner = 0, .depth = 0, .waiters = WAIT_QUEUE_INIT, \
+    .stats = LOCK_STATS_INIT(lock_name) }
+#define SEMAPHORE_INIT(lock_name, initial) { .count = (initial), .waiters = WAIT_QUEUE_INIT, \
+    .stats = LOCK_STATS_INIT(lock_name) }
+#define COMPLETION_INIT { .done = false, .waiters = WAIT_QUEUE_INIT }
+
+void mutex_init(mutex_t* mutex, const char* name);
+void mutex_lock(mutex_t* mutex);
+bool mutex_trylock(mutex_t* mutex);
+void mutex_unlock(mutex_t* mutex);
+
+void semaphore_init(semaphore_t* sem, const char* name, int32_t count);
+void semaphore_down(semaphore_t* sem);
+bool semaphore_trydown(semaphore_t* sem);
+bool semaphore_down_timeout(semaphore_t* sem, uint64_t ns);
+void semaphore_up(semaphore_t* sem);
+
+void completion_init(completion_t* completion);
+void completion_reset(completion_t* completion);
+void complete(completion_t* completion);
+bool wait_for_completion_timeout(completion_t* completion, uint64_t ns);
+#endif
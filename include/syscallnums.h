@@ -0,0 +1,27 @@
+#ifndef __WAVOS__SYSCALLNUMS_H
+#define __WAVOS__SYSCALLNUMS_H
+
+// every syscall as X(number, kernel handler, argument count), in number order.
+// user code uses the numbers, the kernel builds its dispatch table from it.
+// sysenter only passes three arguments, calls taking more need int 0x80
+#define SYSCALL_LIST(X) \
+    X(SYS_NOP, sys_nop, 0) \
+    X(SYS_STDOUT_SCREEN, sys_stdout_screen, 0) \
+    X(SYS_STDOUT_FILE, sys_stdout_file, 5) \
+    X(SYS_WRITE, sys_write, 2) \
+    X(SYS_EXIT, sys_exit, 0) \
+    X(SYS_WRITEV, sys_writev, 2) \
+    X(SYS_FSRING_SETUP, sys_fsring_setup, 3) \
+    X(SYS_FSRING_ENTER, sys_fsring_enter, 1) \
+    X(SYS_FSRING_TEARDOWN, sys_fsring_teardown, 1)
+
+#define SYSCALL_FAST_MAX_ARGS 3
+
+#define SYSCALL_ENUM_ENTRY(num, handler, args) num,
+enum syscall_num {
+    SYSCALL_LIST(SYSCALL_ENUM_ENTRY)
+    SYSCALL_COUNT
+};
+#undef SYSCALL_ENUM_ENTRY
+
+#endif
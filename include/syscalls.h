@@ -2,5 +2,14 @@
 #define __WAVOS__SYSCALLS_H
 #include <multitasking.h>
 
-void handle_syscall(registers_t regs);
+typedef struct {
+    uint32_t calls;
+    uint64_t cycles; // tsc cycles spent inside the handler
+} syscall_stats_t;
+
+void handle_syscall(registers_t* regs);
+uint32_t handle_fast_syscall(uint32_t num, uint32_t arg0, uint32_t arg1, uint32_t arg2);
+void syscall_fast_init();
+const char* syscall_name(uint32_t num);
+syscall_stats_t syscall_get_stats(uint32_t num);
 #endif
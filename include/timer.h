@@ -0,0 +1,24 @@
+#ifndef __WAVOS__TIMER_H
+#define __WAVOS__TIMER_H
+#include <common/types.h>
+
+// a callback ran from the timer bottom half once its tick came
+typedef struct ktimer {
+    struct ktimer* next;
+    struct ktimer** pprev; // the link pointing at this timer, 0 while not pending
+    uint32_t expires; // the tick it fires on
+    void (*func)(uint32_t data);
+    uint32_t data;
+} ktimer_t;
+
+// tick comparisons that survive the counter wrapping
+#define time_after_eq(a, b) ((int32_t) ((a) - (b)) >= 0)
+#define time_before(a, b) ((int32_t) ((a) - (b)) < 0)
+
+void timer_init(ktimer_t* timer, void (*func)(uint32_t), uint32_t data);
+void timer_add(ktimer_t* timer, uint32_t delay);
+bool timer_cancel(ktimer_t* timer);
+bool timer_cancel_sync(ktimer_t* timer);
+bool timer_pending(ktimer_t* timer);
+void timer_tick(void);
+#endif
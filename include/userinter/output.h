@@ -1,11 +1,13 @@
 #ifndef __WAVOS__USERINTER__OUTPUT_H
 #define __WAVOS__USERINTER__OUTPUT_H
-#include <drivers/ata.h>
+#include <drivers/blockdev.h>
 #include <filesystem/msdospart.h>
+#include <common/iovec.h>
 
 void print(char* data, int size);
+void print_v(iovec_t* iov, int count);
 void print_string(char* str);
 void print_int(int i, int base);
-void change_stdout_to_file(char* dirPath, char* fileName, partition_descr* part_desc, ata_drive hd, bool rewrite);
+void change_stdout_to_file(char* dirPath, char* fileName, partition_descr* part_desc, block_device* hd, bool rewrite);
 void change_stdout_to_screen();
 #endif
\ No newline at end of file
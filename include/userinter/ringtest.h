@@ -0,0 +1,7 @@
+#ifndef __WAVOS__USERINTER__RINGTEST_H
+#define __WAVOS__USERINTER__RINGTEST_H
+#include <drivers/blockdev.h>
+#include <filesystem/fat.h>
+
+void run_ring_test(block_device* hd, partition_descr* partDesc);
+#endif
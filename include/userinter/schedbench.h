@@ -0,0 +1,5 @@
+#ifndef __WAVOS__USERINTER__SCHEDBENCH_H
+#define __WAVOS__USERINTER__SCHEDBENCH_H
+
+void run_sched_bench();
+#endif
@@ -0,0 +1,5 @@
+#ifndef __WAVOS__USERINTER__SYSBENCH_H
+#define __WAVOS__USERINTER__SYSBENCH_H
+
+void run_syscall_bench();
+#endif
@@ -0,0 +1,33 @@
+#ifndef __WAVOS__USERINTER__SYSCALL_H
+#define __WAVOS__USERINTER__SYSCALL_H
+#include <common/types.h>
+#include <syscallnums.h>
+#include <filesystem/fsring.h>
+
+/// @brief enters the kernel through int 0x80, works from any ring
+static inline uint32_t syscall_int(uint32_t num, uint32_t arg0, uint32_t arg1, uint32_t arg2)
+{
+    asm volatile("int $0x80" : "+a" (num) : "b" (arg0), "c" (arg1), "d" (arg2) : "memory");
+    return num;
+}
+
+/// @brief enters the kernel through sysenter, sysexit always returns to ring 3
+/// so this must only be used from user mode
+static inline uint32_t syscall_fast(uint32_t num, uint32_t arg0, uint32_t arg1, uint32_t arg2)
+{
+    asm volatile("movl %%esp, %%ecx\n\t"
+                 "movl $1f, %%edx\n\t"
+                 "sysenter\n"
+                 "1:"
+                 : "+a" (num) : "b" (arg0), "S" (arg1), "D" (arg2) : "ecx", "edx", "memory");
+    return num;
+}
+
+extern bool sysenter_supported;
+
+bool syscall_fast_usable(void);
+uint32_t syscall(uint32_t num, uint32_t arg0, uint32_t arg1, uint32_t arg2);
+int fsring_register(fsring_t* ring, block_device* hd, partition_descr* partDesc);
+int fsring_submit(fsring_t* ring);
+int fsring_unregister(fsring_t* ring);
+#endif
@@ -0,0 +1,695 @@
+#include <drivers/ahci.h>
+#include <drivers/ata.h>
+#include <hardwarecomms/pci.h>
+#include <hardwarecomms/isr.h>
+#include <hardwarecomms/softirq.h>
+#include <hardwarecomms/pit.h>
+#include <hardwarecomms/cpu.h>
+#include <io/screen.h>
+#include <common/tools.h>
+#include <paging.h>
+#include <timer.h>
+
+#define AHCI_TIMEOUT_MS 5000
+#define AHCI_RECHECK_MS 10 // a waiter looks at ci itself this often
+
+// hba registers, from abar
+enum AHCI_HBA_REGS {
+    AHCI_CAP = 0x00,
+    AHCI_GHC = 0x04,
+    AHCI_IS = 0x08,
+    AHCI_PI = 0x0C,
+    AHCI_CAP2 = 0x24,
+    AHCI_BOHC = 0x28,
+};
+
+// port registers, from abar + 0x100 + port * 0x80
+enum AHCI_PORT_REGS {
+    AHCI_PX_CLB = 0x00,
+    AHCI_PX_CLBU = 0x04,
+    AHCI_PX_FB = 0x08,
+    AHCI_PX_FBU = 0x0C,
+    AHCI_PX_IS = 0x10,
+    AHCI_PX_IE = 0x14,
+    AHCI_PX_CMD = 0x18,
+    AHCI_PX_TFD = 0x20,
+    AHCI_PX_SIG = 0x24,
+    AHCI_PX_SSTS = 0x28,
+    AHCI_PX_SERR = 0x30,
+    AHCI_PX_SACT = 0x34,
+    AHCI_PX_CI = 0x38,
+};
+
+enum AHCI_COMMANDS {
+    AHCI_CMD_READ_DMA_EXT = 0x25,
+    AHCI_CMD_WRITE_DMA_EXT = 0x35,
+    AHCI_CMD_READ_FPDMA_QUEUED = 0x60,
+    AHCI_CMD_WRITE_FPDMA_QUEUED = 0x61,
+    AHCI_CMD_READ_DMA = 0xC8,
+    AHCI_CMD_WRITE_DMA = 0xCA,
+    AHCI_CMD_FLUSH_CACHE = 0xE7,
+    AHCI_CMD_FLUSH_CACHE_EXT = 0xEA,
+    AHCI_CMD_IDENTIFY = 0xEC,
+};
+
+#define AHCI_CAP_SNCQ (1u << 30)
+#define AHCI_CAP2_BOH 0x1
+#define AHCI_BOHC_BOS 0x1
+#define AHCI_BOHC_OOS 0x2
+#define AHCI_GHC_HR 0x1
+#define AHCI_GHC_IE 0x2
+#define AHCI_GHC_AE (1u << 31)
+
+#define AHCI_PX_CMD_ST 0x0001
+#define AHCI_PX_CMD_SUD 0x0002
+#define AHCI_PX_CMD_POD 0x0004
+#define AHCI_PX_CMD_FRE 0x0010
+#define AHCI_PX_CMD_FR 0x4000
+#define AHCI_PX_CMD_CR 0x8000
+
+#define AHCI_PX_IS_DHRS 0x00000001 // a command without ncq finished
+#define AHCI_PX_IS_PSS 0x00000002 // a pio data in command, like identify, finished
+#define AHCI_PX_IS_SDBS 0x00000008 // queued commands finished
+#define AHCI_PX_IS_DPS 0x00000020 // the prd asking for an interrupt was done
+#define AHCI_PX_IS_ERRORS 0x78000000 // interface, host bus data and fatal, task file errors
+#define AHCI_PX_IE_MASK (AHCI_PX_IS_DHRS | AHCI_PX_IS_PSS | AHCI_PX_IS_SDBS | AHCI_PX_IS_DPS | AHCI_PX_IS_ERRORS)
+
+#define AHCI_TFD_BSY 0x80
+#define AHCI_TFD_DRQ 0x08
+#define AHCI_SIG_ATA 0x00000101
+#define AHCI_SSTS_DET_PRESENT 0x3
+
+#define AHCI_FIS_H2D 0x27
+#define AHCI_FIS_COMMAND 0x80
+#define AHCI_HEADER_WRITE 0x40
+#define AHCI_PRD_IRQ (1u << 31)
+
+volatile uint32_t* ahci_abar = 0;
+ahci_port ahci_ports[AHCI_MAX_PORTS];
+ahci_port* ahci_disks[AHCI_MAX_PORTS];
+int ahci_disks_found = 0;
+uint32_t ahci_slots = 1; // command slots per port
+bool ahci_hba_ncq = false;
+bool ahci_irq_ready = false;
+tasklet_t ahci_tasklet;
+
+/// @brief a register of the hba
+#define HBA_REG(reg) ahci_abar[(reg) / 4]
+/// @brief a register of a port
+#define PORT_REG(port, reg) (port)->regs[(reg) / 4]
+
+/// @brief spins until the masked register bits reach the value
+/// @return false on a timeout
+bool ahci_wait_reg(volatile uint32_t* reg, uint32_t mask, uint32_t value, uint32_t timeout_ms)
+{
+    uint32_t deadline = get_ticks() + ns_to_ticks(timeout_ms * 1000000ULL);
+    while ((*reg & mask) != value)
+    {
+        if (time_after_eq(get_ticks(), deadline))
+            return false;
+        asm volatile("pause");
+    }
+    return true;
+}
+
+/// @brief stops the port's command list and fis receive engines
+/// @param port
+bool ahci_port_stop(ahci_port* port)
+{
+    PORT_REG(port, AHCI_PX_CMD) &= ~AHCI_PX_CMD_ST;
+    if (!ahci_wait_reg(&PORT_REG(port, AHCI_PX_CMD), AHCI_PX_CMD_CR, 0, 500))
+        return false;
+    PORT_REG(port, AHCI_PX_CMD) &= ~AHCI_PX_CMD_FRE;
+    return ahci_wait_reg(&PORT_REG(port, AHCI_PX_CMD), AHCI_PX_CMD_FR, 0, 500);
+}
+
+/// @brief starts the engines once the device is idle
+/// @param port
+bool ahci_port_start(ahci_port* port)
+{
+    PORT_REG(port, AHCI_PX_SERR) = 0xFFFFFFFF;
+    PORT_REG(port, AHCI_PX_IS) = 0xFFFFFFFF;
+    PORT_REG(port, AHCI_PX_CMD) |= AHCI_PX_CMD_FRE;
+    if (!ahci_wait_reg(&PORT_REG(port, AHCI_PX_TFD), AHCI_TFD_BSY | AHCI_TFD_DRQ, 0, 1000))
+        return false;
+    PORT_REG(port, AHCI_PX_CMD) |= AHCI_PX_CMD_ST;
+    PORT_REG(port, AHCI_PX_IE) = AHCI_PX_IE_MASK;
+    return true;
+}
+
+/// @brief gives the port its command list, fis area and command tables
+/// @param port
+/// @return false if out of frames
+bool ahci_port_alloc(ahci_port* port)
+{
+    // the 1k command list and the 256 byte fis area share a frame
+    uint32_t frame = frame_alloc_zeroed();
+    if (!frame)
+        return false;
+    port->cmdList = (ahci_cmd_header*) frame;
+    port->fis = (uint8_t*) frame + 1024;
+
+    uint32_t perFrame = PAGE_SIZE / AHCI_TABLE_SIZE;
+    for (uint32_t slot = 0; slot < ahci_slots; slot += perFrame)
+    {
+        uint32_t tables = frame_alloc_zeroed();
+        if (!tables)
+            return false;
+        for (uint32_t i = 0; i < perFrame && slot + i < ahci_slots; i++)
+        {
+            port->tables[slot + i] = (ahci_cmd_table*) (tables + i * AHCI_TABLE_SIZE);
+            port->cmdList[slot + i].tableBase = virt_to_phys(port->tables[slot + i]);
+        }
+    }
+
+    PORT_REG(port, AHCI_PX_CLB) = virt_to_phys(port->cmdList);
+    PORT_REG(port, AHCI_PX_CLBU) = 0;
+    PORT_REG(port, AHCI_PX_FB) = virt_to_phys(port->fis);
+    PORT_REG(port, AHCI_PX_FBU) = 0;
+    return true;
+}
+
+/// @brief retires the commands the hba is done with, must be called with the port lock held
+/// @param port
+/// @param status the port's interrupt bits
+/// @return true if a command finished
+bool ahci_port_check(ahci_port* port, uint32_t status)
+{
+    uint32_t finished;
+    if (status & AHCI_PX_IS_ERRORS) {
+        // a failed queued command aborts every other one, they all report the error
+        finished = port->issuedSlots;
+        port->failedSlots |= finished;
+        terminal_write_string("ERROR");
+    } else {
+        finished = port->issuedSlots & ~(PORT_REG(port, AHCI_PX_SACT) | PORT_REG(port, AHCI_PX_CI));
+    }
+    port->issuedSlots &= ~finished;
+    port->doneSlots |= finished;
+    return finished != 0;
+}
+
+/// @brief restarts a port after an error or a timeout, failing what it still had
+/// @param port
+void ahci_port_recover(ahci_port* port)
+{
+    ahci_port_stop(port);
+    uint32_t flags = spin_lock_irqsave(&port->lock);
+    port->failedSlots |= port->issuedSlots;
+    port->doneSlots |= port->issuedSlots;
+    port->issuedSlots = 0;
+    spin_unlock_irqrestore(&port->lock, flags);
+    ahci_port_start(port);
+    wake_all(&port->waiters);
+}
+
+/// @brief the top half, clears the interrupt at the ports and the hba
+/// so the line drops, the commands are retired by the bottom half
+void ahci_irq()
+{
+    uint32_t pending = HBA_REG(AHCI_IS);
+    if (!pending)
+        return;
+    for (uint32_t i = 0; i < AHCI_MAX_PORTS; i++)
+    {
+        if (!(pending & (1u << i)))
+            continue;
+        ahci_port* port = &ahci_ports[i];
+        uint32_t status = PORT_REG(port, AHCI_PX_IS);
+        PORT_REG(port, AHCI_PX_IS) = status;
+        __sync_fetch_and_or(&port->irqStatus, status);
+    }
+    HBA_REG(AHCI_IS) = pending;
+    tasklet_schedule(&ahci_tasklet);
+}
+
+/// @brief the bottom half, wakes the tasks whose commands finished
+/// @param data
+void ahci_complete(uint32_t data)
+{
+    (void) data;
+    for (int i = 0; i < ahci_disks_found; i++)
+    {
+        ahci_port* port = ahci_disks[i];
+        uint32_t status = __sync_fetch_and_and(&port->irqStatus, 0);
+        if (!status)
+            continue;
+
+        uint32_t flags = spin_lock_irqsave(&port->lock);
+        bool finished = ahci_port_check(port, status);
+        spin_unlock_irqrestore(&port->lock, flags);
+
+        if (status & AHCI_PX_IS_ERRORS)
+            ahci_port_recover(port);
+        else if (finished)
+            wake_all(&port->waiters);
+    }
+}
+
+/// @brief takes a free command slot if the port has room, must be called with interrupts disabled
+/// @param port
+/// @param queued false for a command that needs the port to itself
+/// @return the slot, -1 if none can be taken now
+int ahci_try_slot(ahci_port* port, bool queued)
+{
+    int slot = -1;
+    spin_lock(&port->lock);
+    if (!queued) {
+        // waits for the queue to empty, and keeps new queued commands out meanwhile
+        port->draining = true;
+        if (!port->busySlots && !port->exclusive) {
+            port->exclusive = true;
+            port->draining = false;
+            port->busySlots = 1;
+            port->busyCount = 1;
+            slot = 0;
+        }
+    } else if (!port->exclusive && !port->draining && port->busyCount < port->depth) {
+        for (uint32_t i = 0; i < ahci_slots; i++)
+        {
+            if (!(port->busySlots & (1u << i))) {
+                port->busySlots |= 1u << i;
+                port->busyCount++;
+                slot = i;
+                break;
+            }
+        }
+    }
+    spin_unlock(&port->lock);
+    return slot;
+}
+
+/// @brief takes a command slot, sleeping while the port is full
+/// @param port
+/// @param queued
+int ahci_get_slot(ahci_port* port, bool queued)
+{
+    int slot = -1;
+    uint32_t flags = irq_save();
+    // the condition can run twice, so it must not take twice
+    wait_event(&port->waiters, slot >= 0 || (slot = ahci_try_slot(port, queued)) >= 0);
+    irq_restore(flags);
+    return slot;
+}
+
+/// @brief fills the prdt of a slot, one entry per physically contiguous piece
+/// @param table
+/// @param buff
+/// @param bytes
+/// @return the entries used, 0 if the buffer cant be used for dma
+uint16_t ahci_build_prdt(ahci_cmd_table* table, const uint8_t* buff, uint32_t bytes)
+{
+    if ((uint32_t) buff & 1)
+        return 0;
+
+    uint16_t entry = 0;
+    uint32_t done = 0;
+    while (done < bytes)
+    {
+        uint32_t phys = virt_to_phys(buff + done);
+        if (!phys)
+            return 0;
+        uint32_t len = PAGE_SIZE - (phys & (PAGE_SIZE - 1));
+        if (len > bytes - done)
+            len = bytes - done;
+
+        if (entry > 0) {
+            ahci_prd* last = &table->prdt[entry - 1];
+            uint32_t lastLen = (last->byteCount & 0x3FFFFF) + 1;
+            if (last->address + lastLen == phys) {
+                last->byteCount = lastLen + len - 1;
+                done += len;
+                continue;
+            }
+        }
+        if (entry == AHCI_PRDT_ENTRIES)
+            return 0;
+        table->prdt[entry].address = phys;
+        table->prdt[entry].addressHigh = 0;
+        table->prdt[entry].reserved = 0;
+        table->prdt[entry].byteCount = len - 1;
+        entry++;
+        done += len;
+    }
+    if (entry)
+        table->prdt[entry - 1].byteCount |= AHCI_PRD_IRQ;
+    return entry;
+}
+
+/// @brief builds the command of a slot and hands it to the hba
+/// @param port
+/// @param slot
+/// @param command
+/// @param lba
+/// @param count sectors
+/// @param buff the data, 0 for a command without any
+/// @param bytes
+/// @param write
+/// @return false if the buffer cant be used for dma
+bool ahci_issue(ahci_port* port, int slot, uint8_t command, uint64_t lba, uint32_t count, const uint8_t* buff, uint32_t bytes, bool write)
+{
+    ahci_cmd_table* table = port->tables[slot];
+    ahci_cmd_header* header = &port->cmdList[slot];
+    uint16_t entries = 0;
+    if (bytes) {
+        entries = ahci_build_prdt(table, buff, bytes);
+        if (!entries)
+            return false;
+    }
+
+    bool queued = command == AHCI_CMD_READ_FPDMA_QUEUED || command == AHCI_CMD_WRITE_FPDMA_QUEUED;
+    ahci_fis_h2d* fis = (ahci_fis_h2d*) table->commandFis;
+    memset((unsigned char*) fis, 0, sizeof(ahci_fis_h2d));
+    fis->type = AHCI_FIS_H2D;
+    fis->flags = AHCI_FIS_COMMAND;
+    fis->command = command;
+    fis->lba0 = lba & 0xFF;
+    fis->lba1 = (lba >> 8) & 0xFF;
+    fis->lba2 = (lba >> 16) & 0xFF;
+    fis->lba3 = (lba >> 24) & 0xFF;
+    fis->lba4 = (lba >> 32) & 0xFF;
+    fis->lba5 = (lba >> 40) & 0xFF;
+    if (command != AHCI_CMD_IDENTIFY)
+        fis->device = 0x40; // lba addressing
+    if (queued) {
+        // queued commands carry the count in the features and the tag in the count
+        fis->featureLow = count & 0xFF;
+        fis->featureHigh = (count >> 8) & 0xFF;
+        fis->countLow = slot << 3;
+    } else {
+        fis->countLow = count & 0xFF;
+        fis->countHigh = (count >> 8) & 0xFF;
+    }
+
+    header->flags = (sizeof(ahci_fis_h2d) / 4) | (write ? AHCI_HEADER_WRITE : 0);
+    header->prdtLength = entries;
+    header->prdByteCount = 0;
+    asm volatile("" : : : "memory");
+
+    uint32_t flags = spin_lock_irqsave(&port->lock);
+    port->issuedSlots |= 1u << slot;
+    if (queued)
+        PORT_REG(port, AHCI_PX_SACT) = 1u << slot;
+    PORT_REG(port, AHCI_PX_CI) = 1u << slot;
+    spin_unlock_irqrestore(&port->lock, flags);
+    return true;
+}
+
+/// @brief waits for a slot's command and gives the slot back
+/// @param port
+/// @param slot
+/// @return false if the command failed or timed out
+bool ahci_finish(ahci_port* port, int slot)
+{
+    uint32_t bit = 1u << slot;
+    uint32_t flags = irq_save();
+    bool done;
+    if (ahci_irq_ready) {
+        uint32_t deadline = get_ticks() + ns_to_ticks(AHCI_TIMEOUT_MS * 1000000ULL);
+        done = false;
+        while (!done && !time_after_eq(get_ticks(), deadline)) {
+            done = wait_event_timeout(&port->waiters, port->doneSlots & bit, ns_to_ticks(AHCI_RECHECK_MS * 1000000ULL));
+            if (done)
+                break;
+            // pss and dps can come just before ci clears, then no interrupt follows
+            spin_lock(&port->lock);
+            ahci_port_check(port, 0);
+            spin_unlock(&port->lock);
+            done = port->doneSlots & bit;
+        }
+    } else {
+        // without a usable irq line the port is checked between sleeps
+        uint32_t deadline = get_ticks() + ns_to_ticks(AHCI_TIMEOUT_MS * 1000000ULL);
+        while (!(port->doneSlots & bit) && !time_after_eq(get_ticks(), deadline)) {
+            uint32_t status = PORT_REG(port, AHCI_PX_IS);
+            PORT_REG(port, AHCI_PX_IS) = status;
+            spin_lock(&port->lock);
+            ahci_port_check(port, status);
+            spin_unlock(&port->lock);
+            if (!(port->doneSlots & bit)) {
+                irq_restore(flags);
+                task_sleep(1000000);
+                flags = irq_save();
+            }
+        }
+        done = port->doneSlots & bit;
+    }
+    irq_restore(flags);
+
+    if (!done) {
+        terminal_write_string("TIMEOUT");
+        ahci_port_recover(port);
+    }
+
+    flags = spin_lock_irqsave(&port->lock);
+    bool ok = !(port->failedSlots & bit);
+    port->doneSlots &= ~bit;
+    port->failedSlots &= ~bit;
+    port->busySlots &= ~bit;
+    port->busyCount--;
+    port->exclusive = false;
+    spin_unlock_irqrestore(&port->lock, flags);
+    wake_all(&port->waiters);
+    return ok;
+}
+
+/// @brief runs a command that needs the port to itself and waits for it
+/// @param port
+/// @param command
+/// @param lba
+/// @param count
+/// @param buff
+/// @param bytes
+/// @param write
+bool ahci_exclusive(ahci_port* port, uint8_t command, uint64_t lba, uint32_t count, uint8_t* buff, uint32_t bytes, bool write)
+{
+    int slot = ahci_get_slot(port, false);
+    if (!ahci_issue(port, slot, command, lba, count, buff, bytes, write)) {
+        uint32_t flags = spin_lock_irqsave(&port->lock);
+        port->doneSlots |= 1u << slot;
+        port->failedSlots |= 1u << slot;
+        spin_unlock_irqrestore(&port->lock, flags);
+    }
+    return ahci_finish(port, slot);
+}
+
+/// @brief moves sectors, split into commands of AHCI_MAX_SECTORS that are
+/// all in flight together as far as the queue depth allows
+/// @param port
+/// @param lba
+/// @param count
+/// @param buff
+/// @param write
+/// @return false if any part failed
+bool ahci_transfer(ahci_port* port, uint64_t lba, uint32_t count, uint8_t* buff, bool write)
+{
+    if (!port->ncq) {
+        bool ok = true;
+        for (uint32_t done = 0; done < count && ok; done += AHCI_MAX_SECTORS)
+        {
+            uint32_t sectors = count - done < AHCI_MAX_SECTORS ? count - done : AHCI_MAX_SECTORS;
+            uint8_t command = port->lba48 ? (write ? AHCI_CMD_WRITE_DMA_EXT : AHCI_CMD_READ_DMA_EXT)
+                                          : (write ? AHCI_CMD_WRITE_DMA : AHCI_CMD_READ_DMA);
+            ok = ahci_exclusive(port, command, lba + done, sectors, buff + done * 512, sectors * 512, write);
+        }
+        return ok;
+    }
+
+    // the slots this call has in flight, oldest first
+    int inflight[AHCI_MAX_SLOTS];
+    uint32_t head = 0, tail = 0;
+    bool ok = true;
+    uint32_t done = 0;
+    while (done < count)
+    {
+        uint32_t flags = irq_save();
+        int slot = ahci_try_slot(port, true);
+        irq_restore(flags);
+        if (slot < 0) {
+            // our own commands have to finish before we wait for someone else's
+            if (head != tail) {
+                ok = ahci_finish(port, inflight[head++ % AHCI_MAX_SLOTS]) && ok;
+                continue;
+            }
+            slot = ahci_get_slot(port, true);
+        }
+
+        uint32_t sectors = count - done < AHCI_MAX_SECTORS ? count - done : AHCI_MAX_SECTORS;
+        if (!ahci_issue(port, slot, write ? AHCI_CMD_WRITE_FPDMA_QUEUED : AHCI_CMD_READ_FPDMA_QUEUED,
+                        lba + done, sectors, buff + done * 512, sectors * 512, write)) {
+            uint32_t lockFlags = spin_lock_irqsave(&port->lock);
+            port->doneSlots |= 1u << slot;
+            port->failedSlots |= 1u << slot;
+            spin_unlock_irqrestore(&port->lock, lockFlags);
+        }
+        inflight[tail++ % AHCI_MAX_SLOTS] = slot;
+        done += sectors;
+    }
+    while (head != tail)
+        ok = ahci_finish(port, inflight[head++ % AHCI_MAX_SLOTS]) && ok;
+    return ok;
+}
+
+bool ahci_read(block_device* dev, uint64_t lba, uint32_t count, uint8_t* buff)
+{
+    return ahci_transfer((ahci_port*) dev->data, lba, count, buff, false);
+}
+
+bool ahci_write(block_device* dev, uint64_t lba, uint32_t count, const uint8_t* data)
+{
+    return ahci_transfer((ahci_port*) dev->data, lba, count, (uint8_t*) data, true);
+}
+
+/// @brief flushes the drive's write cache, after the queued commands finished
+bool ahci_flush(block_device* dev)
+{
+    ahci_port* port = (ahci_port*) dev->data;
+    return ahci_exclusive(port, port->lba48 ? AHCI_CMD_FLUSH_CACHE_EXT : AHCI_CMD_FLUSH_CACHE, 0, 0, 0, 0, false);
+}
+
+uint32_t ahci_sector_size(block_device* dev)
+{
+    (void) dev;
+    return 512;
+}
+
+uint64_t ahci_capacity(block_device* dev)
+{
+    return ((ahci_port*) dev->data)->sectors;
+}
+
+const block_device_ops ahci_ops = {
+    .read = ahci_read,
+    .write = ahci_write,
+    .flush = ahci_flush,
+    .sector_size = ahci_sector_size,
+    .capacity = ahci_capacity,
+};
+
+/// @brief identifies the disk on a port and picks its queue depth
+/// @param port
+/// @return false if it didnt answer
+bool ahci_identify(ahci_port* port)
+{
+    uint16_t data[256];
+    if (!ahci_exclusive(port, AHCI_CMD_IDENTIFY, 0, 0, (uint8_t*) data, sizeof(data), false))
+        return false;
+
+    ata_identify_string(port->model, data, 27, 20);
+    port->lba48 = data[83] & (1 << 10);
+    port->sectors = port->lba48 ? (uint64_t) data[100] | ((uint64_t) data[101] << 16) |
+                                  ((uint64_t) data[102] << 32) | ((uint64_t) data[103] << 48)
+                                : (uint32_t) data[60] | ((uint32_t) data[61] << 16);
+    // word 76 bit 8 is ncq, word 75 the deepest queue the drive takes minus one
+    port->ncq = ahci_hba_ncq && port->lba48 && (data[76] & (1 << 8));
+    port->depth = 1;
+    if (port->ncq) {
+        port->depth = (data[75] & 0x1F) + 1;
+        if (port->depth > ahci_slots)
+            port->depth = ahci_slots;
+    }
+    return true;
+}
+
+/// @brief sets up a port if a sata disk is attached to it
+/// @param number
+/// @return false if the port has no usable disk
+bool ahci_port_init(uint32_t number)
+{
+    ahci_port* port = &ahci_ports[number];
+    port->regs = ahci_abar + (0x100 + number * 0x80) / 4;
+    port->number = number;
+
+    if ((PORT_REG(port, AHCI_PX_SSTS) & 0xF) != AHCI_SSTS_DET_PRESENT)
+        return false;
+    if (PORT_REG(port, AHCI_PX_SIG) != AHCI_SIG_ATA)
+        return false;
+
+    spin_init(&port->lock, "ahci port");
+    wait_queue_init(&port->waiters);
+    port->busyCount = port->busySlots = port->issuedSlots = port->doneSlots = port->failedSlots = 0;
+    port->exclusive = port->draining = false;
+    port->irqStatus = 0;
+    port->depth = 1;
+
+    if (!ahci_port_stop(port) || !ahci_port_alloc(port))
+        return false;
+    PORT_REG(port, AHCI_PX_CMD) |= AHCI_PX_CMD_SUD | AHCI_PX_CMD_POD;
+    if (!ahci_port_start(port))
+        return false;
+
+    // the bottom half only looks at ports in the disk list
+    ahci_disks[ahci_disks_found++] = port;
+    port->present = true;
+    if (!ahci_identify(port)) {
+        port->present = false;
+        ahci_disks_found--;
+        return false;
+    }
+
+    port->dev.name = "ahci";
+    port->dev.ops = &ahci_ops;
+    port->dev.data = port;
+    return true;
+}
+
+/// @brief takes the hba from the firmware, resets it and sets up the ports with disks
+/// @return true if at least one disk was found
+bool ahci_init(void)
+{
+    pci_entry_desc_t hba;
+    if (!pci_find_class(0x01, 0x06, 0, &hba) || hba.interfaceID != 0x01)
+        return false;
+    bar_t bar = get_base_address_register(hba.bus, hba.device, hba.function, 5);
+    if (bar.type != BAR_MEM_MAP || !bar.addrs)
+        return false;
+    ahci_abar = (volatile uint32_t*) map_mmio((uint32_t) bar.addrs, bar.size ? bar.size : 0x1100);
+    if (!ahci_abar)
+        return false;
+    pci_enable(&hba, PCI_COMMAND_MEMORY | PCI_COMMAND_BUS_MASTER);
+
+    if (HBA_REG(AHCI_CAP2) & AHCI_CAP2_BOH) {
+        HBA_REG(AHCI_BOHC) |= AHCI_BOHC_OOS;
+        ahci_wait_reg(&HBA_REG(AHCI_BOHC), AHCI_BOHC_BOS, 0, 2000);
+    }
+    HBA_REG(AHCI_GHC) |= AHCI_GHC_AE;
+    HBA_REG(AHCI_GHC) |= AHCI_GHC_HR;
+    if (!ahci_wait_reg(&HBA_REG(AHCI_GHC), AHCI_GHC_HR, 0, 1000))
+        return false;
+    HBA_REG(AHCI_GHC) |= AHCI_GHC_AE;
+
+    uint32_t cap = HBA_REG(AHCI_CAP);
+    ahci_slots = ((cap >> 8) & 0x1F) + 1;
+    ahci_hba_ncq = cap & AHCI_CAP_SNCQ;
+
+    // legacy interrupt routing through the pic, the line the firmware assigned
+    uint8_t line = hba.interrupt & 0xFF;
+    tasklet_init(&ahci_tasklet, ahci_complete, 0);
+    if (line > 0 && line < 16 && register_shared_irq_callback(IRQ0 + line, ahci_irq)) {
+        HBA_REG(AHCI_IS) = 0xFFFFFFFF;
+        HBA_REG(AHCI_GHC) |= AHCI_GHC_IE;
+        ahci_irq_ready = true;
+    }
+
+    uint32_t implemented = HBA_REG(AHCI_PI);
+    for (uint32_t i = 0; i < AHCI_MAX_PORTS; i++)
+    {
+        if (implemented & (1u << i))
+            ahci_port_init(i);
+    }
+    return ahci_disks_found > 0;
+}
+
+/// @brief returns how many disks were found
+int ahci_disk_count(void)
+{
+    return ahci_disks_found;
+}
+
+/// @brief returns a disk found by ahci_init
+/// @param index
+/// @return 0 past the last disk
+ahci_port* ahci_get_disk(int index)
+{
+    return index < ahci_disks_found ? ahci_disks[index] : 0;
+}
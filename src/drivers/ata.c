@@ -1,11 +1,130 @@
 #include <drivers/ata.h>
 #include <hardwarecomms/portio.h>
 #include <io/screen.h>
+#include <hardwarecomms/pit.h>
+#include <multitasking.h>
+#include <timer.h>
+#include <common/tools.h>
+#include <hardwarecomms/pci.h>
+#include <paging.h>
+#include <hardwarecomms/isr.h>
+#include <hardwarecomms/softirq.h>
+#include <sync.h>
 
+#define ATA_TIMEOUT_MS 5000
+#define ATA_SPIN_POLLS 1000 // polls before the wait starts sleeping between them
 
+enum ATA_COMMANDS {
+    ATA_CMD_READ_SECTORS = 0x20,
+    ATA_CMD_READ_SECTORS_EXT = 0x24,
+    ATA_CMD_READ_MULTIPLE_EXT = 0x29,
+    ATA_CMD_WRITE_SECTORS = 0x30,
+    ATA_CMD_WRITE_SECTORS_EXT = 0x34,
+    ATA_CMD_WRITE_MULTIPLE_EXT = 0x39,
+    ATA_CMD_READ_DMA_EXT = 0x25,
+    ATA_CMD_WRITE_DMA_EXT = 0x35,
+    ATA_CMD_READ_DMA = 0xC8,
+    ATA_CMD_WRITE_DMA = 0xCA,
+    ATA_CMD_READ_MULTIPLE = 0xC4,
+    ATA_CMD_WRITE_MULTIPLE = 0xC5,
+    ATA_CMD_SET_MULTIPLE = 0xC6,
+    ATA_CMD_FLUSH_CACHE = 0xE7,
+    ATA_CMD_FLUSH_CACHE_EXT = 0xEA,
+    ATA_CMD_IDENTIFY = 0xEC,
+};
 
+#define ATA_STATUS_ERR 0x01
+#define ATA_STATUS_DRQ 0x08
 
+// bus master registers, from the channel's base in bar 4
+enum ATA_BUS_MASTER {
+    ATA_BM_COMMAND = 0x0,
+    ATA_BM_STATUS = 0x2,
+    ATA_BM_PRDT = 0x4,
+};
 
+#define ATA_BM_START 0x01
+#define ATA_BM_READ 0x08 // the bus master writes memory
+#define ATA_BM_STATUS_ERR 0x02
+#define ATA_BM_STATUS_IRQ 0x04
+#define ATA_BM_STATUS_DMA0 0x20 // set by the firmware when the master is dma capable
+#define ATA_BM_STATUS_DMA1 0x40
+
+// a physical region descriptor, one contiguous piece of a dma buffer
+typedef struct {
+    uint32_t address;
+    uint16_t byteCount; // 0 means 64k
+    uint16_t flags;
+} __attribute__((packed)) ata_prd;
+
+#define ATA_PRD_EOT 0x8000 // the last entry of the table
+#define ATA_PRD_ENTRIES 64
+
+// one table per channel, 512 bytes aligned to 512 never crosses a 64k boundary
+ata_prd ata_prd_tables[2][ATA_PRD_ENTRIES] __attribute__((aligned(512)));
+
+// the interrupt state of a channel, both drives on it share the irq line
+typedef struct {
+    completion_t done;
+    tasklet_t tasklet;
+    uint16_t commandPort;
+    bool irqReady;
+} ata_channel;
+
+ata_channel ata_channels[2];
+
+/// @brief returns the channel a drive sits on
+/// @param drive 
+ata_channel* ata_get_channel(ata_drive* drive)
+{
+    return &ata_channels[drive->dataPort == 0x170 ? 1 : 0];
+}
+
+/// @brief the bottom half, wakes the task waiting on the channel
+/// @param data the channel
+void ata_irq_bottom(uint32_t data)
+{
+    complete(&((ata_channel*) data)->done);
+}
+
+/// @brief the top half of irq 14, reading the status acknowledges the drive
+void ata_primary_irq()
+{
+    inb(ata_channels[0].commandPort);
+    tasklet_schedule(&ata_channels[0].tasklet);
+}
+
+/// @brief the top half of irq 15
+void ata_secondary_irq()
+{
+    inb(ata_channels[1].commandPort);
+    tasklet_schedule(&ata_channels[1].tasklet);
+}
+
+/// @brief hooks the irq of the drive's channel, once per channel
+/// @param drive 
+void ata_irq_init(ata_drive* drive)
+{
+    ata_channel* channel = ata_get_channel(drive);
+    if (channel->irqReady)
+        return;
+    completion_init(&channel->done);
+    tasklet_init(&channel->tasklet, ata_irq_bottom, (uint32_t) channel);
+    channel->commandPort = drive->commandPort;
+    if (channel == &ata_channels[1])
+        register_irq_callback(IRQ15, ata_secondary_irq);
+    else
+        register_irq_callback(IRQ14, ata_primary_irq);
+    channel->irqReady = true;
+}
+
+/// @brief arms the channel's completion, called before a command is sent
+/// so an irq that comes right away isnt lost
+/// @param drive 
+void ata_prepare_irq(ata_drive* drive)
+{
+    completion_reset(&ata_get_channel(drive)->done);
+}
 
 /// @brief creates the drive struct
 /// @param master is the drive a master or a slave
@@ -26,149 +145,464 @@ ata_drive create_ata(bool master, uint16_t portBase)
     nDrive.controlPort = portBase + 0x206;
 
     nDrive.master = master;
+    nDrive.identified = false;
+    nDrive.model[0] = 0;
+    nDrive.serial[0] = 0;
+    nDrive.lba28Sectors = 0;
+    nDrive.lba48Sectors = 0;
+    nDrive.totalSectors = 0;
+    nDrive.maxMultiple = 0;
+    nDrive.dmaModes = 0;
+    nDrive.udmaModes = 0;
+    nDrive.lba48 = false;
+    nDrive.writeCache = false;
+    nDrive.flushExt = false;
+    nDrive.multipleSectors = 0;
+    nDrive.mode = ATA_MODE_PIO;
+    nDrive.busMasterPort = 0;
 
     return nDrive;
 }
 
 
-/// @brief identifies a ata drive
-/// @param drive the drive to id
-void identify(ata_drive drive)
+/// @brief waits for the drive to finish the last command, giving up at a deadline
+/// @param drive 
+/// @param timeout_ms 
+/// @return the status, a timeout reports the error bit
+uint8_t ata_poll(ata_drive drive, uint32_t timeout_ms)
 {
-    outb(drive.devicePort, drive.master ? 0xA0 : 0xB0);
-    outb(drive.controlPort, 0);
+    uint32_t deadline = get_ticks() + ns_to_ticks(timeout_ms * 1000000ULL);
+    uint32_t polls = 0;
 
-    outb(drive.devicePort, 0xA0);
     uint8_t status = inb(drive.commandPort);
+    while(((status & 0x80) == 0x80) && ((status & 0x01) != 0x01))
+    {
+        if (time_after_eq(get_ticks(), deadline)) {
+            terminal_write_string("TIMEOUT");
+            return 0x01;
+        }
+        // most commands are done within a few polls, a slow drive
+        // lets other tasks run instead of holding the cpu
+        if (++polls > ATA_SPIN_POLLS)
+            task_sleep(1000000);
+        status = inb(drive.commandPort);
+    }
+    return status;
+}
+
+/// @brief sleeps until the drive raises its irq, other tasks run during the disk wait
+/// @param drive a drive whose command was sent after ata_prepare_irq
+/// @return the status, a timeout reports the error bit
+uint8_t ata_wait_irq(ata_drive* drive)
+{
+    ata_channel* channel = ata_get_channel(drive);
+    if (!channel->irqReady)
+        return ata_poll(*drive, ATA_TIMEOUT_MS);
+
+    if (!wait_for_completion_timeout(&channel->done, ATA_TIMEOUT_MS * 1000000ULL)) {
+        terminal_write_string("TIMEOUT");
+        return ATA_STATUS_ERR;
+    }
+    // armed again here, the next block's irq can come as soon as the data moves
+    completion_reset(&channel->done);
+    // the alternate status doesnt acknowledge another irq
+    return inb(drive->controlPort);
+}
+
+/// @brief copies an IDENTIFY string, its words hold the characters high byte first
+/// @param dest gets words * 2 characters without the trailing spaces
+/// @param data the IDENTIFY words
+/// @param first the first word of the string
+/// @param words 
+void ata_identify_string(char* dest, uint16_t* data, int first, int words)
+{
+    for (int i = 0; i < words; i++)
+    {
+        dest[i * 2] = (data[first + i] >> 8) & 0xFF;
+        dest[i * 2 + 1] = data[first + i] & 0xFF;
+    }
+    int len = words * 2;
+    while (len > 0 && dest[len - 1] == ' ')
+        len--;
+    dest[len] = 0;
+}
+
+/// @brief identifies a ata drive and turns on multiple sector transfers if it has them
+/// @param drive the drive to id
+/// @return false if there is no drive or it didnt answer
+bool identify(ata_drive* drive)
+{
+    outb(drive->devicePort, drive->master ? 0xA0 : 0xB0);
+    outb(drive->controlPort, 0);
+
+    outb(drive->devicePort, 0xA0);
+    uint8_t status = inb(drive->commandPort);
     if (status == 0xFF)
-        return;
+        return false;
         
     
-    outb(drive.devicePort, drive.master ? 0xA0 : 0xB0);
-    outb(drive.sectorCountPort, 0);
-    outb(drive.lbaLowPort, 0);
-    outb(drive.lbaMidPort, 0);
-    outb(drive.lbaHiPort, 0);
-    outb(drive.commandPort, 0xEC); // identify command
-
-    status = inb(drive.commandPort);
+    outb(drive->devicePort, drive->master ? 0xA0 : 0xB0);
+    outb(drive->sectorCountPort, 0);
+    outb(drive->lbaLowPort, 0);
+    outb(drive->lbaMidPort, 0);
+    outb(drive->lbaHiPort, 0);
+    outb(drive->commandPort, ATA_CMD_IDENTIFY);
+
+    status = inb(drive->commandPort);
     if(status == 0x00)
-        return;
+        return false;
     
-    while(((status & 0x80) == 0x80) && ((status & 0x01) != 0x01))
-        status = inb(drive.commandPort);
-    
-    if(status & 0x01)
+    status = ata_poll(*drive, ATA_TIMEOUT_MS);
+    if(status & ATA_STATUS_ERR)
     {
         terminal_write_string("ERROR");
-        return;
+        return false;
+    }
+
+    uint16_t data[256];
+    insw(drive->dataPort, data, 256);
+
+    ata_identify_string(drive->serial, data, 10, 10);
+    ata_identify_string(drive->model, data, 27, 20);
+    drive->lba28Sectors = (uint32_t) data[60] | ((uint32_t) data[61] << 16);
+    drive->lba48 = data[83] & (1 << 10);
+    drive->lba48Sectors = drive->lba48 ? (uint64_t) data[100] | ((uint64_t) data[101] << 16) |
+                                         ((uint64_t) data[102] << 32) | ((uint64_t) data[103] << 48) : 0;
+    drive->totalSectors = drive->lba48 ? drive->lba48Sectors : drive->lba28Sectors;
+    drive->maxMultiple = data[47] & 0xFF;
+    drive->dmaModes = data[63] & 0x07;
+    // word 88 is only valid when word 53 bit 2 says so
+    drive->udmaModes = (data[53] & (1 << 2)) ? (data[88] & 0x7F) : 0;
+    drive->writeCache = data[85] & (1 << 5); // enabled, word 82 only says it is supported
+    drive->flushExt = data[83] & (1 << 13);
+
+    drive->identified = true;
+
+    drive->multipleSectors = 0;
+    drive->mode = ATA_MODE_PIO;
+    if (drive->maxMultiple) {
+        outb(drive->devicePort, drive->master ? 0xA0 : 0xB0);
+        outb(drive->sectorCountPort, drive->maxMultiple);
+        outb(drive->commandPort, ATA_CMD_SET_MULTIPLE);
+        if (!(ata_poll(*drive, ATA_TIMEOUT_MS) & ATA_STATUS_ERR)) {
+            drive->multipleSectors = drive->maxMultiple;
+            drive->mode = ATA_MODE_PIO_MULTIPLE;
+        }
+    }
+    ata_irq_init(drive);
+    return true;
+}
+
+/// @brief sends the registers of an lba28 command and the command itself
+/// @param drive 
+/// @param lba 
+/// @param count sectors, 256 is sent as 0
+/// @param command 
+void ata_command28(ata_drive* drive, uint32_t lba, uint32_t count, uint8_t command)
+{
+    outb(drive->devicePort, (drive->master ? 0xE0 : 0xF0) | ((lba & 0x0F000000) >> 24));
+    outb(drive->errorPort, 0);
+    outb(drive->sectorCountPort, count & 0xFF);
+    outb(drive->lbaLowPort, lba & 0x000000FF);
+    outb(drive->lbaMidPort, (lba & 0x0000FF00) >> 8);
+    outb(drive->lbaHiPort, (lba & 0x00FF0000) >> 16);
+    outb(drive->commandPort, command);
+}
+
+/// @brief sends the registers of an lba48 command and the command itself,
+/// each register takes the high byte first
+/// @param drive 
+/// @param lba 
+/// @param count sectors, 65536 is sent as 0
+/// @param command 
+void ata_command48(ata_drive* drive, uint64_t lba, uint32_t count, uint8_t command)
+{
+    outb(drive->devicePort, drive->master ? 0x40 : 0x50);
+    outb(drive->sectorCountPort, (count >> 8) & 0xFF);
+    outb(drive->lbaLowPort, (lba >> 24) & 0xFF);
+    outb(drive->lbaMidPort, (lba >> 32) & 0xFF);
+    outb(drive->lbaHiPort, (lba >> 40) & 0xFF);
+    outb(drive->sectorCountPort, count & 0xFF);
+    outb(drive->lbaLowPort, lba & 0xFF);
+    outb(drive->lbaMidPort, (lba >> 8) & 0xFF);
+    outb(drive->lbaHiPort, (lba >> 16) & 0xFF);
+    outb(drive->commandPort, command);
+}
+
+/// @brief starts a transfer, lba28 when the range and count allow it since it needs fewer port writes
+/// @param drive 
+/// @param lba 
+/// @param count 
+/// @param command28 the command if lba28 is used
+/// @param command48 the command if lba48 is used
+/// @return false if the drive cant address the range
+bool ata_start_transfer(ata_drive* drive, uint64_t lba, uint32_t count, uint8_t command28, uint8_t command48)
+{
+    if(count == 0)
+        return false;
+
+    if(count <= ATA_MAX_SECTORS && lba + count <= 0x10000000) {
+        ata_command28(drive, lba, count, command28);
+        return true;
+    }
+    if(drive->lba48 && count <= ATA_MAX_SECTORS_EXT && lba + count <= 0x1000000000000ULL) {
+        ata_command48(drive, lba, count, command48);
+        return true;
     }
+    return false;
+}
+
+/// @brief fills the prd table of the drive's channel, a region may not cross
+/// a 64k boundary and pages of the user window arent contiguous
+/// @param drive 
+/// @param directory the address space buff is in, 0 for the running task's
+/// @param buff 
+/// @param bytes 
+/// @return false if the buffer cant be used for dma
+bool ata_build_prd(ata_drive* drive, uint32_t* directory, const uint8_t* buff, uint32_t bytes)
+{
+    ata_prd* table = ata_prd_tables[drive->busMasterPort & 0x8 ? 1 : 0];
+    if((uint32_t) buff & 1)
+        return false;
 
-    for(int i = 0; i < 256; i++)
+    int entry = 0;
+    uint32_t done = 0;
+    while(done < bytes)
     {
-        uint16_t data = inw(drive.dataPort);
-        char *text = "  \0";
-        text[0] = (data >> 8) & 0xFF;
-        text[1] = data & 0xFF;
+        uint32_t phys = virt_to_phys_in(directory, buff + done);
+        if(!phys || entry == ATA_PRD_ENTRIES)
+            return false;
+        uint32_t len = PAGE_SIZE - (phys & (PAGE_SIZE - 1));
+        if(len > bytes - done)
+            len = bytes - done;
+
+        // extends the last region while memory stays contiguous
+        if(entry > 0) {
+            ata_prd* last = &table[entry - 1];
+            uint32_t lastLen = last->byteCount ? last->byteCount : 0x10000;
+            if(last->address + lastLen == phys && ((phys ^ last->address) & 0xFFFF0000) == 0 && lastLen + len <= 0x10000) {
+                last->byteCount = (lastLen + len) & 0xFFFF;
+                done += len;
+                continue;
+            }
+        }
+        table[entry].address = phys;
+        table[entry].byteCount = len;
+        table[entry].flags = 0;
+        entry++;
+        done += len;
     }
+    table[entry - 1].flags = ATA_PRD_EOT;
+    outl(drive->busMasterPort + ATA_BM_PRDT, virt_to_phys(table));
+    return true;
 }
 
-/// @brief reads from a specified sector in the drive
+/// @brief runs a transfer through the bus master, the cpu only sets it up and waits
+/// @param drive has its prd table filled by ata_build_prd
+/// @param lba 
+/// @param count 
+/// @param write 
+/// @return false on a drive or bus error
+bool ata_dma_transfer(ata_drive* drive, uint64_t lba, uint32_t count, bool write)
+{
+    uint16_t bm = drive->busMasterPort;
+    // the direction bit is from the point of view of the bus master, set means it writes memory
+    outb(bm + ATA_BM_COMMAND, write ? 0 : ATA_BM_READ);
+    outb(bm + ATA_BM_STATUS, inb(bm + ATA_BM_STATUS) | ATA_BM_STATUS_ERR | ATA_BM_STATUS_IRQ);
+
+    ata_prepare_irq(drive);
+    bool started = write ? ata_start_transfer(drive, lba, count, ATA_CMD_WRITE_DMA, ATA_CMD_WRITE_DMA_EXT)
+                         : ata_start_transfer(drive, lba, count, ATA_CMD_READ_DMA, ATA_CMD_READ_DMA_EXT);
+    if(!started)
+        return false;
+    outb(bm + ATA_BM_COMMAND, (write ? 0 : ATA_BM_READ) | ATA_BM_START);
+
+    uint8_t status = ata_wait_irq(drive);
+    uint8_t bmStatus = inb(bm + ATA_BM_STATUS);
+    outb(bm + ATA_BM_COMMAND, 0);
+    outb(bm + ATA_BM_STATUS, bmStatus | ATA_BM_STATUS_ERR | ATA_BM_STATUS_IRQ);
+
+    if((status & ATA_STATUS_ERR) || (bmStatus & ATA_BM_STATUS_ERR))
+    {
+        terminal_write_string("ERROR");
+        return false;
+    }
+    return true;
+}
+
+/// @brief finds the bus master of the drive's ide controller and switches the drive to dma
+/// @param drive an identified drive on one of the legacy channels
+/// @return true if the drive uses dma from now on
+bool ata_dma_init(ata_drive* drive)
+{
+    if(!drive->identified || (!drive->dmaModes && !drive->udmaModes))
+        return false;
+
+    pci_entry_desc_t ide;
+    if(!pci_find_class(0x01, 0x01, 0, &ide))
+        return false;
+    // bit 7 of the programming interface says the controller can bus master
+    if(!(ide.interfaceID & 0x80))
+        return false;
+    bar_t bar = get_base_address_register(ide.bus, ide.device, ide.function, 4);
+    if(bar.type != BAR_IO || !bar.addrs)
+        return false;
+
+    pci_enable(&ide, PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+    // the secondary channel's registers come 8 ports after the primary's
+    drive->busMasterPort = (uint32_t) bar.addrs + (drive->dataPort == 0x170 ? 8 : 0);
+    outb(drive->busMasterPort + ATA_BM_STATUS, inb(drive->busMasterPort + ATA_BM_STATUS) | (drive->master ? ATA_BM_STATUS_DMA0 : ATA_BM_STATUS_DMA1));
+    drive->mode = ATA_MODE_DMA;
+    return true;
+}
+
+/// @brief reads whole sectors with a single command, in blocks
+/// of multipleSectors per data request when the drive supports it
+/// @param drive 
+/// @param directory the address space buff is in, 0 for the running task's
+/// @param lba the first sector
+/// @param count sectors to read, at most ATA_MAX_SECTORS_EXT on an lba48 drive
+/// @param buff gets count * 512 bytes
+/// @return false on a drive error or timeout
+bool ata_read(ata_drive* drive, uint32_t* directory, uint64_t lba, uint32_t count, uint8_t* buff)
+{
+    // buffers the bus master cant reach, like odd addresses, fall back to pio
+    if(drive->mode == ATA_MODE_DMA && ata_build_prd(drive, directory, buff, count * 512))
+        return ata_dma_transfer(drive, lba, count, false);
+
+    ata_prepare_irq(drive);
+    if(!ata_start_transfer(drive, lba, count, drive->multipleSectors ? ATA_CMD_READ_MULTIPLE : ATA_CMD_READ_SECTORS,
+                           drive->multipleSectors ? ATA_CMD_READ_MULTIPLE_EXT : ATA_CMD_READ_SECTORS_EXT))
+        return false;
+
+    uint32_t block = drive->multipleSectors ? drive->multipleSectors : 1;
+
+    for(uint32_t done = 0; done < count; )
+    {
+        // each block raises the irq once its data is ready
+        uint8_t status = ata_wait_irq(drive);
+        if((status & ATA_STATUS_ERR) || !(status & ATA_STATUS_DRQ))
+        {
+            terminal_write_string("ERROR");
+            return false;
+        }
+
+        uint32_t sectors = count - done < block ? count - done : block;
+        insw(drive->dataPort, buff + done * 512, sectors * 256);
+        done += sectors;
+    }
+    return true;
+}
+
+/// @brief writes whole sectors with a single command, in blocks
+/// of multipleSectors per data request when the drive supports it
+/// @param drive 
+/// @param directory the address space data is in, 0 for the running task's
+/// @param lba the first sector
+/// @param count sectors to write, at most ATA_MAX_SECTORS_EXT on an lba48 drive
+/// @param data count * 512 bytes
+/// @return false on a drive error or timeout
+bool ata_write(ata_drive* drive, uint32_t* directory, uint64_t lba, uint32_t count, const uint8_t* data)
+{
+    if(drive->mode == ATA_MODE_DMA && ata_build_prd(drive, directory, data, count * 512))
+        return ata_dma_transfer(drive, lba, count, true);
+
+    ata_prepare_irq(drive);
+    if(!ata_start_transfer(drive, lba, count, drive->multipleSectors ? ATA_CMD_WRITE_MULTIPLE : ATA_CMD_WRITE_SECTORS,
+                           drive->multipleSectors ? ATA_CMD_WRITE_MULTIPLE_EXT : ATA_CMD_WRITE_SECTORS_EXT))
+        return false;
+
+    uint32_t block = drive->multipleSectors ? drive->multipleSectors : 1;
+
+    for(uint32_t done = 0; done < count; )
+    {
+        // the drive asks for the first block without an irq, the
+        // following ones come with one each
+        uint8_t status = done == 0 ? ata_poll(*drive, ATA_TIMEOUT_MS) : ata_wait_irq(drive);
+        if((status & ATA_STATUS_ERR) || !(status & ATA_STATUS_DRQ))
+        {
+            terminal_write_string("ERROR");
+            return false;
+        }
+
+        uint32_t sectors = count - done < block ? count - done : block;
+        outsw(drive->dataPort, data + done * 512, sectors * 256);
+        done += sectors;
+    }
+
+    // the last block is written once the drive raises the irq again
+    if(ata_wait_irq(drive) & ATA_STATUS_ERR)
+    {
+        terminal_write_string("ERROR");
+        return false;
+    }
+    return true;
+}
+
+/// @brief reads from a specified sector in the drive,
+/// past lba28 only if the drive has lba48
 /// @param drive 
 /// @param sectorNum
 /// @param buff buffer in which read data will be stored
 /// @param count the amount of bytes to read
 void read28(ata_drive drive, uint32_t sectorNum, uint8_t* buff, int count) {
-    if(sectorNum > 0x0FFFFFFF)
+    if(count <= 0)
         return;
-    
-    
-    outb(drive.devicePort, (drive.master ? 0xE0 : 0xF0) | ((sectorNum & 0x0F000000) >> 24));
-    outb(drive.errorPort, 0);
-    outb(drive.sectorCountPort, 1);
-    outb(drive.lbaLowPort, sectorNum & 0x000000FF);
-    outb(drive.lbaMidPort, (sectorNum & 0x0000FF00) >> 8);
-    outb(drive.lbaHiPort, (sectorNum & 0x00FF0000) >> 16);
-    outb(drive.commandPort, 0x20); // identify command
 
-    uint8_t status = inb(drive.commandPort);
-
-    while(((status & 0x80) == 0x80) && ((status & 0x01) != 0x01))
-        status = inb(drive.commandPort);
-    
-    if(status & 0x01)
-    {
-        terminal_write_string("ERROR");
+    if(count >= 512) {
+        ata_read(&drive, 0, sectorNum, 1, buff);
         return;
     }
 
-    for(int i = 0; i < count; i+=2)
-    {
-        uint16_t wdata = inw(drive.dataPort);
-        buff[i] =  wdata & 0xFF;
-        if(i+1 < count)
-            buff[i + 1] = (wdata >> 8) & 0xFF;
-    }
-
-    // reads the rest of the sector
-    for(int i = count + (count%2); i < 512; i += 2)
-        inw(drive.dataPort);
+    // a partial sector goes through a bounce buffer, the data port only moves whole sectors
+    uint8_t bounce[512];
+    if(ata_read(&drive, 0, sectorNum, 1, bounce))
+        memcpy(buff, bounce, count);
 }
 
 /// @brief writes to a specifed sector in the drive
 /// @param drive 
 /// @param sectorNum 
 /// @param data the data to write
-/// @param count amount of bytes to write
+/// @param count amount of bytes to write, the rest of the sector is zeroed
 void write28(ata_drive drive, uint32_t sectorNum, uint8_t *data, uint32_t count) {
-    if(sectorNum > 0x0FFFFFFF)
-        return;
-    
     if (count > 512)
         return;
-    outb(drive.devicePort, (drive.master ? 0xE0 : 0xF0) | ((sectorNum & 0x0F000000) >> 24));
-    outb(drive.errorPort, 0);
-    outb(drive.sectorCountPort, 1);
-    outb(drive.lbaLowPort, sectorNum & 0x000000FF);
-    outb(drive.lbaMidPort, (sectorNum & 0x0000FF00) >> 8);
-    outb(drive.lbaHiPort, (sectorNum & 0x00FF0000) >> 16);
-    outb(drive.commandPort, 0x30); // identify command
-
-    uint8_t status = inb(drive.commandPort);
-    
-    for(int i = 0; i < ((int)count); i+=2)
-    {
-        uint16_t wdata = data[i];
-        if(i+1 < ((int)count))
-            wdata |= ((uint16_t)data[i+1]) << 8;
 
-        outw(drive.dataPort, wdata);
+    if(count == 512) {
+        ata_write(&drive, 0, sectorNum, 1, data);
+        return;
     }
 
-    // reads the rest of the sector
-    for(int i = count + (count%2); i < 512; i += 2)
-        outw(drive.dataPort, 0x0000);
+    uint8_t bounce[512];
+    memcpy(bounce, data, count);
+    memset(bounce + count, 0, 512 - count);
+    ata_write(&drive, 0, sectorNum, 1, bounce);
 }
 
 
 /// @brief flashes drive to make updates perm
 /// @param drive 
-void flush(ata_drive drive) {
+/// @return false if the drive reported an error
+bool flush(ata_drive drive) {
+    // without a write cache every write is already on the media
+    if (drive.identified && !drive.writeCache)
+        return true;
+
+    ata_prepare_irq(&drive);
     outb(drive.devicePort, drive.master ? 0xE0 : 0xF0);
-    outb(drive.commandPort, 0xE7);
+    outb(drive.commandPort, drive.lba48 && drive.flushExt ? ATA_CMD_FLUSH_CACHE_EXT : ATA_CMD_FLUSH_CACHE);
 
     uint8_t status = inb(drive.commandPort);
     if(status == 0x00)
-        return;
-    
-    while(((status & 0x80) == 0x80) && ((status & 0x01) != 0x01))
-        status = inb(drive.commandPort);
+        return false;
     
+    status = ata_wait_irq(&drive);
     if(status & 0x01)
     {
         terminal_write_string("ERROR");
-        return;
+        return false;
     }
-
+    return true;
 }
 
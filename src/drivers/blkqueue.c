@@ -0,0 +1,436 @@
+#include <drivers/blkqueue.h>
+#include <memorymanagement.h>
+#include <common/tools.h>
+#include <hardwarecomms/cpu.h>
+#include <hardwarecomms/pit.h>
+#include <timer.h>
+#include <paging.h>
+
+blk_queue blk_queues[BLK_MAX_QUEUES];
+int blk_queue_count = 0;
+task_t* blk_worker = 0;
+wait_queue_t blk_work; // the worker waits here for requests
+
+/// @brief returns the queue in front of a drive
+/// @param drive
+/// @return 0 if the drive has none
+blk_queue* blk_find_queue(ata_drive* drive)
+{
+    for (int i = 0; i < blk_queue_count; i++)
+    {
+        if (blk_queues[i].drive.dataPort == drive->dataPort && blk_queues[i].drive.master == drive->master)
+            return &blk_queues[i];
+    }
+    return 0;
+}
+
+/// @brief checks if a queued or running write touches the sectors
+/// @param queue
+/// @param lba
+/// @param count
+bool blk_write_overlaps(blk_queue* queue, uint64_t lba, uint32_t count)
+{
+    bool overlaps = false;
+    uint32_t flags = spin_lock_irqsave(&queue->lock);
+    blk_request* active = queue->active;
+    if (active && active->op == BLK_OP_WRITE && active->lba < lba + count && lba < active->lba + active->count)
+        overlaps = true;
+    for (blk_request* req = queue->pending; req && !overlaps; req = req->next)
+    {
+        if (req->op == BLK_OP_WRITE && req->lba < lba + count && lba < req->lba + req->count)
+            overlaps = true;
+    }
+    spin_unlock_irqrestore(&queue->lock, flags);
+    return overlaps;
+}
+
+/// @brief queues a bio, it joins a queued request of the same op when their sectors meet
+/// @param queue
+/// @param bio
+/// @param op
+/// @return false if there was no memory for a new request
+bool blk_submit(blk_queue* queue, blk_bio* bio, uint8_t op)
+{
+    // allocated up front, malloc isnt called under the queue lock
+    blk_request* fresh = (blk_request*) malloc(sizeof(blk_request));
+    bio->next = 0;
+
+    uint32_t flags = spin_lock_irqsave(&queue->lock);
+    queue->stats.submitted++;
+    blk_request* merged = 0;
+    for (blk_request* req = queue->pending; req && op != BLK_OP_FLUSH; req = req->next)
+    {
+        if (req->op != op || req->count + bio->count > BLK_MAX_SECTORS)
+            continue;
+        if (req->lba + req->count == bio->lba) {
+            req->lastBio->next = bio;
+            req->lastBio = bio;
+        } else if (bio->lba + bio->count == req->lba) {
+            bio->next = req->bios;
+            req->bios = bio;
+            req->lba = bio->lba;
+        } else {
+            continue;
+        }
+        // keeps the deadline of the older request
+        req->count += bio->count;
+        merged = req;
+        queue->stats.merged++;
+        break;
+    }
+
+    if (!merged) {
+        if (!fresh) {
+            queue->stats.submitted--;
+            spin_unlock_irqrestore(&queue->lock, flags);
+            return false;
+        }
+        uint32_t expire = op == BLK_OP_READ ? BLK_READ_EXPIRE_MS : BLK_WRITE_EXPIRE_MS;
+        fresh->next = 0;
+        fresh->lba = bio->lba;
+        fresh->count = bio->count;
+        fresh->op = op;
+        fresh->deadline = get_ticks() + ns_to_ticks(expire * 1000000ULL);
+        fresh->bios = fresh->lastBio = bio;
+
+        blk_request** tail = &queue->pending;
+        while (*tail)
+            tail = &(*tail)->next;
+        *tail = fresh;
+    }
+    if (op == BLK_OP_WRITE)
+        queue->queuedWrites++;
+    spin_unlock_irqrestore(&queue->lock, flags);
+
+    if (merged && fresh)
+        free(fresh);
+    wake_one(&blk_work);
+    return true;
+}
+
+/// @brief picks the next request, must be called with the queue lock held.
+/// reads go first unless writes waited too long, a request past its deadline
+/// goes before the others, the rest are taken in c-look order
+/// @param queue
+/// @return 0 if nothing is pending
+blk_request* blk_pick(blk_queue* queue)
+{
+    blk_request* oldest[2] = { 0, 0 };
+    for (blk_request* req = queue->pending; req; req = req->next)
+    {
+        // a flush waited for the writes before it, nothing has to be ordered around it
+        if (req->op == BLK_OP_FLUSH)
+            return req;
+        if (!oldest[req->op])
+            oldest[req->op] = req;
+    }
+    if (!oldest[BLK_OP_READ] && !oldest[BLK_OP_WRITE])
+        return 0;
+
+    uint8_t op;
+    if (oldest[BLK_OP_READ] && (!oldest[BLK_OP_WRITE] || queue->writesStarved < BLK_WRITES_STARVED)) {
+        op = BLK_OP_READ;
+        if (oldest[BLK_OP_WRITE])
+            queue->writesStarved++;
+    } else {
+        op = BLK_OP_WRITE;
+        queue->writesStarved = 0;
+    }
+
+    if (time_after_eq(get_ticks(), oldest[op]->deadline)) {
+        queue->stats.expired++;
+        return oldest[op];
+    }
+
+    // the closest request past the head, or the lowest one once the sweep is over
+    blk_request* ahead = 0;
+    blk_request* lowest = 0;
+    for (blk_request* req = queue->pending; req; req = req->next)
+    {
+        if (req->op != op)
+            continue;
+        if (req->lba >= queue->head && (!ahead || req->lba < ahead->lba))
+            ahead = req;
+        if (!lowest || req->lba < lowest->lba)
+            lowest = req;
+    }
+    return ahead ? ahead : lowest;
+}
+
+/// @brief sends a request to the drive, merged bios go through the bounce buffer.
+/// bios only point at the heap, the submitters copied anything else
+/// @param queue
+/// @param req
+/// @return false on a drive error
+bool blk_run(blk_queue* queue, blk_request* req)
+{
+    if (req->op == BLK_OP_FLUSH)
+        return flush(queue->drive);
+    bool write = req->op == BLK_OP_WRITE;
+    if (req->bios == req->lastBio) {
+        blk_bio* bio = req->bios;
+        return write ? ata_write(&queue->drive, bio->directory, req->lba, req->count, bio->buff)
+                     : ata_read(&queue->drive, bio->directory, req->lba, req->count, bio->buff);
+    }
+
+    if (write) {
+        for (blk_bio* bio = req->bios; bio; bio = bio->next)
+            memcpy(queue->bounce + (bio->lba - req->lba) * 512, bio->buff, bio->count * 512);
+        return ata_write(&queue->drive, kernel_directory, req->lba, req->count, queue->bounce);
+    }
+    if (!ata_read(&queue->drive, kernel_directory, req->lba, req->count, queue->bounce))
+        return false;
+    for (blk_bio* bio = req->bios; bio; bio = bio->next)
+        memcpy(bio->buff, queue->bounce + (bio->lba - req->lba) * 512, bio->count * 512);
+    return true;
+}
+
+/// @brief takes the next request off a queue and runs it
+/// @param queue
+void blk_dispatch(blk_queue* queue)
+{
+    uint32_t flags = spin_lock_irqsave(&queue->lock);
+    blk_request* req = blk_pick(queue);
+    if (!req) {
+        spin_unlock_irqrestore(&queue->lock, flags);
+        return;
+    }
+    blk_request** link = &queue->pending;
+    while (*link != req)
+        link = &(*link)->next;
+    *link = req->next;
+    queue->active = req;
+
+    if (req->op != BLK_OP_FLUSH) {
+        queue->stats.seekDistance += req->lba > queue->head ? req->lba - queue->head : queue->head - req->lba;
+        queue->head = req->lba + req->count;
+    }
+    queue->stats.dispatched++;
+    spin_unlock_irqrestore(&queue->lock, flags);
+
+    bool ok = blk_run(queue, req);
+
+    flags = spin_lock_irqsave(&queue->lock);
+    queue->active = 0;
+    for (blk_bio* bio = req->bios; bio && req->op == BLK_OP_WRITE; bio = bio->next)
+    {
+        queue->queuedWrites--;
+        // nobody waits for an async write, the next flush reports it failed
+        if (!ok && bio->async)
+            queue->writeError = true;
+    }
+    spin_unlock_irqrestore(&queue->lock, flags);
+
+    blk_bio* bio = req->bios;
+    while (bio) {
+        // a waiting caller may drop its bio as soon as it sees done
+        blk_bio* next = bio->next;
+        if (bio->async) {
+            free(bio);
+        } else {
+            bio->ok = ok;
+            asm volatile("" : : : "memory");
+            bio->done = true;
+        }
+        bio = next;
+    }
+    free(req);
+    wake_all(&queue->completed);
+}
+
+/// @brief checks if any queue has requests waiting
+bool blk_has_work()
+{
+    for (int i = 0; i < blk_queue_count; i++)
+    {
+        if (blk_queues[i].pending)
+            return true;
+    }
+    return false;
+}
+
+/// @brief the worker, the only task that talks to drives with a queue
+void blk_worker_main()
+{
+    while (true) {
+        uint32_t flags = irq_save();
+        wait_event(&blk_work, blk_has_work());
+        irq_restore(flags);
+
+        for (int i = 0; i < blk_queue_count; i++)
+            blk_dispatch(&blk_queues[i]);
+    }
+}
+
+/// @brief reads whole sectors, waiting for the queue to get to them
+/// @param dev the queue's device
+/// @param lba the first sector
+/// @param count
+/// @param buff gets count * 512 bytes
+/// @return false on a drive error
+bool blk_queue_read(block_device* dev, uint64_t lba, uint32_t count, uint8_t* buff)
+{
+    blk_queue* queue = (blk_queue*) dev->data;
+
+    // a write still in the queue has the newer data
+    uint32_t flags = irq_save();
+    wait_event(&queue->completed, !blk_write_overlaps(queue, lba, count));
+    irq_restore(flags);
+
+    // the worker runs on the kernel's directory, a buffer in the caller's
+    // private window is filled through the heap and copied here
+    uint8_t* target = buff;
+    if ((uint32_t) buff + count * 512 > USER_BASE) {
+        target = (uint8_t*) malloc(count * 512);
+        if (!target)
+            return false;
+    }
+
+    // the worker builds the dma table on its own directory, it translates in the caller's
+    blk_bio bio = { .next = 0, .lba = lba, .count = count, .buff = target, .directory = get_current_task()->page_directory,
+                    .async = false, .ok = false, .done = false };
+    if (!blk_submit(queue, &bio, BLK_OP_READ)) {
+        if (target != buff)
+            free(target);
+        return false;
+    }
+
+    flags = irq_save();
+    wait_event(&queue->completed, bio.done);
+    irq_restore(flags);
+
+    if (target != buff) {
+        if (bio.ok)
+            memcpy(buff, target, count * 512);
+        free(target);
+    }
+    return bio.ok;
+}
+
+/// @brief queues a write of whole sectors and returns, the data is copied
+/// to the heap here, so the caller can reuse its buffer and the worker never
+/// touches the caller's address space. a flush waits for it to reach the drive
+/// @param dev the queue's device
+/// @param lba the first sector
+/// @param count
+/// @param data count * 512 bytes
+/// @return false if there was no memory to queue it
+bool blk_queue_write(block_device* dev, uint64_t lba, uint32_t count, const uint8_t* data)
+{
+    blk_queue* queue = (blk_queue*) dev->data;
+
+    blk_bio* bio = (blk_bio*) malloc(sizeof(blk_bio) + count * 512);
+    if (!bio)
+        return false;
+    bio->lba = lba;
+    bio->count = count;
+    bio->buff = (uint8_t*) (bio + 1);
+    bio->directory = kernel_directory;
+    bio->async = true;
+    bio->ok = false;
+    bio->done = false;
+    memcpy(bio->buff, data, count * 512);
+
+    // writes to the same sectors reach the drive in the order they were made
+    uint32_t flags = irq_save();
+    wait_event(&queue->completed, queue->queuedWrites < BLK_MAX_WRITES && !blk_write_overlaps(queue, lba, count));
+    irq_restore(flags);
+
+    if (!blk_submit(queue, bio, BLK_OP_WRITE)) {
+        free(bio);
+        return false;
+    }
+    return true;
+}
+
+/// @brief waits for the queued writes and flushes the drive's write cache
+/// @param dev the queue's device
+/// @return false if the flush or a write since the last flush failed
+bool blk_queue_flush(block_device* dev)
+{
+    blk_queue* queue = (blk_queue*) dev->data;
+
+    uint32_t flags = irq_save();
+    wait_event(&queue->completed, queue->queuedWrites == 0);
+    irq_restore(flags);
+
+    blk_bio bio = { .next = 0, .lba = 0, .count = 0, .buff = 0, .directory = 0, .async = false, .ok = false, .done = false };
+    if (!blk_submit(queue, &bio, BLK_OP_FLUSH))
+        return false;
+
+    flags = irq_save();
+    wait_event(&queue->completed, bio.done);
+    irq_restore(flags);
+
+    flags = spin_lock_irqsave(&queue->lock);
+    bool writeError = queue->writeError;
+    queue->writeError = false;
+    spin_unlock_irqrestore(&queue->lock, flags);
+    return bio.ok && !writeError;
+}
+
+/// @brief the sector size of ata drives
+uint32_t blk_queue_sector_size(block_device* dev)
+{
+    (void) dev;
+    return 512;
+}
+
+/// @brief the size of the drive as IDENTIFY reported it
+uint64_t blk_queue_capacity(block_device* dev)
+{
+    return ((blk_queue*) dev->data)->drive.totalSectors;
+}
+
+const block_device_ops blk_queue_ops = {
+    .read = blk_queue_read,
+    .write = blk_queue_write,
+    .flush = blk_queue_flush,
+    .sector_size = blk_queue_sector_size,
+    .capacity = blk_queue_capacity,
+};
+
+/// @brief puts a request queue in front of a drive, its sectors should
+/// only be reached through the returned device from now on
+/// @param drive an identified drive, with its transfer mode chosen
+/// @return the drive as a block device, 0 if it is missing or no queue is left
+block_device* blk_queue_init(ata_drive drive)
+{
+    if (!drive.identified || blk_queue_count == BLK_MAX_QUEUES || blk_find_queue(&drive))
+        return 0;
+
+    if (!blk_worker) {
+        wait_queue_init(&blk_work);
+        blk_worker = spawn_kernel_task(blk_worker_main, TASK_PRIO_DEFAULT);
+        if (!blk_worker)
+            return 0;
+        set_task_name(blk_worker, "blkqueue");
+    }
+
+    blk_queue* queue = &blk_queues[blk_queue_count];
+    queue->dev.name = "ata";
+    queue->dev.ops = &blk_queue_ops;
+    queue->dev.data = queue;
+    queue->drive = drive;
+    spin_init(&queue->lock, "blkqueue");
+    queue->pending = 0;
+    queue->active = 0;
+    queue->queuedWrites = 0;
+    queue->writeError = false;
+    queue->head = 0;
+    queue->writesStarved = 0;
+    wait_queue_init(&queue->completed);
+    memset((unsigned char*) &queue->stats, 0, sizeof(blk_stats_t));
+    // published last, the worker may already be looking at the count
+    asm volatile("" : : : "memory");
+    blk_queue_count++;
+    return &queue->dev;
+}
+
+/// @brief returns the counters of a drive's queue
+/// @param dev
+blk_stats_t blk_get_stats(block_device* dev)
+{
+    blk_stats_t empty = {0};
+    return dev && dev->ops == &blk_queue_ops ? ((blk_queue*) dev->data)->stats : empty;
+}
@@ -0,0 +1,91 @@
+#include <drivers/blockdev.h>
+#include <common/tools.h>
+
+/// @brief reads whole sectors
+/// @param dev 
+/// @param lba the first sector
+/// @param count 
+/// @param buff gets count sectors
+/// @return false on a device error or a range past the end
+bool bdev_read(block_device* dev, uint64_t lba, uint32_t count, uint8_t* buff)
+{
+    if (!dev || lba + count > dev->ops->capacity(dev))
+        return false;
+    return dev->ops->read(dev, lba, count, buff);
+}
+
+/// @brief writes whole sectors, they may stay in a cache until bdev_flush
+/// @param dev 
+/// @param lba the first sector
+/// @param count 
+/// @param data count sectors
+/// @return false on a device error or a range past the end
+bool bdev_write(block_device* dev, uint64_t lba, uint32_t count, const uint8_t* data)
+{
+    if (!dev || lba + count > dev->ops->capacity(dev))
+        return false;
+    return dev->ops->write(dev, lba, count, data);
+}
+
+/// @brief waits for the written sectors to reach the media
+/// @param dev 
+bool bdev_flush(block_device* dev)
+{
+    return dev && dev->ops->flush(dev);
+}
+
+/// @brief returns the bytes in a sector of the device
+/// @param dev 
+uint32_t bdev_sector_size(block_device* dev)
+{
+    return dev ? dev->ops->sector_size(dev) : 0;
+}
+
+/// @brief returns the size of the device in sectors
+/// @param dev 
+uint64_t bdev_capacity(block_device* dev)
+{
+    return dev ? dev->ops->capacity(dev) : 0;
+}
+
+/// @brief reads from a specified sector
+/// @param dev 
+/// @param sectorNum
+/// @param buff buffer in which read data will be stored
+/// @param count the amount of bytes to read
+void bdev_read_sector(block_device* dev, uint32_t sectorNum, uint8_t* buff, int count)
+{
+    if (count <= 0)
+        return;
+
+    if (count >= BLOCK_SECTOR_SIZE) {
+        bdev_read(dev, sectorNum, 1, buff);
+        return;
+    }
+
+    // a partial sector goes through a bounce buffer, devices only move whole sectors
+    uint8_t bounce[BLOCK_SECTOR_SIZE];
+    if (bdev_read(dev, sectorNum, 1, bounce))
+        memcpy(buff, bounce, count);
+}
+
+/// @brief writes to a specifed sector
+/// @param dev 
+/// @param sectorNum 
+/// @param data the data to write
+/// @param count amount of bytes to write, the rest of the sector is zeroed
+void bdev_write_sector(block_device* dev, uint32_t sectorNum, uint8_t* data, uint32_t count)
+{
+    if (count > BLOCK_SECTOR_SIZE)
+        return;
+
+    if (count == BLOCK_SECTOR_SIZE) {
+        bdev_write(dev, sectorNum, 1, data);
+        return;
+    }
+
+    uint8_t bounce[BLOCK_SECTOR_SIZE];
+    memcpy(bounce, data, count);
+    memset(bounce + count, 0, BLOCK_SECTOR_SIZE - count);
+    bdev_write(dev, sectorNum, 1, bounce);
+}
@@ -1,6 +1,10 @@
 #include <drivers/keyboard.h>
 #include <io/screen.h>
 #include <hardwarecomms/portio.h>
+#include <hardwarecomms/softirq.h>
+#include <hardwarecomms/cpu.h>
+#include <multitasking.h>
+#include <spinlock.h>
 
 
 enum KB_ENC_IO {
@@ -107,21 +111,40 @@ void kb_enc_send_cmd(uint8_t cmd)
             break;
     outb(KB_ENC_CMD_REG, cmd);
 }
-bool _handle_irq = false;
-/// @brief fetches the first item from buffer
+// tasks sleeping in kb_fetch
+wait_queue_t kb_waiters;
+// guards kb_buffer, the bottom half and the reader can be on different cpus
+spinlock_t kb_lock = SPINLOCK_INIT("keyboard");
+
+/// @brief removes the first item from buffer, kb_lock held
 /// @return the item
-key_packet kb_fetch()
+key_packet kb_buffer_pop()
 {
-    //waits for buffer to fill up
-    while(buffer_end == 0);
-    _handle_irq = false;
     key_packet out = kb_buffer[0];
-    for (size_t i = 0; i < buffer_end; i++)
+    for (size_t i = 0; i + 1 < buffer_end; i++)
     {
         kb_buffer[i] = kb_buffer[i+1];
     }
     buffer_end--;
-    _handle_irq = true;
+    return out;
+}
+
+/// @brief fetches the first item from buffer
+/// @return the item
+key_packet kb_fetch()
+{
+    uint32_t flags = irq_save();
+    //waits for buffer to fill up
+    while (true) {
+        wait_event(&kb_waiters, buffer_end != 0);
+        spin_lock(&kb_lock);
+        if (buffer_end != 0)
+            break;
+        // another reader got it first
+        spin_unlock(&kb_lock);
+    }
+    key_packet out = kb_buffer_pop();
+    spin_unlock_irqrestore(&kb_lock, flags);
     return out;
 }
 
@@ -129,15 +152,14 @@ key_packet kb_fetch()
 /// @param c  the char
 void add_to_buffer(key_packet p)
 {
-    
-    if(buffer_end < KB_BUFFER_SIZE)
-    {
-        kb_buffer[buffer_end] = p;
-    } else {
-        kb_fetch();
-        kb_buffer[buffer_end] = p;
-    }
+    uint32_t flags = spin_lock_irqsave(&kb_lock);
+    // drops the oldest key when full
+    if(buffer_end == KB_BUFFER_SIZE)
+        kb_buffer_pop();
+    kb_buffer[buffer_end] = p;
     buffer_end++;
+    spin_unlock_irqrestore(&kb_lock, flags);
+    wake_one(&kb_waiters);
 }
 
 void key_pressed(uint32_t scan) 
@@ -199,23 +221,44 @@ void key_released(uint32_t scan)
     }
 }
 
+#define SCAN_RING_SIZE 32
+// raw scan codes read by the irq, translated by the bottom half
+uint8_t scan_ring[SCAN_RING_SIZE];
+size_t scan_head = 0, scan_tail = 0;
+tasklet_t kb_tasklet;
+
+/// @brief bottom half, translates the queued scan codes into key packets
+void keyboard_bottom_half(uint32_t data)
+{
+    (void) data;
+    while (scan_tail != scan_head) {
+        uint32_t scan = scan_ring[scan_tail];
+        scan_tail = (scan_tail + 1) % SCAN_RING_SIZE;
+        if (scan < 0x81) {
+            key_pressed(scan);
+        } else if(scan < 0xD8) {
+            key_released(scan - 0x80);
+        }
+    }
+}
+
+/// @brief top half, only takes the scan code off the controller
 void keyboard_input(void)
 {
-    uint32_t scan;
-    if (!_handle_irq)
-        return;
-    scan = kb_enc_read_buf();
-    if (scan < 0x81) {
-        key_pressed(scan);
-    } else if(scan < 0xD8) {
-        key_released(scan - 0x80);
+    uint8_t scan = kb_enc_read_buf();
+    size_t next = (scan_head + 1) % SCAN_RING_SIZE;
+    // drops the key if the bottom half fell that far behind
+    if (next != scan_tail) {
+        scan_ring[scan_head] = scan;
+        scan_head = next;
     }
+    tasklet_schedule(&kb_tasklet);
 }
 
 //tests keyboard
 bool kb_self_test() {
-    //disable_interrupts();
-    _handle_irq = false;
+    // the keyboard irq would take the answer off the controller
+    uint32_t flags = irq_save();
 	//! send command
 	kb_ctrl_send_cmd(0xAA);
 	//! wait for output buffer to be full
@@ -223,8 +266,7 @@ bool kb_self_test() {
 		if (kb_ctrl_read_status () & KB_CTRL_STATS_MASK_OUT_BUF)
 			break;
     bool is_ok = (kb_enc_read_buf() == 0x55) ? true : false;
-    _handle_irq = true;
-    //enable_interrupts();
+    irq_restore(flags);
 	//! if output buffer == 0x55, test passed
 	return is_ok;
 }
@@ -236,5 +278,6 @@ void kb_init(void)
 
 	//! shift, ctrl, and alt keys
 	_shift = _alt = _ctrl = false;
-    _handle_irq = true;
+    tasklet_init(&kb_tasklet, keyboard_bottom_half, 0);
+    wait_queue_init(&kb_waiters);
 }
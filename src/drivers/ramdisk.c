@@ -0,0 +1,92 @@
+#include <drivers/ramdisk.h>
+#include <memorymanagement.h>
+#include <common/tools.h>
+
+/// @brief copies sectors out of memory
+bool ramdisk_read(block_device* dev, uint64_t lba, uint32_t count, uint8_t* buff)
+{
+    ramdisk* disk = (ramdisk*) dev->data;
+    memcpy(buff, disk->data + lba * BLOCK_SECTOR_SIZE, count * BLOCK_SECTOR_SIZE);
+    return true;
+}
+
+/// @brief copies sectors into memory
+bool ramdisk_write(block_device* dev, uint64_t lba, uint32_t count, const uint8_t* data)
+{
+    ramdisk* disk = (ramdisk*) dev->data;
+    memcpy(disk->data + lba * BLOCK_SECTOR_SIZE, data, count * BLOCK_SECTOR_SIZE);
+    return true;
+}
+
+/// @brief there is no cache, writes are done when they return
+bool ramdisk_flush(block_device* dev)
+{
+    (void) dev;
+    return true;
+}
+
+uint32_t ramdisk_sector_size(block_device* dev)
+{
+    (void) dev;
+    return BLOCK_SECTOR_SIZE;
+}
+
+uint64_t ramdisk_capacity(block_device* dev)
+{
+    return ((ramdisk*) dev->data)->sectors;
+}
+
+const block_device_ops ramdisk_ops = {
+    .read = ramdisk_read,
+    .write = ramdisk_write,
+    .flush = ramdisk_flush,
+    .sector_size = ramdisk_sector_size,
+    .capacity = ramdisk_capacity,
+};
+
+/// @brief makes a disk in an image that is already in memory
+/// @param image sectors * 512 bytes, used in place and not freed by the ramdisk
+/// @param sectors 
+/// @return the disk, 0 if out of memory
+block_device* ramdisk_create_from(uint8_t* image, uint32_t sectors)
+{
+    ramdisk* disk = (ramdisk*) malloc(sizeof(ramdisk));
+    if (!disk)
+        return 0;
+    disk->dev.name = "ramdisk";
+    disk->dev.ops = &ramdisk_ops;
+    disk->dev.data = disk;
+    disk->data = image;
+    disk->sectors = sectors;
+    disk->owned = false;
+    return &disk->dev;
+}
+
+/// @brief makes an empty disk on the heap
+/// @param sectors 
+/// @return the disk, 0 if out of memory
+block_device* ramdisk_create(uint32_t sectors)
+{
+    uint8_t* image = (uint8_t*) malloc(sectors * BLOCK_SECTOR_SIZE);
+    if (!image)
+        return 0;
+    memset(image, 0, sectors * BLOCK_SECTOR_SIZE);
+
+    block_device* dev = ramdisk_create_from(image, sectors);
+    if (!dev) {
+        free(image);
+        return 0;
+    }
+    ((ramdisk*) dev->data)->owned = true;
+    return dev;
+}
+
+/// @brief frees a disk, and its data if the ramdisk allocated it
+/// @param dev 
+void ramdisk_destroy(block_device* dev)
+{
+    ramdisk* disk = (ramdisk*) dev->data;
+    if (disk->owned)
+        free(disk->data);
+    free(disk);
+}
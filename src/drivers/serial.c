@@ -0,0 +1,83 @@
+#include <drivers/serial.h>
+#include <hardwarecomms/portio.h>
+#include <common/str.h>
+#include <common/tools.h>
+#include <spinlock.h>
+
+enum SERIAL_REGS {
+    SERIAL_DATA = 0, // divisor low byte while DLAB is set
+    SERIAL_INT_ENABLE = 1, // divisor high byte while DLAB is set
+    SERIAL_FIFO_CTRL = 2,
+    SERIAL_LINE_CTRL = 3,
+    SERIAL_MODEM_CTRL = 4,
+    SERIAL_LINE_STATUS = 5,
+};
+
+#define LINE_STATUS_THR_EMPTY 0x20
+#define SERIAL_DIVISOR 1 // 115200 baud
+
+bool serial_ready = false;
+spinlock_t serial_lock = SPINLOCK_INIT("serial");
+
+/// @brief sets up COM1 for 115200 8N1 without interrupts
+/// @return false if there is no uart on the port
+bool serial_init(void)
+{
+    outb(COM1_PORT + SERIAL_INT_ENABLE, 0x00);
+    outb(COM1_PORT + SERIAL_LINE_CTRL, 0x80); // DLAB
+    outb(COM1_PORT + SERIAL_DATA, SERIAL_DIVISOR & 0xFF);
+    outb(COM1_PORT + SERIAL_INT_ENABLE, SERIAL_DIVISOR >> 8);
+    outb(COM1_PORT + SERIAL_LINE_CTRL, 0x03); // 8 bits, no parity, 1 stop bit
+    outb(COM1_PORT + SERIAL_FIFO_CTRL, 0xC7); // fifo on, cleared, 14 byte threshold
+
+    // loopback test, a missing uart reads back 0xFF
+    outb(COM1_PORT + SERIAL_MODEM_CTRL, 0x1E);
+    outb(COM1_PORT + SERIAL_DATA, 0xAE);
+    if (inb(COM1_PORT + SERIAL_DATA) != 0xAE)
+        return false;
+
+    outb(COM1_PORT + SERIAL_MODEM_CTRL, 0x0F);
+    serial_ready = true;
+    return true;
+}
+
+void serial_put_char(char c)
+{
+    while ((inb(COM1_PORT + SERIAL_LINE_STATUS) & LINE_STATUS_THR_EMPTY) == 0)
+        asm volatile("pause");
+    outb(COM1_PORT + SERIAL_DATA, c);
+}
+
+/// @brief writes to COM1, newlines become crlf
+/// @param data 
+/// @param size 
+void serial_write(const char* data, size_t size)
+{
+    if (!serial_ready)
+        return;
+    uint32_t flags = spin_lock_irqsave(&serial_lock);
+    for (size_t i = 0; i < size; i++)
+    {
+        if (data[i] == '\n')
+            serial_put_char('\r');
+        serial_put_char(data[i]);
+    }
+    spin_unlock_irqrestore(&serial_lock, flags);
+}
+
+void serial_write_string(const char* data)
+{
+    serial_write(data, strlen(data));
+}
+
+void serial_write_int(uint32_t value, int base)
+{
+    char buf[16];
+    int i = 15;
+    buf[i] = 0;
+    do {
+        buf[--i] = "0123456789abcdef"[value % base];
+        value /= base;
+    } while (value && i > 0);
+    serial_write_string(buf + i);
+}
@@ -0,0 +1,196 @@
+#include <drivers/virtio.h>
+#include <hardwarecomms/portio.h>
+#include <memorymanagement.h>
+#include <common/tools.h>
+#include <paging.h>
+
+/// @brief the size of a queue's memory, the used ring starts on a new page
+#define VIRTQ_ALIGN(x) (((x) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+
+/// @brief resets a legacy device and tells it a driver was found
+/// @param dev
+/// @param pci the device, its io bar is bar 0
+/// @return false if the bar isnt an io one
+bool virtio_start(virtio_device* dev, pci_entry_desc_t* pci)
+{
+    bar_t bar = get_base_address_register(pci->bus, pci->device, pci->function, 0);
+    if (bar.type != BAR_IO || !bar.addrs)
+        return false;
+    dev->pci = *pci;
+    dev->ioBase = (uint32_t) bar.addrs;
+    dev->features = 0;
+    pci_enable(pci, PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+
+    outb(dev->ioBase + VIRTIO_REG_DEVICE_STATUS, 0);
+    outb(dev->ioBase + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+    outb(dev->ioBase + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+    return true;
+}
+
+/// @brief accepts the features the device offers out of the wanted ones
+/// @param dev
+/// @param wanted
+/// @return the accepted features
+uint32_t virtio_negotiate(virtio_device* dev, uint32_t wanted)
+{
+    dev->features = inl(dev->ioBase + VIRTIO_REG_HOST_FEATURES) & wanted;
+    outl(dev->ioBase + VIRTIO_REG_GUEST_FEATURES, dev->features);
+    return dev->features;
+}
+
+/// @brief lets the device start using its queues
+/// @param dev
+void virtio_driver_ok(virtio_device* dev)
+{
+    outb(dev->ioBase + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+}
+
+/// @brief tells the device the driver gave up on it
+/// @param dev
+void virtio_fail(virtio_device* dev)
+{
+    outb(dev->ioBase + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+}
+
+/// @brief reads and clears the interrupt status, bit 0 is a used ring update
+/// @param dev
+uint8_t virtio_isr(virtio_device* dev)
+{
+    return inb(dev->ioBase + VIRTIO_REG_ISR_STATUS);
+}
+
+uint32_t virtio_config_read32(virtio_device* dev, uint32_t offset)
+{
+    return inl(dev->ioBase + VIRTIO_REG_DEVICE_CONFIG + offset);
+}
+
+uint64_t virtio_config_read64(virtio_device* dev, uint32_t offset)
+{
+    // the halves arent read atomically, fine for fields that dont change
+    return virtio_config_read32(dev, offset) | ((uint64_t) virtio_config_read32(dev, offset + 4) << 32);
+}
+
+/// @brief tells the device the queue has new entries, every call is a vm exit
+/// @param dev
+/// @param vq
+void virtio_notify(virtio_device* dev, virtqueue* vq)
+{
+    outw(dev->ioBase + VIRTIO_REG_QUEUE_NOTIFY, vq->index);
+}
+
+/// @brief sets up a queue in memory and hands it to the device
+/// @param dev
+/// @param vq
+/// @param index the queue of the device
+/// @return false if the device has no such queue or memory ran out
+bool virtq_init(virtio_device* dev, virtqueue* vq, uint16_t index)
+{
+    outw(dev->ioBase + VIRTIO_REG_QUEUE_SELECT, index);
+    uint16_t size = inw(dev->ioBase + VIRTIO_REG_QUEUE_SIZE);
+    if (!size)
+        return false;
+
+    uint32_t ringsSize = VIRTQ_ALIGN(sizeof(vring_desc) * size + sizeof(uint16_t) * (3 + size));
+    uint32_t usedSize = VIRTQ_ALIGN(sizeof(uint16_t) * 3 + sizeof(vring_used_elem) * size);
+    // the heap is mapped 1:1, so it is contiguous once aligned, and it is never freed
+    uint8_t* mem = calloc(1, ringsSize + usedSize + PAGE_SIZE);
+    if (!mem)
+        return false;
+    mem = (uint8_t*) VIRTQ_ALIGN((uint32_t) mem);
+
+    vq->index = index;
+    vq->size = size;
+    vq->desc = (vring_desc*) mem;
+    vq->avail = (vring_avail*) (mem + sizeof(vring_desc) * size);
+    vq->used = (vring_used*) (mem + ringsSize);
+    vq->availIdx = vq->publishedIdx = vq->lastUsed = 0;
+    vq->eventIdx = dev->features & VIRTIO_F_RING_EVENT_IDX;
+    vq->irqOff = false;
+
+    outl(dev->ioBase + VIRTIO_REG_QUEUE_ADDRESS, virt_to_phys(mem) / PAGE_SIZE);
+    return true;
+}
+
+/// @brief the used_event field after the avail ring
+#define VIRTQ_USED_EVENT(vq) (*(volatile uint16_t*) &(vq)->avail->ring[(vq)->size])
+/// @brief the avail_event field after the used ring
+#define VIRTQ_AVAIL_EVENT(vq) (*(volatile uint16_t*) &(vq)->used->ring[(vq)->size])
+
+/// @brief adds a chain to the avail ring, the device sees it after virtq_publish
+/// @param vq
+/// @param head the chain's first descriptor
+void virtq_push(virtqueue* vq, uint16_t head)
+{
+    vq->avail->ring[vq->availIdx % vq->size] = head;
+    vq->availIdx++;
+}
+
+/// @brief makes the pushed chains visible to the device, all of them with one notify
+/// @param vq
+/// @return true if the device asked to be notified, the caller then calls virtio_notify
+bool virtq_publish(virtqueue* vq)
+{
+    uint16_t old = vq->publishedIdx;
+    uint16_t new = vq->availIdx;
+    if (old == new)
+        return false;
+    // the ring entries before the index, then the index before the device's flags
+    __sync_synchronize();
+    vq->avail->idx = new;
+    vq->publishedIdx = new;
+    __sync_synchronize();
+
+    if (vq->eventIdx) {
+        // only if the device's wanted index lies among the ones just published
+        uint16_t event = VIRTQ_AVAIL_EVENT(vq);
+        return (uint16_t) (new - event - 1) < (uint16_t) (new - old);
+    }
+    return !(vq->used->flags & VRING_USED_F_NO_NOTIFY);
+}
+
+/// @brief takes a chain the device is done with
+/// @param vq
+/// @param head the chain's first descriptor
+/// @param length the bytes the device wrote
+/// @return false if the used ring had nothing new
+bool virtq_pop(virtqueue* vq, uint16_t* head, uint32_t* length)
+{
+    if (vq->lastUsed == vq->used->idx)
+        return false;
+    // the entry after the index that says it is there
+    __sync_synchronize();
+    volatile vring_used_elem* elem = &vq->used->ring[vq->lastUsed % vq->size];
+    *head = elem->id;
+    *length = elem->length;
+    vq->lastUsed++;
+    // while polling the event stays behind, so the device doesnt interrupt
+    if (vq->eventIdx && !vq->irqOff)
+        VIRTQ_USED_EVENT(vq) = vq->lastUsed;
+    return true;
+}
+
+/// @brief asks the device not to interrupt for used entries
+/// @param vq
+void virtq_disable_irq(virtqueue* vq)
+{
+    vq->irqOff = true;
+    vq->avail->flags = VRING_AVAIL_F_NO_INTERRUPT;
+    // with event idx the flag is ignored, an event the device already went
+    // past keeps it quiet until the index wraps
+    if (vq->eventIdx)
+        VIRTQ_USED_EVENT(vq) = vq->lastUsed - 1;
+}
+
+/// @brief asks for interrupts again
+/// @param vq
+/// @return false if entries came in while they were off, they need popping
+/// since no interrupt will come for them
+bool virtq_enable_irq(virtqueue* vq)
+{
+    vq->irqOff = false;
+    vq->avail->flags = 0;
+    if (vq->eventIdx)
+        VIRTQ_USED_EVENT(vq) = vq->lastUsed;
+    __sync_synchronize();
+    return vq->lastUsed == vq->used->idx;
+}
@@ -0,0 +1,477 @@
+#include <drivers/virtioblk.h>
+#include <hardwarecomms/isr.h>
+#include <hardwarecomms/softirq.h>
+#include <hardwarecomms/pit.h>
+#include <hardwarecomms/cpu.h>
+#include <io/screen.h>
+#include <memorymanagement.h>
+#include <paging.h>
+#include <timer.h>
+
+#define VIRTIO_BLK_DEVICE 0x1001 // legacy and transitional
+#define VIRTIO_BLK_TIMEOUT_MS 5000
+#define VIRTIO_BLK_CHAIN (VIRTIO_BLK_SEGMENTS + 2) // descriptors of a request with the header and status
+
+#define VIRTIO_BLK_F_SEG_MAX (1u << 2)
+#define VIRTIO_BLK_F_RO (1u << 5)
+#define VIRTIO_BLK_F_FLUSH (1u << 9)
+
+enum VIRTIO_BLK_CONFIG {
+    VIRTIO_BLK_CONFIG_CAPACITY = 0x00,
+    VIRTIO_BLK_CONFIG_SEG_MAX = 0x0C,
+};
+
+enum VIRTIO_BLK_TYPES {
+    VIRTIO_BLK_T_IN = 0,
+    VIRTIO_BLK_T_OUT = 1,
+    VIRTIO_BLK_T_FLUSH = 4,
+};
+
+#define VIRTIO_BLK_S_OK 0
+
+virtio_blk* virtio_blk_disks[VIRTIO_BLK_MAX_DISKS];
+int virtio_blk_disks_found = 0;
+uint16_t virtio_blk_irq_lines = 0; // lines the top half is registered on
+tasklet_t virtio_blk_tasklet;
+
+/// @brief takes the finished requests off the used ring, must be called with the lock held
+/// @param vb
+/// @return true if any finished
+bool virtio_blk_reap(virtio_blk* vb)
+{
+    uint16_t head;
+    uint32_t length;
+    bool any = false;
+    while (virtq_pop(&vb->queue, &head, &length))
+    {
+        uint32_t slot = vb->indirect ? head : head / VIRTIO_BLK_CHAIN;
+        if (slot < vb->slots) {
+            vb->requests[slot].done = true;
+            any = true;
+        }
+    }
+    return any;
+}
+
+/// @brief the top half, reading the isr status drops the line
+void virtio_blk_irq()
+{
+    bool any = false;
+    for (int i = 0; i < virtio_blk_disks_found; i++)
+    {
+        virtio_blk* vb = virtio_blk_disks[i];
+        if (virtio_isr(&vb->virtio) & 0x1) {
+            vb->irqPending = true;
+            vb->stats.interrupts++;
+            any = true;
+        }
+    }
+    if (any)
+        tasklet_schedule(&virtio_blk_tasklet);
+}
+
+/// @brief the bottom half, wakes the tasks whose requests finished
+/// @param data
+void virtio_blk_complete(uint32_t data)
+{
+    (void) data;
+    for (int i = 0; i < virtio_blk_disks_found; i++)
+    {
+        virtio_blk* vb = virtio_blk_disks[i];
+        if (!vb->irqPending)
+            continue;
+        vb->irqPending = false;
+
+        uint32_t flags = spin_lock_irqsave(&vb->lock);
+        bool finished = virtio_blk_reap(vb);
+        spin_unlock_irqrestore(&vb->lock, flags);
+        if (finished)
+            wake_all(&vb->waiters);
+    }
+}
+
+/// @brief takes a free request slot, must be called with interrupts disabled
+/// @param vb
+/// @return the slot, -1 if all are in use
+int virtio_blk_try_slot(virtio_blk* vb)
+{
+    int slot = -1;
+    spin_lock(&vb->lock);
+    for (uint32_t i = 0; i < vb->slots; i++)
+    {
+        if (!(vb->busySlots & (1u << i))) {
+            vb->busySlots |= 1u << i;
+            slot = i;
+            break;
+        }
+    }
+    spin_unlock(&vb->lock);
+    return slot;
+}
+
+/// @brief takes a request slot, sleeping while all are in use
+/// @param vb
+int virtio_blk_get_slot(virtio_blk* vb)
+{
+    int slot = -1;
+    uint32_t flags = irq_save();
+    // the condition can run twice, so it must not take twice
+    wait_event(&vb->waiters, slot >= 0 || (slot = virtio_blk_try_slot(vb)) >= 0);
+    irq_restore(flags);
+    return slot;
+}
+
+/// @brief gives a slot back
+/// @param vb
+/// @param slot
+void virtio_blk_put_slot(virtio_blk* vb, int slot)
+{
+    uint32_t flags = spin_lock_irqsave(&vb->lock);
+    vb->busySlots &= ~(1u << slot);
+    spin_unlock_irqrestore(&vb->lock, flags);
+    wake_all(&vb->waiters);
+}
+
+/// @brief fills a slot's descriptors: the header, the data split where it
+/// isnt physically contiguous, and the status
+/// @param vb
+/// @param slot
+/// @param type
+/// @param lba
+/// @param buff
+/// @param bytes 0 for a flush
+/// @return the chain's head in the ring, -1 if the buffer needs too many descriptors
+int virtio_blk_build(virtio_blk* vb, int slot, uint32_t type, uint64_t lba, uint8_t* buff, uint32_t bytes)
+{
+    virtio_blk_request* req = &vb->requests[slot];
+    // an indirect chain is a table of its own, numbered from 0
+    vring_desc* chain = vb->indirect ? req->table : &vb->queue.desc[slot * VIRTIO_BLK_CHAIN];
+    uint16_t first = vb->indirect ? 0 : slot * VIRTIO_BLK_CHAIN;
+
+    req->header.type = type;
+    req->header.reserved = 0;
+    req->header.sector = lba;
+    req->status = 0xFF;
+    req->done = false;
+
+    // the heap is mapped 1:1, so the header and status are contiguous wherever they fall
+    uint16_t n = 0;
+    chain[n].address = virt_to_phys(&req->header);
+    chain[n].length = sizeof(virtio_blk_header);
+    chain[n].flags = 0;
+    n++;
+
+    uint16_t dataFlags = type == VIRTIO_BLK_T_IN ? VRING_DESC_F_WRITE : 0;
+    uint32_t done = 0;
+    while (done < bytes)
+    {
+        uint32_t phys = virt_to_phys(buff + done);
+        if (!phys)
+            return -1;
+        uint32_t len = PAGE_SIZE - (phys & (PAGE_SIZE - 1));
+        if (len > bytes - done)
+            len = bytes - done;
+
+        if (n > 1 && chain[n - 1].address + chain[n - 1].length == phys) {
+            chain[n - 1].length += len;
+        } else {
+            if (n == VIRTIO_BLK_SEGMENTS + 1)
+                return -1;
+            chain[n].address = phys;
+            chain[n].length = len;
+            chain[n].flags = dataFlags;
+            n++;
+        }
+        done += len;
+    }
+
+    chain[n].address = virt_to_phys((uint8_t*) &req->status);
+    chain[n].length = 1;
+    chain[n].flags = VRING_DESC_F_WRITE;
+    n++;
+
+    for (uint16_t i = 0; i + 1 < n; i++)
+    {
+        chain[i].flags |= VRING_DESC_F_NEXT;
+        chain[i].next = first + i + 1;
+    }
+
+    if (!vb->indirect)
+        return first;
+    // the whole request takes a single descriptor of the ring
+    vring_desc* desc = &vb->queue.desc[slot];
+    desc->address = virt_to_phys(req->table);
+    desc->length = n * sizeof(vring_desc);
+    desc->flags = VRING_DESC_F_INDIRECT;
+    desc->next = 0;
+    return slot;
+}
+
+/// @brief publishes the queued requests, with one notify for all of them
+/// @param vb
+void virtio_blk_kick(virtio_blk* vb)
+{
+    uint32_t flags = spin_lock_irqsave(&vb->lock);
+    bool notify = virtq_publish(&vb->queue);
+    if (notify)
+        vb->stats.notifies++;
+    spin_unlock_irqrestore(&vb->lock, flags);
+    if (notify)
+        virtio_notify(&vb->virtio, &vb->queue);
+}
+
+/// @brief polls the used ring, under the lock only once there is something in it
+/// @param vb
+void virtio_blk_poll(virtio_blk* vb)
+{
+    if (vb->queue.lastUsed == vb->queue.used->idx)
+        return;
+    uint32_t flags = spin_lock_irqsave(&vb->lock);
+    bool finished = virtio_blk_reap(vb);
+    spin_unlock_irqrestore(&vb->lock, flags);
+    if (finished)
+        wake_all(&vb->waiters);
+}
+
+/// @brief waits for a slot's request and gives the slot back
+/// @param vb
+/// @param slot
+/// @return false if the request failed or timed out
+bool virtio_blk_finish(virtio_blk* vb, int slot)
+{
+    virtio_blk_request* req = &vb->requests[slot];
+
+    // a host usually answers within a few microseconds, polling then
+    // saves the interrupt, its exit and the wakeup
+    uint32_t flags = spin_lock_irqsave(&vb->lock);
+    if (vb->polling++ == 0)
+        virtq_disable_irq(&vb->queue);
+    spin_unlock_irqrestore(&vb->lock, flags);
+    for (int i = 0; i < VIRTIO_BLK_SPIN_POLLS && !req->done; i++)
+    {
+        virtio_blk_poll(vb);
+        asm volatile("pause");
+    }
+    flags = spin_lock_irqsave(&vb->lock);
+    bool finished = false;
+    // what came in while interrupts were off wont interrupt anymore
+    if (--vb->polling == 0 && !virtq_enable_irq(&vb->queue))
+        finished = virtio_blk_reap(vb);
+    spin_unlock_irqrestore(&vb->lock, flags);
+    if (finished)
+        wake_all(&vb->waiters);
+
+    if (!req->done) {
+        uint32_t ticks = ns_to_ticks(VIRTIO_BLK_TIMEOUT_MS * 1000000ULL);
+        if (vb->irqReady) {
+            flags = irq_save();
+            wait_event_timeout(&vb->waiters, req->done, ticks);
+            irq_restore(flags);
+        } else {
+            uint32_t deadline = get_ticks() + ticks;
+            while (!req->done && !time_after_eq(get_ticks(), deadline)) {
+                task_sleep(1000000);
+                virtio_blk_poll(vb);
+            }
+        }
+    }
+
+    if (!req->done) {
+        // the device may still write into the slot, so it is never reused
+        terminal_write_string("TIMEOUT");
+        return false;
+    }
+    bool ok = req->status == VIRTIO_BLK_S_OK;
+    virtio_blk_put_slot(vb, slot);
+    return ok;
+}
+
+/// @brief moves sectors, split into requests of maxSectors, all queued
+/// with one notify and in flight together as far as the slots allow
+/// @param vb
+/// @param type
+/// @param lba
+/// @param count 0 for a flush
+/// @param buff
+/// @return false if any part failed
+bool virtio_blk_transfer(virtio_blk* vb, uint32_t type, uint64_t lba, uint32_t count, uint8_t* buff)
+{
+    // the slots this call has in flight, oldest first
+    int inflight[VIRTIO_BLK_MAX_REQUESTS];
+    uint32_t head = 0, tail = 0;
+    bool ok = true;
+    uint32_t done = 0;
+    do {
+        uint32_t flags = irq_save();
+        int slot = virtio_blk_try_slot(vb);
+        irq_restore(flags);
+        if (slot < 0) {
+            // our own requests have to finish before we wait for someone else's
+            if (head != tail) {
+                virtio_blk_kick(vb);
+                ok = virtio_blk_finish(vb, inflight[head++ % VIRTIO_BLK_MAX_REQUESTS]) && ok;
+                continue;
+            }
+            slot = virtio_blk_get_slot(vb);
+        }
+
+        uint32_t sectors = count - done < vb->maxSectors ? count - done : vb->maxSectors;
+        int chain = virtio_blk_build(vb, slot, type, lba + done, buff + done * 512, sectors * 512);
+        if (chain < 0) {
+            terminal_write_string("ERROR");
+            virtio_blk_put_slot(vb, slot);
+            ok = false;
+            break;
+        }
+        flags = spin_lock_irqsave(&vb->lock);
+        virtq_push(&vb->queue, chain);
+        vb->stats.requests++;
+        spin_unlock_irqrestore(&vb->lock, flags);
+
+        inflight[tail++ % VIRTIO_BLK_MAX_REQUESTS] = slot;
+        done += sectors;
+    } while (done < count);
+
+    virtio_blk_kick(vb);
+    while (head != tail)
+        ok = virtio_blk_finish(vb, inflight[head++ % VIRTIO_BLK_MAX_REQUESTS]) && ok;
+    return ok;
+}
+
+bool virtio_blk_read(block_device* dev, uint64_t lba, uint32_t count, uint8_t* buff)
+{
+    return count == 0 || virtio_blk_transfer((virtio_blk*) dev->data, VIRTIO_BLK_T_IN, lba, count, buff);
+}
+
+bool virtio_blk_write(block_device* dev, uint64_t lba, uint32_t count, const uint8_t* data)
+{
+    virtio_blk* vb = (virtio_blk*) dev->data;
+    if (vb->readOnly)
+        return false;
+    return count == 0 || virtio_blk_transfer(vb, VIRTIO_BLK_T_OUT, lba, count, (uint8_t*) data);
+}
+
+/// @brief a device without the flush feature writes through, there is nothing to flush
+bool virtio_blk_flush(block_device* dev)
+{
+    virtio_blk* vb = (virtio_blk*) dev->data;
+    return !vb->flush || virtio_blk_transfer(vb, VIRTIO_BLK_T_FLUSH, 0, 0, 0);
+}
+
+uint32_t virtio_blk_sector_size(block_device* dev)
+{
+    (void) dev;
+    return 512;
+}
+
+uint64_t virtio_blk_capacity(block_device* dev)
+{
+    return ((virtio_blk*) dev->data)->sectors;
+}
+
+const block_device_ops virtio_blk_ops = {
+    .read = virtio_blk_read,
+    .write = virtio_blk_write,
+    .flush = virtio_blk_flush,
+    .sector_size = virtio_blk_sector_size,
+    .capacity = virtio_blk_capacity,
+};
+
+/// @brief negotiates with a device and sets up its request queue
+/// @param pci
+/// @return false if the device couldnt be used
+bool virtio_blk_probe(pci_entry_desc_t* pci)
+{
+    virtio_blk* vb = calloc(1, sizeof(virtio_blk));
+    if (!vb)
+        return false;
+    if (!virtio_start(&vb->virtio, pci)) {
+        free(vb);
+        return false;
+    }
+
+    uint32_t features = virtio_negotiate(&vb->virtio, VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_RO | VIRTIO_BLK_F_FLUSH |
+                                                      VIRTIO_F_RING_INDIRECT_DESC | VIRTIO_F_RING_EVENT_IDX);
+    vb->requests = calloc(VIRTIO_BLK_MAX_REQUESTS, sizeof(virtio_blk_request));
+    if (!vb->requests || !virtq_init(&vb->virtio, &vb->queue, 0)) {
+        virtio_fail(&vb->virtio);
+        free(vb->requests);
+        free(vb);
+        return false;
+    }
+    vb->indirect = features & VIRTIO_F_RING_INDIRECT_DESC;
+    vb->readOnly = features & VIRTIO_BLK_F_RO;
+    vb->flush = features & VIRTIO_BLK_F_FLUSH;
+
+    // without indirect tables every request holds a whole chain of the ring
+    vb->slots = vb->indirect ? vb->queue.size : vb->queue.size / VIRTIO_BLK_CHAIN;
+    if (vb->slots > VIRTIO_BLK_MAX_REQUESTS)
+        vb->slots = VIRTIO_BLK_MAX_REQUESTS;
+    if (!vb->slots) {
+        virtio_fail(&vb->virtio);
+        free(vb->requests);
+        free(vb);
+        return false;
+    }
+
+    // a buffer of n pages at any alignment takes n + 1 segments
+    uint32_t segments = VIRTIO_BLK_SEGMENTS;
+    uint32_t segMax = features & VIRTIO_BLK_F_SEG_MAX ? virtio_config_read32(&vb->virtio, VIRTIO_BLK_CONFIG_SEG_MAX) : 0;
+    if (segMax && segMax < segments)
+        segments = segMax;
+    vb->maxSectors = segments > 1 ? (segments - 1) * (PAGE_SIZE / 512) : 1;
+    if (vb->maxSectors > VIRTIO_BLK_MAX_SECTORS)
+        vb->maxSectors = VIRTIO_BLK_MAX_SECTORS;
+    vb->sectors = virtio_config_read64(&vb->virtio, VIRTIO_BLK_CONFIG_CAPACITY);
+
+    spin_init(&vb->lock, "virtio blk");
+    wait_queue_init(&vb->waiters);
+    vb->dev.name = "virtio-blk";
+    vb->dev.ops = &virtio_blk_ops;
+    vb->dev.data = vb;
+
+    // the top half only looks at disks in the list
+    virtio_blk_disks[virtio_blk_disks_found++] = vb;
+    uint8_t line = pci->interrupt & 0xFF;
+    if (line > 0 && line < 16) {
+        if (!(virtio_blk_irq_lines & (1 << line)) && register_shared_irq_callback(IRQ0 + line, virtio_blk_irq))
+            virtio_blk_irq_lines |= 1 << line;
+        vb->irqReady = virtio_blk_irq_lines & (1 << line);
+    }
+    virtio_driver_ok(&vb->virtio);
+    return true;
+}
+
+/// @brief sets up every virtio block device on the pci bus
+/// @return true if at least one was found
+bool virtio_blk_init(void)
+{
+    tasklet_init(&virtio_blk_tasklet, virtio_blk_complete, 0);
+    pci_entry_desc_t entry;
+    for (uint32_t i = 0; virtio_blk_disks_found < VIRTIO_BLK_MAX_DISKS && pci_find_device(VIRTIO_VENDOR, VIRTIO_BLK_DEVICE, i, &entry); i++)
+        virtio_blk_probe(&entry);
+    return virtio_blk_disks_found > 0;
+}
+
+/// @brief returns how many disks were found
+int virtio_blk_disk_count(void)
+{
+    return virtio_blk_disks_found;
+}
+
+/// @brief returns a disk found by virtio_blk_init
+/// @param index
+/// @return 0 past the last disk
+virtio_blk* virtio_blk_get_disk(int index)
+{
+    return index < virtio_blk_disks_found ? virtio_blk_disks[index] : 0;
+}
+
+/// @brief returns the counters of a virtio disk
+/// @param dev
+/// @return zeros if it isnt one
+virtio_blk_stats_t virtio_blk_get_stats(block_device* dev)
+{
+    virtio_blk_stats_t empty = {0};
+    return dev && dev->ops == &virtio_blk_ops ? ((virtio_blk*) dev->data)->stats : empty;
+}
@@ -0,0 +1,167 @@
+#include <elf.h>
+#include <paging.h>
+#include <memorymanagement.h>
+#include <common/str.h>
+#include <common/tools.h>
+#include <io/screen.h>
+
+#define ELF_KSTACK_SIZE 4096
+
+/// @brief copies a string into a fixed buffer
+/// @return false if it didnt fit
+static bool copy_name(char* dest, const char* src, int size)
+{
+    if (strlen(src) >= size)
+        return false;
+    strcpy(dest, src);
+    return true;
+}
+
+/// @brief reads the headers of an executable and records its loadable segments
+/// @param image has the file filled in
+/// @param entry gets the entry point
+/// @return false if it isnt an i386 executable that fits the user window
+bool elf_read_image(elf_image* image, uint32_t* entry)
+{
+    elf32_header header;
+    if (fat_read(image->hd, image->dirPath, image->fileName, 0, (uint8_t*) &header, sizeof(header), image->partDesc) != sizeof(header))
+        return false;
+    if (header.ident[0] != 0x7F || header.ident[1] != 'E' || header.ident[2] != 'L' || header.ident[3] != 'F')
+        return false;
+    if (header.ident[4] != ELF_CLASS_32 || header.ident[5] != ELF_DATA_LSB)
+        return false;
+    if (header.type != ELF_TYPE_EXEC || header.machine != ELF_MACHINE_386)
+        return false;
+    if (header.phentsize != sizeof(elf32_program_header))
+        return false;
+
+    image->segmentCount = 0;
+    for (int i = 0; i < header.phnum; i++)
+    {
+        elf32_program_header ph;
+        uint32_t offset = header.phoff + i * sizeof(ph);
+        if (fat_read(image->hd, image->dirPath, image->fileName, offset, (uint8_t*) &ph, sizeof(ph), image->partDesc) != sizeof(ph))
+            return false;
+        if (ph.type != ELF_PT_LOAD || ph.memsz == 0)
+            continue;
+
+        // segments must stay clear of the kernel mappings and the stack
+        if (ph.vaddr < USER_BASE || ph.memsz > USER_TOP - USER_STACK_SIZE - ph.vaddr || ph.filesz > ph.memsz)
+            return false;
+        if (image->segmentCount == ELF_MAX_SEGMENTS)
+            return false;
+
+        elf_segment* segment = &image->segments[image->segmentCount++];
+        segment->vaddr = ph.vaddr;
+        segment->memsz = ph.memsz;
+        segment->offset = ph.offset;
+        segment->filesz = ph.filesz;
+        segment->writable = ph.flags & ELF_PF_W;
+    }
+
+    *entry = header.entry;
+    return image->segmentCount > 0 && header.entry >= USER_BASE && header.entry < USER_TOP - USER_STACK_SIZE;
+}
+
+/// @brief loads an executable from the filesystem and runs it in ring 3,
+/// waiting for it to exit. nothing is read past the headers up front,
+/// the page fault handler brings pages in as the program touches them
+/// @param hd 
+/// @param dirPath 
+/// @param fileName 
+/// @param partDesc 
+/// @return false if the file isnt a valid executable or out of memory
+bool elf_exec(block_device* hd, const char* dirPath, const char* fileName, partition_descr* partDesc)
+{
+    // the task, its image and kernel stack in one block
+    uint8_t* memory = (uint8_t*) malloc(sizeof(task_t) + sizeof(elf_image) + ELF_KSTACK_SIZE);
+    if (!memory)
+        return false;
+    task_t* task = (task_t*) memory;
+    elf_image* image = (elf_image*) (memory + sizeof(task_t));
+    uint32_t kernel_stack = (uint32_t) (memory + sizeof(task_t) + sizeof(elf_image) + ELF_KSTACK_SIZE) & ~0xF;
+
+    image->hd = hd;
+    image->partDesc = partDesc;
+    uint32_t entry;
+    if (!copy_name(image->dirPath, dirPath, sizeof(image->dirPath)) ||
+        !copy_name(image->fileName, fileName, sizeof(image->fileName)) ||
+        !elf_read_image(image, &entry)) {
+        free(memory);
+        return false;
+    }
+
+    *task = create_task(entry, USER_TOP, kernel_stack, false);
+    if (task->page_directory == kernel_directory) {
+        // there is no user window to put the program in
+        free(memory);
+        return false;
+    }
+    task->image = image;
+    set_task_name(task, image->fileName);
+    if (!add_task(task)) {
+        address_space_destroy(task->page_directory);
+        free(memory);
+        return false;
+    }
+
+    task_join(task);
+    free(memory);
+    return true;
+}
+
+/// @brief brings in the page behind a not present fault in the user window
+/// @param task the task that faulted
+/// @param addr the faulting address
+/// @return false if the address isnt part of the program or its stack
+bool elf_handle_fault(task_t* task, uint32_t addr)
+{
+    elf_image* image = task->image;
+    if (!image || addr < USER_BASE || addr >= USER_TOP)
+        return false;
+
+    uint32_t page = addr & ~(PAGE_SIZE - 1);
+    if (page >= USER_TOP - USER_STACK_SIZE)
+        return map_user_page(task->page_directory, page, PAGE_USER | PAGE_WRITE);
+
+    // segments arent always page aligned, so a page can hold parts of two
+    uint32_t frame = 0;
+    uint32_t flags = PAGE_USER;
+    for (int i = 0; i < image->segmentCount; i++)
+    {
+        elf_segment* segment = &image->segments[i];
+        if (page + PAGE_SIZE <= segment->vaddr || page >= segment->vaddr + segment->memsz)
+            continue;
+
+        if (!frame) {
+            frame = frame_alloc();
+            if (!frame)
+                return false;
+            memset((unsigned char*) frame, 0, PAGE_SIZE);
+        }
+        if (segment->writable)
+            flags |= PAGE_WRITE;
+
+        // the rest of the segment past filesz stays zero, that is the bss
+        uint32_t start = page > segment->vaddr ? page : segment->vaddr;
+        uint32_t end = page + PAGE_SIZE;
+        if (end > segment->vaddr + segment->filesz)
+            end = segment->vaddr + segment->filesz;
+        if (start < end) {
+            int32_t read = fat_read(image->hd, image->dirPath, image->fileName, segment->offset + (start - segment->vaddr),
+                                    (uint8_t*) frame + (start - page), end - start, image->partDesc);
+            if (read != (int32_t) (end - start)) {
+                frame_free(frame);
+                return false;
+            }
+        }
+    }
+
+    if (!frame)
+        return false;
+    if (!paging_map(task->page_directory, page, frame, flags)) {
+        frame_free(frame);
+        return false;
+    }
+    return true;
+}
@@ -1,14 +1,20 @@
 #include <filesystem/fat.h>
+#include <drivers/blockdev.h>
 #include <memorymanagement.h>
 #include <common/str.h>
 #include <common/tools.h>
 #include <userinter/output.h>
 #define SECTOR_SIZE 512
-#define SECTOR_TO_BYTE SECTOR_SIZE / 4
+#define SECTOR_TO_BYTE (SECTOR_SIZE / 4) // fat entries in a sector
+#define MAX_RUN_SECTORS 256 // sectors read with a single device call
 #define SFN_ALLOWED "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789!#$%&'()-@^_`{}~"
 
-uint32_t find_dir_first_cluster(ata_drive hd, const char* path, partition_descr *partDesc);
-bool is_file_in_dir(ata_drive hd, uint32_t dirFirstCluster, const char* fileName, partition_descr *partDesc);
+uint32_t find_dir_first_cluster(block_device* hd, const char* path, partition_descr *partDesc);
+bool is_file_in_dir(block_device* hd, uint32_t dirFirstCluster, const char* fileName, partition_descr *partDesc);
+
+// serializes the public functions, the fat code and the drive under it arent reentrant.
+// taken again by the same task when output printed here is redirected to a file
+mutex_t fat_lock = MUTEX_INIT("fat");
 
 
 /// @brief convets utf16 to utf8 ascii (assuming only utf8 compatible chars are used)
@@ -55,12 +61,12 @@ void read_long_filename(LFN_entry_fat32 *lfn_entries, int count, char *output) {
 /// @param hd
 /// @param ent_idx 
 /// @return the value
-uint32_t read_fat_entry(ata_drive hd, uint32_t ent_idx, partition_descr *partDesc) {
+uint32_t read_fat_entry(block_device* hd, uint32_t ent_idx, partition_descr *partDesc) {
     uint8_t fatBuffer[512];
 
     // gets the next cluster belonging to the file
     uint32_t entrySector = ent_idx / SECTOR_TO_BYTE;
-    read28(hd, partDesc->fatDesc.fat_start + entrySector, fatBuffer, 512);
+    bdev_read_sector(hd, partDesc->fatDesc.fat_start + entrySector, fatBuffer, 512);
 
     uint32_t entryOffInSect = ent_idx % (SECTOR_TO_BYTE);
     return ((uint32_t*)fatBuffer)[entryOffInSect] & 0x0FFFFFFF;
@@ -71,32 +77,31 @@ uint32_t read_fat_entry(ata_drive hd, uint32_t ent_idx, partition_descr *partDes
 /// @param ent_idx the index of the entry
 /// @param partDesc 
 /// @param val the new value
-void write_fat_entry(ata_drive hd, uint32_t ent_idx, partition_descr *partDesc, uint32_t val) {
+void write_fat_entry(block_device* hd, uint32_t ent_idx, partition_descr *partDesc, uint32_t val) {
     uint8_t fatBuffer[512];
 
     // gets the next cluster belonging to the file
     uint32_t entrySector = ent_idx / SECTOR_TO_BYTE;
-    read28(hd, partDesc->fatDesc.fat_start + entrySector, fatBuffer, 512);
+    bdev_read_sector(hd, partDesc->fatDesc.fat_start + entrySector, fatBuffer, 512);
 
     uint32_t entryOffInSect = ent_idx % (SECTOR_TO_BYTE);
     ((uint32_t*)fatBuffer)[entryOffInSect] = val;
-    write28(hd, partDesc->fatDesc.fat_start + entrySector, fatBuffer, 512);
-    flush(hd);
+    bdev_write_sector(hd, partDesc->fatDesc.fat_start + entrySector, fatBuffer, 512);
 
-    read28(hd, partDesc->fatDesc.fat_start + partDesc->fatDesc.fat_size + entrySector, fatBuffer, 512);
+    bdev_read_sector(hd, partDesc->fatDesc.fat_start + partDesc->fatDesc.fat_size + entrySector, fatBuffer, 512);
     ((uint32_t*)fatBuffer)[entryOffInSect] = val;
-    write28(hd, partDesc->fatDesc.fat_start + partDesc->fatDesc.fat_size + entrySector, fatBuffer, 512);
-    flush(hd);
+    bdev_write_sector(hd, partDesc->fatDesc.fat_start + partDesc->fatDesc.fat_size + entrySector, fatBuffer, 512);
 }
 
 /// @brief parses partition bpb
 /// @param hd 
 /// @param partitionOffset 
 /// @return a partiton descriptor
-partition_descr read_BPB(ata_drive hd, uint32_t partitionOffset) {
+partition_descr read_BPB(block_device* hd, uint32_t partitionOffset) {
+    mutex_lock(&fat_lock);
     partition_descr partDesc;
-    read28(hd, partitionOffset, (uint8_t*)&partDesc.bpb, sizeof(bios_parameter_block32));
-    read28(hd, partitionOffset + partDesc.bpb.fatInfo, (uint8_t*)&partDesc.FSInfo, sizeof(FSInfo_block));
+    bdev_read_sector(hd, partitionOffset, (uint8_t*)&partDesc.bpb, sizeof(bios_parameter_block32));
+    bdev_read_sector(hd, partitionOffset + partDesc.bpb.fatInfo, (uint8_t*)&partDesc.FSInfo, sizeof(FSInfo_block));
 
     partDesc.fatDesc.fat_start = partitionOffset + partDesc.bpb.reservedSectors;
     partDesc.fatDesc.fat_size = partDesc.bpb.tableSize;
@@ -106,38 +111,68 @@ partition_descr read_BPB(ata_drive hd, uint32_t partitionOffset) {
     partDesc.currentWorkingDir = partDesc.bpb.rootCluster;
     partDesc.CWDString[0] = '/';
 
+    mutex_unlock(&fat_lock);
     return partDesc;
 }
 
 /// @brief updates the FSInfo section
 /// @param hd 
 /// @param partDesc 
-void update_FSInfo(ata_drive hd, partition_descr *partDesc) {
-    write28(hd, partDesc->fatDesc.fat_start - partDesc->bpb.reservedSectors + partDesc->bpb.fatInfo, (uint8_t*)&partDesc->FSInfo, sizeof(FSInfo_block));
-    flush(hd);
+void update_FSInfo(block_device* hd, partition_descr *partDesc) {
+    bdev_write_sector(hd, partDesc->fatDesc.fat_start - partDesc->bpb.reservedSectors + partDesc->bpb.fatInfo, (uint8_t*)&partDesc->FSInfo, sizeof(FSInfo_block));
 }
 
 /// @brief zeros the cluser's data
 /// @param hd 
 /// @param cluster the cluster index
 /// @param partDesc 
-void empty_out_cluster(ata_drive hd, uint32_t cluster, partition_descr *partDesc) {
+void empty_out_cluster(block_device* hd, uint32_t cluster, partition_descr *partDesc) {
     uint32_t clusterFirstSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (cluster - 2);
     // zeros all sectors belonging to the cluster
     for (int sectorOffset = 0; sectorOffset < partDesc->bpb.sectorPerCluster; sectorOffset++)
     {
         uint8_t zero[512] = {0};
-        write28(hd,clusterFirstSector + sectorOffset, zero, 512);
-        flush(hd);
+        bdev_write_sector(hd,clusterFirstSector + sectorOffset, zero, 512);
+    }
+}
+
+/// @brief writes part of a cluster, its whole sectors as one run
+/// @param hd 
+/// @param clusterSector the first sector of the cluster
+/// @param from the byte in the cluster to start at
+/// @param to the byte in the cluster to stop before
+/// @param data the data to write
+void write_cluster_part(block_device* hd, uint32_t clusterSector, uint32_t from, uint32_t to, const char* data) {
+    // a sector the write starts inside of keeps what is before from
+    if(from % SECTOR_SIZE) {
+        uint8_t sector[SECTOR_SIZE];
+        uint32_t keep = from % SECTOR_SIZE;
+        uint32_t amount = SECTOR_SIZE - keep < to - from ? SECTOR_SIZE - keep : to - from;
+        bdev_read_sector(hd, clusterSector + from / SECTOR_SIZE, sector, keep);
+        memcpy(sector + keep, data, amount);
+        bdev_write_sector(hd, clusterSector + from / SECTOR_SIZE, sector, keep + amount);
+        data += amount;
+        from += amount;
+    }
+
+    uint32_t sectors = (to - from) / SECTOR_SIZE;
+    if(sectors) {
+        bdev_write(hd, clusterSector + from / SECTOR_SIZE, sectors, (const uint8_t*)data);
+        data += sectors * SECTOR_SIZE;
+        from += sectors * SECTOR_SIZE;
     }
+
+    // the end of the file, the rest of its sector is zeroed
+    if(from < to)
+        bdev_write_sector(hd, clusterSector + from / SECTOR_SIZE, (uint8_t*)data, to - from);
 }
 
 /// @brief findes an empty cluster in fat table
 /// @param hd 
 /// @param partDesc 
 /// @return if found returns its index, otherwise returns 0xFFFFFFFF
-uint32_t find_empty_Cluster(ata_drive hd, partition_descr *partDesc) {
-    for (uint32_t i = 2; i < partDesc->fatDesc.fat_size / 4; i++)
+uint32_t find_empty_Cluster(block_device* hd, partition_descr *partDesc) {
+    for (uint32_t i = 2; i < partDesc->fatDesc.fat_size * SECTOR_TO_BYTE; i++)
     {
         if(read_fat_entry(hd, i, partDesc) == 0)
             return i;
@@ -150,7 +185,7 @@ uint32_t find_empty_Cluster(ata_drive hd, partition_descr *partDesc) {
 /// @param firstCluster the first cluster
 /// @param partDesc 
 /// @return the length of the cluster chain
-uint32_t clusterChainLen(ata_drive hd, uint32_t firstCluster, partition_descr *partDesc) {
+uint32_t clusterChainLen(block_device* hd, uint32_t firstCluster, partition_descr *partDesc) {
     uint32_t clusterCount = 0;
     uint32_t nextFileCluster = firstCluster;
     //follows cluster chain
@@ -166,18 +201,23 @@ uint32_t clusterChainLen(ata_drive hd, uint32_t firstCluster, partition_descr *p
 /// @param partDesc 
 /// @param clusterAmount the size needed
 /// @return pointer to an array of cluster indexs
-uint32_t* find_free_clusters(ata_drive hd, partition_descr *partDesc, uint32_t clusterAmount) {
+uint32_t* find_free_clusters(block_device* hd, partition_descr *partDesc, uint32_t clusterAmount) {
     if(clusterAmount > partDesc->FSInfo.freeClusterCount)
         return NULL;
     uint32_t* clustersIdxs = (uint32_t*) malloc(clusterAmount * sizeof(uint32_t));
     if(!clustersIdxs)
         return NULL;
     uint32_t currClusterIdx = 0;
-    for (uint32_t i = 2; (i < partDesc->fatDesc.fat_size / 4) && (currClusterIdx < clusterAmount); i++)
+    for (uint32_t i = 2; (i < partDesc->fatDesc.fat_size * SECTOR_TO_BYTE) && (currClusterIdx < clusterAmount); i++)
     {
         if(read_fat_entry(hd, i, partDesc) == 0)
             clustersIdxs[currClusterIdx++]  = i;
     }
+    // fsinfo's free count can be stale, a short list would chain garbage
+    if(currClusterIdx < clusterAmount) {
+        free(clustersIdxs);
+        return NULL;
+    }
     return clustersIdxs;
 }
 
@@ -187,7 +227,7 @@ uint32_t* find_free_clusters(ata_drive hd, partition_descr *partDesc, uint32_t c
 /// @param firstCluster the first cluster of the chain
 /// @param clusterAmount the amount of clusters in the chain
 /// @return an array containing the indexes of the clusters in the chain, NULL if no chain was found
-uint32_t* find_cluster_chain(ata_drive hd, partition_descr *partDesc, uint32_t firstCluster, uint32_t clusterAmount) {
+uint32_t* find_cluster_chain(block_device* hd, partition_descr *partDesc, uint32_t firstCluster, uint32_t clusterAmount) {
 
     if(firstCluster == 0)
         return NULL;
@@ -210,7 +250,7 @@ uint32_t* find_cluster_chain(ata_drive hd, partition_descr *partDesc, uint32_t f
 /// @param firstCluster the first cluster in the chain
 /// @param partDesc 
 /// @return the index of the last cluster in that chain
-uint32_t get_last_cluster_in_chain(ata_drive hd, uint32_t firstCluster, partition_descr *partDesc) {
+uint32_t get_last_cluster_in_chain(block_device* hd, uint32_t firstCluster, partition_descr *partDesc) {
     uint32_t currFileCluster = firstCluster;
     uint32_t nextFileCluster = read_fat_entry(hd, currFileCluster, partDesc);
     //follows cluster chain
@@ -229,7 +269,7 @@ uint32_t get_last_cluster_in_chain(ata_drive hd, uint32_t firstCluster, partitio
 /// @param startCluster the last cluster of the current chain
 /// @param clustersNeeded the amount clusters needed 
 /// @return the amount of clusters allocated, -1 if there is not enough space
-bool allocate_new_clusters(ata_drive hd, partition_descr *partDesc, uint32_t startCluster, int32_t clustersNeeded) {
+bool allocate_new_clusters(block_device* hd, partition_descr *partDesc, uint32_t startCluster, int32_t clustersNeeded) {
     if(clustersNeeded == 0)
         return 1;
     
@@ -271,7 +311,7 @@ bool allocate_new_clusters(ata_drive hd, partition_descr *partDesc, uint32_t sta
 /// @param startCluster the starting cluster of the chain
 /// @param chainSize the size of the chain
 /// @param clustersToRemove the amount of clusters to remove
-void remove_clusters_from_chain(ata_drive hd, partition_descr *partDesc, uint32_t startCluster, uint32_t chainSize, int32_t clustersToRemove) {
+void remove_clusters_from_chain(block_device* hd, partition_descr *partDesc, uint32_t startCluster, uint32_t chainSize, int32_t clustersToRemove) {
     uint32_t* clustersIdx = find_cluster_chain(hd, partDesc, startCluster, chainSize);
 
     // if no chain found
@@ -332,7 +372,7 @@ void generate_sfn(const char *lfn, char* name, char* ext, int id) {
 /// @param dirCluster the first cluster of the dir in which the file should be created
 /// @param fileName the name of the file
 /// @param partDesc 
-void create_file_by_dir_cluster(ata_drive hd, uint32_t dirCluster, char* fileName, partition_descr *partDesc) {
+void create_file_by_dir_cluster(block_device* hd, uint32_t dirCluster, char* fileName, partition_descr *partDesc) {
     directory_entry_fat32 dirent[16];
 
     uint32_t nextDirCluster = dirCluster;
@@ -376,7 +416,7 @@ void create_file_by_dir_cluster(ata_drive hd, uint32_t dirCluster, char* fileNam
         uint32_t dirSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (nextDirCluster - 2);
         do {
             //findes empty entry
-            read28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
+            bdev_read_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
             int emptyEntIdx = -1;
             int emptyEntrySeqLen = 0;
             for (int i = 0; (i < 16) && (emptyEntrySeqLen <= lfnCount); i++) {
@@ -417,9 +457,8 @@ void create_file_by_dir_cluster(ata_drive hd, uint32_t dirCluster, char* fileNam
             dirent[sfnEntIdx].firstClusterLo = (uint16_t)(firstCluster & 0xffff);
 
             // updates dir
-            write28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
-            flush(hd);
-        } while ((++dirSectorOffset <= partDesc->bpb.sectorPerCluster) && !found);
+            bdev_write_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
+        } while ((++dirSectorOffset < partDesc->bpb.sectorPerCluster) && !found);
         // gets next cluster belonging to the dir
         nextDirCluster = read_fat_entry(hd, nextDirCluster, partDesc);
     }
@@ -432,7 +471,7 @@ void create_file_by_dir_cluster(ata_drive hd, uint32_t dirCluster, char* fileNam
 /// @param dirCluster the first cluster of the dir
 /// @param fileName the name of the file
 /// @param partDesc 
-void delete_file_by_dir_cluster(ata_drive hd, uint32_t dirCluster, char* fileName, partition_descr *partDesc) {
+void delete_file_by_dir_cluster(block_device* hd, uint32_t dirCluster, char* fileName, partition_descr *partDesc) {
     directory_entry_fat32 dirent[16];
     LFN_entry_fat32 lfnEnt[20];
     int lfnIdx = 0;
@@ -444,7 +483,7 @@ void delete_file_by_dir_cluster(ata_drive hd, uint32_t dirCluster, char* fileNam
         int dirSectorOffset = 0;
         uint32_t dirSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (nextDirCluster - 2);
         do {
-            read28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
+            bdev_read_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
             int fileEntIdx = -1;
             for (int i = 0; i < 16; i++) {
                 if(dirent[i].name[0] == 0x00) { // end of dir entries
@@ -477,7 +516,7 @@ void delete_file_by_dir_cluster(ata_drive hd, uint32_t dirCluster, char* fileNam
             if(fileEntIdx == -1)
                 continue;
             // gets first cluster of file
-            uint32_t firstFileCluster = ((uint32_t)dirent[fileEntIdx].firstClusterHi) >> 16
+            uint32_t firstFileCluster = ((uint32_t)dirent[fileEntIdx].firstClusterHi) << 16
                                      | ((uint32_t)dirent[fileEntIdx].firstClusterLo);
 
             uint32_t chainSize = clusterChainLen(hd, firstFileCluster, partDesc);
@@ -486,11 +525,10 @@ void delete_file_by_dir_cluster(ata_drive hd, uint32_t dirCluster, char* fileNam
             //marks all lfn entries and the file entry as deleted
             for(int j = fileEntIdx - lfnIdx; j <= fileEntIdx; j++)
                 dirent[j].name[0] = 0xE5;
-            write28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
-            flush(hd);
+            bdev_write_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
 
             break;
-        } while ((++dirSectorOffset <= partDesc->bpb.sectorPerCluster) && moreEnt);
+        } while ((++dirSectorOffset < partDesc->bpb.sectorPerCluster) && moreEnt);
         // gets next cluster belonging to the dir
         nextDirCluster = read_fat_entry(hd, nextDirCluster, partDesc);
     }
@@ -501,12 +539,12 @@ void delete_file_by_dir_cluster(ata_drive hd, uint32_t dirCluster, char* fileNam
 /// @param dirFirstCluster the first cluster of the dir
 /// @param partentDirFirstCluster the first cluster of the parent dir
 /// @param partDesc 
-void init_dir(ata_drive hd, uint32_t dirFirstCluster, uint32_t partentDirFirstCluster,partition_descr *partDesc) {
+void init_dir(block_device* hd, uint32_t dirFirstCluster, uint32_t partentDirFirstCluster,partition_descr *partDesc) {
     directory_entry_fat32 dirent[2];
     empty_out_cluster(hd, dirFirstCluster, partDesc);
 
     uint32_t dirSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (dirFirstCluster - 2);
-    read28(hd, dirSector, (uint8_t*)&dirent[0], 2*sizeof(directory_entry_fat32));
+    bdev_read_sector(hd, dirSector, (uint8_t*)&dirent[0], 2*sizeof(directory_entry_fat32));
 
     //sets up . and .. entries
     char* ext = "   ";
@@ -533,7 +571,7 @@ void init_dir(ata_drive hd, uint32_t dirFirstCluster, uint32_t partentDirFirstCl
     dirent[1].firstClusterLo = (uint16_t)(partentDirFirstCluster & 0xffff);
 
 
-    write28(hd, dirSector, (uint8_t*)&dirent[0], 2*sizeof(directory_entry_fat32));
+    bdev_write_sector(hd, dirSector, (uint8_t*)&dirent[0], 2*sizeof(directory_entry_fat32));
 }
 
 /// @brief creates a new dir 
@@ -541,7 +579,7 @@ void init_dir(ata_drive hd, uint32_t dirFirstCluster, uint32_t partentDirFirstCl
 /// @param parentCluster the first cluster of the parent dir 
 /// @param dirName the name of the current dir
 /// @param partDesc 
-void create_dir_by_parent_cluster(ata_drive hd, uint32_t parentCluster, char* dirName, partition_descr *partDesc) {
+void create_dir_by_parent_cluster(block_device* hd, uint32_t parentCluster, char* dirName, partition_descr *partDesc) {
     directory_entry_fat32 dirent[16];
     uint32_t nextDirCluster = parentCluster;
 
@@ -583,7 +621,7 @@ void create_dir_by_parent_cluster(ata_drive hd, uint32_t parentCluster, char* di
         uint32_t dirSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (nextDirCluster - 2);
         do {
             //findes empty entry
-            read28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
+            bdev_read_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
             int emptyEntIdx = -1;
             int emptyEntrySeqLen = 0;
             for (int i = 0; (i < 16) && (emptyEntrySeqLen <= lfnCount); i++) {
@@ -628,11 +666,10 @@ void create_dir_by_parent_cluster(ata_drive hd, uint32_t parentCluster, char* di
 
             // updates dir and fat
             write_fat_entry(hd, firstCluster, partDesc, 0x0FFFFFF8);
-            write28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
-            flush(hd);
+            bdev_write_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
 
             init_dir(hd, firstCluster, parentCluster, partDesc);
-        } while ((++dirSectorOffset <= partDesc->bpb.sectorPerCluster) && !found);
+        } while ((++dirSectorOffset < partDesc->bpb.sectorPerCluster) && !found);
         // gets next cluster belonging to the dir
         nextDirCluster = read_fat_entry(hd, nextDirCluster, partDesc);
     }
@@ -647,7 +684,7 @@ void create_dir_by_parent_cluster(ata_drive hd, uint32_t parentCluster, char* di
 /// @param hd 
 /// @param dirCluster the first cluster of the dir
 /// @param partDesc 
-void clear_dir_by_cluster (ata_drive hd, uint32_t dirCluster, partition_descr *partDesc) {
+void clear_dir_by_cluster (block_device* hd, uint32_t dirCluster, partition_descr *partDesc) {
     directory_entry_fat32 dirent[16];
     uint32_t nextDirCluster = dirCluster;
     bool moreEnt = 1;
@@ -656,7 +693,7 @@ void clear_dir_by_cluster (ata_drive hd, uint32_t dirCluster, partition_descr *p
         int dirSectorOffset = 0;
         uint32_t dirSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (nextDirCluster - 2);
         do {
-            read28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
+            bdev_read_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
             for (int i = 0; i < 16; i++) {
                 if(dirent[i].name[0] == 0x00) { // end of dir entries
                     moreEnt = 0;
@@ -681,7 +718,7 @@ void clear_dir_by_cluster (ata_drive hd, uint32_t dirCluster, partition_descr *p
                 uint32_t chainSize = clusterChainLen(hd, firstEntCluster, partDesc);
                 remove_clusters_from_chain(hd, partDesc, firstEntCluster, chainSize, -chainSize);
             }
-        } while ((++dirSectorOffset <= partDesc->bpb.sectorPerCluster) && moreEnt);
+        } while ((++dirSectorOffset < partDesc->bpb.sectorPerCluster) && moreEnt);
         // gets next cluster belonging to the dir
         nextDirCluster = read_fat_entry(hd, nextDirCluster, partDesc);
     }
@@ -692,7 +729,7 @@ void clear_dir_by_cluster (ata_drive hd, uint32_t dirCluster, partition_descr *p
 /// @param parentCluster the first cluster of the dir
 /// @param dirName the name of the dir to be delted
 /// @param partDesc 
-void delete_dir_by_parent_cluster(ata_drive hd, uint32_t parentCluster, char* dirName, partition_descr *partDesc) {
+void delete_dir_by_parent_cluster(block_device* hd, uint32_t parentCluster, char* dirName, partition_descr *partDesc) {
     directory_entry_fat32 dirent[16];
     LFN_entry_fat32 lfnEnt[20];
     int lfnIdx = 0;
@@ -705,7 +742,7 @@ void delete_dir_by_parent_cluster(ata_drive hd, uint32_t parentCluster, char* di
         int dirSectorOffset = 0;
         uint32_t dirSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (nextParentDirCluster - 2);
         do {
-            read28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
+            bdev_read_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
             int fileEntIdx = -1;
             for (int i = 0; i < 16; i++) {
                 if(dirent[i].name[0] == 0x00) { // end of dir entries
@@ -741,15 +778,14 @@ void delete_dir_by_parent_cluster(ata_drive hd, uint32_t parentCluster, char* di
             found = true;
 
             // gets first cluster of file
-            firstDirCluster = ((uint32_t)dirent[fileEntIdx].firstClusterHi) >> 16
+            firstDirCluster = ((uint32_t)dirent[fileEntIdx].firstClusterHi) << 16
                             | ((uint32_t)dirent[fileEntIdx].firstClusterLo);
             //marks all lfn entries and the file entry as deleted
             for(int j = fileEntIdx - lfnIdx; j <= fileEntIdx; j++)
                 dirent[j].name[0] = 0xE5;
-            write28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
-            flush(hd);
+            bdev_write_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
             break;
-        } while ((++dirSectorOffset <= partDesc->bpb.sectorPerCluster) && moreEnt && !found);
+        } while ((++dirSectorOffset < partDesc->bpb.sectorPerCluster) && moreEnt && !found);
         // gets next cluster belonging to the dir
         nextParentDirCluster = read_fat_entry(hd, nextParentDirCluster, partDesc);
     }
@@ -768,7 +804,7 @@ void delete_dir_by_parent_cluster(ata_drive hd, uint32_t parentCluster, char* di
 /// @param partDesc 
 /// @param data the data to write
 /// @param size size of the data to write
-void rewrite_file_by_dir_cluster(ata_drive hd, uint32_t dirFirstClust, const char *fileName, partition_descr *partDesc, const char *data, uint32_t size) {
+void rewrite_file_by_dir_cluster(block_device* hd, uint32_t dirFirstClust, const char *fileName, partition_descr *partDesc, const char *data, uint32_t size) {
     directory_entry_fat32 dirent[16];
     LFN_entry_fat32 lfnEnt[20];
     int lfnIdx = 0;
@@ -780,7 +816,7 @@ void rewrite_file_by_dir_cluster(ata_drive hd, uint32_t dirFirstClust, const cha
         int dirSectorOffset = 0;
         uint32_t dirSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (nextDirCluster - 2);
         do {
-            read28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
+            bdev_read_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
             int fileEntIdx = -1;
             for (int i = 0; i < 16; i++) {
                 if(dirent[i].name[0] == 0x00) { // end of dir entries
@@ -812,7 +848,7 @@ void rewrite_file_by_dir_cluster(ata_drive hd, uint32_t dirFirstClust, const cha
             if(fileEntIdx == -1)
                 continue;
             // gets first cluster of file
-            uint32_t firstFileCluster = ((uint32_t)dirent[fileEntIdx].firstClusterHi) >> 16
+            uint32_t firstFileCluster = ((uint32_t)dirent[fileEntIdx].firstClusterHi) << 16
                                      | ((uint32_t)dirent[fileEntIdx].firstClusterLo);
 
             uint32_t currentClusterAmount = dirent[fileEntIdx].size / (SECTOR_SIZE * partDesc->bpb.sectorPerCluster);
@@ -845,38 +881,23 @@ void rewrite_file_by_dir_cluster(ata_drive hd, uint32_t dirFirstClust, const cha
 
             // updates the entry size
             dirent[fileEntIdx].size = size;
-            write28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
-            flush(hd);
+            bdev_write_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
 
             // writes data to cluster chain
-            int32_t SIZE = size;
+            uint32_t clusterBytes = SECTOR_SIZE * partDesc->bpb.sectorPerCluster;
+            uint32_t written = 0;
             uint32_t nextFileCluster = firstFileCluster;
-            while (nextFileCluster < 0x0FFFFFF8 )
+            while ((nextFileCluster < 0x0FFFFFF8) && (written < size))
             {
-                
                 uint32_t fileSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (nextFileCluster - 2);
-                int sectorOffset = 0;
-                
-
-                // reads all sectors belonging to file from curr file cluster
-                for (; SIZE > 0; SIZE -= 512)
-                {
-                    int amountToWrite =  (SIZE > 512 ? 512 : SIZE);
-                    write28(hd, fileSector + sectorOffset, (uint8_t*)data, amountToWrite);
-                    flush(hd);
-                    data += amountToWrite;
-
-                    if(++sectorOffset > partDesc->bpb.sectorPerCluster) {
-                        SIZE -= 512;
-                        break;
-                    }
-                }
+                uint32_t amountToWrite = size - written > clusterBytes ? clusterBytes : size - written;
+                write_cluster_part(hd, fileSector, 0, amountToWrite, data + written);
+                written += amountToWrite;
                 nextFileCluster = read_fat_entry(hd, nextFileCluster, partDesc);
-                
             }
 
             break;
-        } while ((++dirSectorOffset <= partDesc->bpb.sectorPerCluster) && moreEnt);
+        } while ((++dirSectorOffset < partDesc->bpb.sectorPerCluster) && moreEnt);
         // gets next cluster belonging to the dir
         nextDirCluster = read_fat_entry(hd, nextDirCluster, partDesc);
     }
@@ -889,7 +910,7 @@ void rewrite_file_by_dir_cluster(ata_drive hd, uint32_t dirFirstClust, const cha
 /// @param partDesc 
 /// @param data the data to write
 /// @param size size of the data to write
-void append_to_file_by_dir_cluster(ata_drive hd, uint32_t dirFirstClust, const char *fileName, partition_descr *partDesc, const char *data, uint32_t size) {
+void append_to_file_by_dir_cluster(block_device* hd, uint32_t dirFirstClust, const char *fileName, partition_descr *partDesc, const char *data, uint32_t size) {
     directory_entry_fat32 dirent[16];
     LFN_entry_fat32 lfnEnt[20];
     int lfnIdx = 0;
@@ -901,7 +922,7 @@ void append_to_file_by_dir_cluster(ata_drive hd, uint32_t dirFirstClust, const c
         int dirSectorOffset = 0;
         uint32_t dirSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (nextDirCluster - 2);
         do {
-            read28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
+            bdev_read_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
             int fileEntIdx = -1;
             for (int i = 0; i < 16; i++) {
                 if(dirent[i].name[0] == 0x00) { // end of dir entries
@@ -933,7 +954,7 @@ void append_to_file_by_dir_cluster(ata_drive hd, uint32_t dirFirstClust, const c
             if(fileEntIdx == -1)
                 continue;
             // gets first cluster of file
-            uint32_t firstFileCluster = ((uint32_t)dirent[fileEntIdx].firstClusterHi) >> 16
+            uint32_t firstFileCluster = ((uint32_t)dirent[fileEntIdx].firstClusterHi) << 16
                                      | ((uint32_t)dirent[fileEntIdx].firstClusterLo);
 
             uint32_t currentClusterAmount = dirent[fileEntIdx].size / (SECTOR_SIZE * partDesc->bpb.sectorPerCluster);
@@ -965,52 +986,29 @@ void append_to_file_by_dir_cluster(ata_drive hd, uint32_t dirFirstClust, const c
 
 
             // updates the entry size
-            dirent[fileEntIdx].size = dirent[fileEntIdx].size + size;
-            write28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
-            flush(hd);
-
-            // writes data to cluster chain
-            int32_t SIZE = dirent[fileEntIdx].size;
+            uint32_t oldSize = dirent[fileEntIdx].size;
+            dirent[fileEntIdx].size = oldSize + size;
+            bdev_write_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
+
+            // writes data to the clusters past the old end of the file
+            uint32_t clusterBytes = SECTOR_SIZE * partDesc->bpb.sectorPerCluster;
+            uint32_t end = oldSize + size;
+            uint32_t clusterStart = 0;
             uint32_t nextFileCluster = firstFileCluster;
-            while (nextFileCluster < 0x0FFFFFF8 )
+            while ((nextFileCluster < 0x0FFFFFF8) && (clusterStart < end))
             {
-                
-                uint32_t fileSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (nextFileCluster - 2);
-                int sectorOffset = 0;
-                
-
-                // reads all sectors belonging to file from curr file cluster
-                for (; SIZE > 0; SIZE -= 512)
-                {
-                    if((SIZE - 512) < (int32_t) size) {
-                        int amountToWrite =  (SIZE > 512 ? 512 : SIZE);
-                        int dataToKeep = SIZE - size;
-                        if (dataToKeep > 0) {
-                            amountToWrite -= dataToKeep;
-                            uint8_t sectorToWrite[512];
-                            read28(hd, fileSector + sectorOffset, sectorToWrite, dataToKeep);
-                            for(int i = 0; i < amountToWrite; i++) {
-                                sectorToWrite[i + dataToKeep] = data[i];
-                            }
-                            write28(hd, fileSector + sectorOffset, sectorToWrite, amountToWrite + dataToKeep);
-                            flush(hd);
-                        } else {
-                            write28(hd, fileSector + sectorOffset, (uint8_t*)data, amountToWrite);
-                            flush(hd);
-                        }
-                        data += amountToWrite;
-                    }
-                    if(++sectorOffset > partDesc->bpb.sectorPerCluster) {
-                        SIZE -= 512;
-                        break;
-                    }
+                if(clusterStart + clusterBytes > oldSize) {
+                    uint32_t fileSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (nextFileCluster - 2);
+                    uint32_t from = oldSize > clusterStart ? oldSize - clusterStart : 0;
+                    uint32_t to = end - clusterStart > clusterBytes ? clusterBytes : end - clusterStart;
+                    write_cluster_part(hd, fileSector, from, to, data + (clusterStart + from - oldSize));
                 }
+                clusterStart += clusterBytes;
                 nextFileCluster = read_fat_entry(hd, nextFileCluster, partDesc);
-                
             }
 
             break;
-        } while ((++dirSectorOffset <= partDesc->bpb.sectorPerCluster) && moreEnt);
+        } while ((++dirSectorOffset < partDesc->bpb.sectorPerCluster) && moreEnt);
         // gets next cluster belonging to the dir
         nextDirCluster = read_fat_entry(hd, nextDirCluster, partDesc);
     }
@@ -1019,7 +1017,7 @@ void append_to_file_by_dir_cluster(ata_drive hd, uint32_t dirFirstClust, const c
 /// @brief reads a dir and prints its contents
 /// @param hd
 /// @param firstCluster first cluster of the dir
-void read_dir_by_cluster(ata_drive hd, uint32_t firstCluster, partition_descr *partDesc) {
+void read_dir_by_cluster(block_device* hd, uint32_t firstCluster, partition_descr *partDesc) {
     directory_entry_fat32 dirent[16];
     LFN_entry_fat32 lfnEnt[20];
     int lfnIdx = 0;
@@ -1030,7 +1028,7 @@ void read_dir_by_cluster(ata_drive hd, uint32_t firstCluster, partition_descr *p
         int dirSectorOffset = 0;
         uint32_t dirSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (nextDirCluster - 2);
         do {
-            read28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
+            bdev_read_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
             for (int i = 0; i < 16; i++) {
                 if(dirent[i].name[0] == 0x00) { // end of dir entries
                     moreEnt = 0;
@@ -1044,37 +1042,35 @@ void read_dir_by_cluster(ata_drive hd, uint32_t firstCluster, partition_descr *p
                     continue;
                 }
 
+                // each row goes out as one writev
+                iovec_t row[6];
+                int segs = 0;
+                char nameBuff[256] = {0};
+                char sizeBuff[12];
                 if (lfnIdx > 0) {
-                    char nameBuff[256] = {0};
                     read_long_filename(lfnEnt, lfnIdx, nameBuff);
-                    print_string(nameBuff);
-                    if((dirent[i].attributes & 0x10) == 0x10) {
-                        print_string("/    ");
-                        print_string("<DIR>");
-                    } else {
-                        print_string("    ");
-                        print_int(dirent[i].size, 10);
-                        print_string(" bytes");
-                    }
+                    row[segs++] = (iovec_t) { nameBuff, strlen(nameBuff) };
                     lfnIdx = 0;
                 } else {
                     if(dirent[i].name[0] == '.')
                         continue;
-                    print((char*) dirent[i].name, 8);
+                    row[segs++] = (iovec_t) { (char*) dirent[i].name, 8 };
                     if((dirent[i].attributes & 0x10) != 0x10) {
-                        print_string(".");
-                        print((char*) dirent[i].ext, 3);
-                        print_string("    ");
-                        print_int(dirent[i].size, 10);
-                        print_string(" bytes");
-                    } else {
-                        print_string("/    ");
-                        print_string("<DIR>");
+                        row[segs++] = (iovec_t) { ".", 1 };
+                        row[segs++] = (iovec_t) { (char*) dirent[i].ext, 3 };
                     }
                 }
-                print_string("\n");
+                if((dirent[i].attributes & 0x10) == 0x10) {
+                    row[segs++] = (iovec_t) { "/    <DIR>\n", 11 };
+                } else {
+                    itoa(dirent[i].size, sizeBuff, 10);
+                    row[segs++] = (iovec_t) { "    ", 4 };
+                    row[segs++] = (iovec_t) { sizeBuff, strlen(sizeBuff) };
+                    row[segs++] = (iovec_t) { " bytes\n", 7 };
+                }
+                print_v(row, segs);
             }
-        } while ((++dirSectorOffset <= partDesc->bpb.sectorPerCluster) && moreEnt);
+        } while ((++dirSectorOffset < partDesc->bpb.sectorPerCluster) && moreEnt);
         // gets next cluster belonging to the dir
         nextDirCluster = read_fat_entry(hd, nextDirCluster, partDesc);
     }
@@ -1087,7 +1083,7 @@ void read_dir_by_cluster(ata_drive hd, uint32_t firstCluster, partition_descr *p
 /// @param fileName
 /// @param partDesc 
 /// @return true if found, false otherwise
-bool is_file_in_dir(ata_drive hd, uint32_t dirFirstCluster, const char* fileName, partition_descr *partDesc) {
+bool is_file_in_dir(block_device* hd, uint32_t dirFirstCluster, const char* fileName, partition_descr *partDesc) {
     uint32_t nextDirCluster = dirFirstCluster;
 
     directory_entry_fat32 dirent[16];
@@ -1098,7 +1094,7 @@ bool is_file_in_dir(ata_drive hd, uint32_t dirFirstCluster, const char* fileName
             int dirSectorOffset = 0;
             uint32_t dirSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (nextDirCluster - 2);
             do {
-                read28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
+                bdev_read_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
                 for (int i = 0; i < 16; i++) {
                     if(dirent[i].name[0] == 0x00) { // end of dir entries
                         moreEnt = false;
@@ -1125,7 +1121,7 @@ bool is_file_in_dir(ata_drive hd, uint32_t dirFirstCluster, const char* fileName
 
                     return true;
                 }
-            } while ((++dirSectorOffset <= partDesc->bpb.sectorPerCluster) && moreEnt);
+            } while ((++dirSectorOffset < partDesc->bpb.sectorPerCluster) && moreEnt);
             // gets next cluster belonging to the dir
             nextDirCluster = read_fat_entry(hd, nextDirCluster, partDesc);
     }
@@ -1138,7 +1134,7 @@ bool is_file_in_dir(ata_drive hd, uint32_t dirFirstCluster, const char* fileName
 /// @param fileName 
 /// @param partDesc 
 /// @return the entry if found, garbage otherwise
-directory_entry_fat32 find_file_dir_entry(ata_drive hd, uint32_t dirFirstCluster, const char* fileName, partition_descr *partDesc) {
+directory_entry_fat32 find_file_dir_entry(block_device* hd, uint32_t dirFirstCluster, const char* fileName, partition_descr *partDesc) {
     uint32_t nextDirCluster = dirFirstCluster;
 
     directory_entry_fat32 dirent[16];
@@ -1150,7 +1146,7 @@ directory_entry_fat32 find_file_dir_entry(ata_drive hd, uint32_t dirFirstCluster
             int dirSectorOffset = 0;
             uint32_t dirSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (nextDirCluster - 2);
             do {
-                read28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
+                bdev_read_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
                 for (int i = 0; i < 16; i++) {
                     if(dirent[i].name[0] == 0x00) { // end of dir entries
                         moreEnt = false;
@@ -1177,7 +1173,7 @@ directory_entry_fat32 find_file_dir_entry(ata_drive hd, uint32_t dirFirstCluster
 
                     return dirent[i];
                 }
-            } while ((++dirSectorOffset <= partDesc->bpb.sectorPerCluster) && moreEnt);
+            } while ((++dirSectorOffset < partDesc->bpb.sectorPerCluster) && moreEnt);
             // gets next cluster belonging to the dir
             nextDirCluster = read_fat_entry(hd, nextDirCluster, partDesc);
     }
@@ -1189,7 +1185,7 @@ directory_entry_fat32 find_file_dir_entry(ata_drive hd, uint32_t dirFirstCluster
 /// @param firstCluster the cluster the file starts in
 /// @param size the size of the file
 /// @param partDesc 
-void read_file_by_cluster(ata_drive hd, uint32_t firstCluster, uint32_t size, partition_descr *partDesc) {
+void read_file_by_cluster(block_device* hd, uint32_t firstCluster, uint32_t size, partition_descr *partDesc) {
     //if file is empty
     if (size == 0)
         return;
@@ -1207,12 +1203,14 @@ void read_file_by_cluster(ata_drive hd, uint32_t firstCluster, uint32_t size, pa
         // reads all sectors belonging to file from curr file cluster
         for (; SIZE > 0; SIZE -= 512)
         {
-            read28(hd, fileSector + sectorOffset, buffer, 512);
+            bdev_read_sector(hd, fileSector + sectorOffset, buffer, 512);
             //buffer[] = '\0';
+            print((char*)buffer, SIZE > 512 ? 512 : SIZE);
 
-            if(++sectorOffset > partDesc->bpb.sectorPerCluster)
+            if(++sectorOffset >= partDesc->bpb.sectorPerCluster) {
+                SIZE -= 512;
                 break;
-            print((char*)buffer, SIZE > 512 ? 512 : SIZE);
+            }
         }
         
         nextFileCluster = read_fat_entry(hd, nextFileCluster, partDesc);
@@ -1225,7 +1223,7 @@ void read_file_by_cluster(ata_drive hd, uint32_t firstCluster, uint32_t size, pa
 /// @param path the specified path
 /// @param partDesc 
 /// @return the first cluster index of the entry
-uint32_t find_dir_first_cluster(ata_drive hd, const char* path, partition_descr *partDesc) {
+uint32_t find_dir_first_cluster(block_device* hd, const char* path, partition_descr *partDesc) {
     uint32_t currentDirCluster;
 
     //checks if path starts from root or CWD
@@ -1249,7 +1247,7 @@ uint32_t find_dir_first_cluster(ata_drive hd, const char* path, partition_descr
             int dirSectorOffset = 0;
             uint32_t dirSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (nextDirCluster - 2);
             do {
-                read28(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
+                bdev_read_sector(hd, dirSector + dirSectorOffset, (uint8_t*)&dirent[0], 16*sizeof(directory_entry_fat32));
                 if (strcmp(nextDirName, ".") == 0) { // Checks if . is used
                     found = 1;
                     continue;
@@ -1297,7 +1295,7 @@ uint32_t find_dir_first_cluster(ata_drive hd, const char* path, partition_descr
                     currentDirCluster = EntCluster;
                     found = 1;
                 }
-            } while ((++dirSectorOffset <= partDesc->bpb.sectorPerCluster) && moreEnt && !found);
+            } while ((++dirSectorOffset < partDesc->bpb.sectorPerCluster) && moreEnt && !found);
             // gets next cluster belonging to the dir
             nextDirCluster = read_fat_entry(hd, nextDirCluster, partDesc);
         }
@@ -1316,10 +1314,12 @@ uint32_t find_dir_first_cluster(ata_drive hd, const char* path, partition_descr
 /// @param hd 
 /// @param path the path of the new wd
 /// @param partDesc 
-void change_current_working_dir(ata_drive hd, const char* path, partition_descr *partDesc) {
+void change_current_working_dir(block_device* hd, const char* path, partition_descr *partDesc) {
+    mutex_lock(&fat_lock);
     uint32_t dirCluster = find_dir_first_cluster(hd, path, partDesc);
     if(dirCluster == 0xFFFFFFFF) { //invalid path
         print_string("No such Directory");
+        mutex_unlock(&fat_lock);
         return;
     }
 
@@ -1362,14 +1362,17 @@ void change_current_working_dir(ata_drive hd, const char* path, partition_descr
             len += strlen(tokens[i]);
         }
     }
+    mutex_unlock(&fat_lock);
 }
 
 /// @brief reads the dir specified in path
 /// @param hd 
 /// @param path 
 /// @param partDesc 
-void read_dir(ata_drive hd, const char* path, partition_descr *partDesc) {
+void read_dir(block_device* hd, const char* path, partition_descr *partDesc) {
+    mutex_lock(&fat_lock);
     read_dir_by_cluster(hd, find_dir_first_cluster(hd, path, partDesc), partDesc);
+    mutex_unlock(&fat_lock);
 }
 
 /// @brief reads a certian file
@@ -1377,14 +1380,17 @@ void read_dir(ata_drive hd, const char* path, partition_descr *partDesc) {
 /// @param dirPath the path of the dir the file is loacted in
 /// @param fileName the name of the file
 /// @param partDesc 
-void read_file(ata_drive hd, const char* dirPath, const char* fileName, partition_descr *partDesc) {
+void read_file(block_device* hd, const char* dirPath, const char* fileName, partition_descr *partDesc) {
+    mutex_lock(&fat_lock);
     uint32_t dirsCluster = find_dir_first_cluster(hd, dirPath, partDesc);
     if(dirsCluster == 0xFFFFFFFF) { //invalid path
         print_string("invalid path");
+        mutex_unlock(&fat_lock);
         return;
     }
     if(!is_file_in_dir(hd, dirsCluster, fileName, partDesc)) { // file not found
         print_string("file not found");
+        mutex_unlock(&fat_lock);
         return;
     } 
 
@@ -1392,6 +1398,7 @@ void read_file(ata_drive hd, const char* dirPath, const char* fileName, partitio
     uint32_t firstFileClust = ((uint32_t)fileEnt.firstClusterHi) << 16
     | ((uint32_t)fileEnt.firstClusterLo);
     read_file_by_cluster(hd, firstFileClust, fileEnt.size, partDesc);
+    mutex_unlock(&fat_lock);
 }
 
 /// @brief creates a file
@@ -1399,22 +1406,27 @@ void read_file(ata_drive hd, const char* dirPath, const char* fileName, partitio
 /// @param dirPath the path of the dir in which the file needs to be created
 /// @param fileName the name of the file
 /// @param partDesc 
-void create_file(ata_drive hd, char* path, char* fileName, partition_descr *partDesc) {
+void create_file(block_device* hd, char* path, char* fileName, partition_descr *partDesc) {
+    mutex_lock(&fat_lock);
     uint32_t dirCluster = find_dir_first_cluster(hd, path, partDesc);
 
     //directory not found
     if(dirCluster == 0xFFFFFFFF) {
         print_string("invalid path");
+        mutex_unlock(&fat_lock);
         return;
     }
 
     //file already exists
     if(is_file_in_dir(hd, dirCluster, fileName, partDesc)) {
         print_string("flie exists");
+        mutex_unlock(&fat_lock);
         return;
     }
 
     create_file_by_dir_cluster(hd, dirCluster, fileName, partDesc);
+    bdev_flush(hd);
+    mutex_unlock(&fat_lock);
 }
 
 /// @brief deletes a certain file
@@ -1422,17 +1434,22 @@ void create_file(ata_drive hd, char* path, char* fileName, partition_descr *part
 /// @param dirPath the path of the dir the file is loacted in
 /// @param fileName the name of the file
 /// @param partDesc 
-void delete_file(ata_drive hd, char* dirPath, char* fileName, partition_descr *partDesc) {
+void delete_file(block_device* hd, char* dirPath, char* fileName, partition_descr *partDesc) {
+    mutex_lock(&fat_lock);
     uint32_t dirCluster = find_dir_first_cluster(hd, dirPath, partDesc);
     if(dirCluster == 0xFFFFFFFF) { //invalid path
         print_string("invalid path");
+        mutex_unlock(&fat_lock);
         return;
     }
     if(!is_file_in_dir(hd, dirCluster, fileName, partDesc)) { // file not found
         print_string("file not found");
+        mutex_unlock(&fat_lock);
         return;
     } 
     delete_file_by_dir_cluster(hd, dirCluster, fileName, partDesc);
+    bdev_flush(hd);
+    mutex_unlock(&fat_lock);
 }
 
 /// @brief creates a dir
@@ -1440,18 +1457,23 @@ void delete_file(ata_drive hd, char* dirPath, char* fileName, partition_descr *p
 /// @param path the path of the dir in which the new dir needs to be placed
 /// @param dirName the name of the dir
 /// @param partDesc 
-void create_dir(ata_drive hd, char* path, char* dirName, partition_descr *partDesc) {
+void create_dir(block_device* hd, char* path, char* dirName, partition_descr *partDesc) {
+    mutex_lock(&fat_lock);
     uint32_t parentCluster = find_dir_first_cluster(hd, path, partDesc);
     if(parentCluster == 0xFFFFFFFF) { //invalid path
         print_string("invalid path");
+        mutex_unlock(&fat_lock);
         return;
     }
     if(is_file_in_dir(hd, parentCluster, dirName, partDesc)) { // dir already exists
         print_string("dir already exists");
+        mutex_unlock(&fat_lock);
         return;
     }
 
     create_dir_by_parent_cluster(hd, parentCluster, dirName, partDesc);
+    bdev_flush(hd);
+    mutex_unlock(&fat_lock);
 }
 
 /// @brief deletes a certain dir
@@ -1459,17 +1481,22 @@ void create_dir(ata_drive hd, char* path, char* dirName, partition_descr *partDe
 /// @param dirPath the path of the parent dir of dir
 /// @param dirName the name of the dir
 /// @param partDesc 
-void delete_dir(ata_drive hd, char* dirPath, char* dirName, partition_descr *partDesc) {
+void delete_dir(block_device* hd, char* dirPath, char* dirName, partition_descr *partDesc) {
+    mutex_lock(&fat_lock);
     uint32_t parentDirCluster = find_dir_first_cluster(hd, dirPath, partDesc);
     if(parentDirCluster == 0xFFFFFFFF) { //invalid path
         print_string("invalid path");
+        mutex_unlock(&fat_lock);
         return;
     }
     if(!is_file_in_dir(hd, parentDirCluster, dirName, partDesc)) { // file not found
         print_string("dir not found");
+        mutex_unlock(&fat_lock);
         return;
     } 
     delete_dir_by_parent_cluster(hd, parentDirCluster, dirName, partDesc);
+    bdev_flush(hd);
+    mutex_unlock(&fat_lock);
 }
 
 /// @brief writes to a specified file
@@ -1480,14 +1507,17 @@ void delete_dir(ata_drive hd, char* dirPath, char* dirName, partition_descr *par
 /// @param size the size of the data to write
 /// @param rewrite whether to append the data or rewrite the file
 /// @param partDesc 
-void write_to_file(ata_drive hd, const char* dirPath,const char *fileName, const char *data, uint32_t size, bool rewrite, partition_descr *partDesc) {
+void write_to_file(block_device* hd, const char* dirPath,const char *fileName, const char *data, uint32_t size, bool rewrite, partition_descr *partDesc) {
+    mutex_lock(&fat_lock);
     uint32_t dirsCluster = find_dir_first_cluster(hd, dirPath, partDesc);
     if(dirsCluster == 0xFFFFFFFF) { //invalid path
         print_string("invalid path");
+        mutex_unlock(&fat_lock);
         return;
     }
     if(!is_file_in_dir(hd, dirsCluster, fileName, partDesc)) { // file not found
         print_string("file not found: ");
+        mutex_unlock(&fat_lock);
         return;
     } 
     if (rewrite) {
@@ -1495,6 +1525,108 @@ void write_to_file(ata_drive hd, const char* dirPath,const char *fileName, const
     } else {
         append_to_file_by_dir_cluster(hd, dirsCluster, fileName, partDesc, data, size);
     }
+    // the writes above were only queued, they reach the disk together here
+    bdev_flush(hd);
+    mutex_unlock(&fat_lock);
+}
+
+/// @brief reads part of a file into a buffer
+/// @param hd 
+/// @param dirPath the path of the dir the file is loacted in
+/// @param fileName the name of the file
+/// @param offset the byte in the file to start reading from
+/// @param buff where to put the data
+/// @param len the amount of bytes to read
+/// @param partDesc 
+/// @return the amount of bytes read, -1 if the file wasnt found
+int32_t fat_read(block_device* hd, const char* dirPath, const char* fileName, uint32_t offset, uint8_t* buff, uint32_t len, partition_descr *partDesc) {
+    mutex_lock(&fat_lock);
+    uint32_t dirsCluster = find_dir_first_cluster(hd, dirPath, partDesc);
+    if(dirsCluster == 0xFFFFFFFF) { //invalid path
+        mutex_unlock(&fat_lock);
+        return -1;
+    }
+    if(!is_file_in_dir(hd, dirsCluster, fileName, partDesc)) { // file not found
+        mutex_unlock(&fat_lock);
+        return -1;
+    }
+
+    directory_entry_fat32 fileEnt = find_file_dir_entry(hd, dirsCluster, fileName, partDesc);
+    if(offset >= fileEnt.size) {
+        mutex_unlock(&fat_lock);
+        return 0;
+    }
+    if(len > fileEnt.size - offset)
+        len = fileEnt.size - offset;
+
+    uint32_t clusterBytes = partDesc->bpb.sectorPerCluster * SECTOR_SIZE;
+    uint32_t cluster = ((uint32_t)fileEnt.firstClusterHi) << 16 | ((uint32_t)fileEnt.firstClusterLo);
+    // skips the clusters before offset
+    for (uint32_t i = 0; (i < offset / clusterBytes) && (cluster < 0x0FFFFFF8); i++)
+        cluster = read_fat_entry(hd, cluster, partDesc);
+
+    uint8_t sector[SECTOR_SIZE];
+    uint32_t done = 0;
+    uint32_t pos = offset;
+    while ((done < len) && (cluster < 0x0FFFFFF8)) {
+        uint32_t inCluster = pos % clusterBytes;
+        uint32_t inSector = inCluster % SECTOR_SIZE;
+        uint32_t chunk = SECTOR_SIZE - inSector;
+        if(chunk > len - done)
+            chunk = len - done;
+
+        uint32_t fileSector = partDesc->fatDesc.data_start + partDesc->bpb.sectorPerCluster * (cluster - 2);
+        if(inSector == 0 && len - done >= SECTOR_SIZE) {
+            // whole sectors go straight into the buffer, up to the end of the cluster in one command
+            uint32_t sectors = (len - done) / SECTOR_SIZE;
+            uint32_t leftInCluster = (clusterBytes - inCluster) / SECTOR_SIZE;
+            if(sectors > leftInCluster)
+                sectors = leftInCluster;
+            if(sectors > MAX_RUN_SECTORS)
+                sectors = MAX_RUN_SECTORS;
+            chunk = sectors * SECTOR_SIZE;
+            if(!bdev_read(hd, fileSector + inCluster / SECTOR_SIZE, sectors, buff + done))
+                break;
+        } else {
+            bdev_read_sector(hd, fileSector + inCluster / SECTOR_SIZE, sector, SECTOR_SIZE);
+            memcpy(buff + done, sector + inSector, chunk);
+        }
+        done += chunk;
+        pos += chunk;
+
+        // moves on to the next cluster of the file
+        if(pos % clusterBytes == 0)
+            cluster = read_fat_entry(hd, cluster, partDesc);
+    }
+    mutex_unlock(&fat_lock);
+    return done;
+}
+
+/// @brief gets the size and attributes of a file
+/// @param hd 
+/// @param dirPath the path of the dir the file is loacted in
+/// @param fileName the name of the file
+/// @param stat where to put the info
+/// @param partDesc 
+/// @return true if the file was found
+bool fat_stat(block_device* hd, const char* dirPath, const char* fileName, fat_stat_t* stat, partition_descr *partDesc) {
+    mutex_lock(&fat_lock);
+    uint32_t dirsCluster = find_dir_first_cluster(hd, dirPath, partDesc);
+    if(dirsCluster == 0xFFFFFFFF) { //invalid path
+        mutex_unlock(&fat_lock);
+        return false;
+    }
+    if(!is_file_in_dir(hd, dirsCluster, fileName, partDesc)) { // file not found
+        mutex_unlock(&fat_lock);
+        return false;
+    }
+
+    directory_entry_fat32 fileEnt = find_file_dir_entry(hd, dirsCluster, fileName, partDesc);
+    stat->size = fileEnt.size;
+    stat->firstCluster = ((uint32_t)fileEnt.firstClusterHi) << 16 | ((uint32_t)fileEnt.firstClusterLo);
+    stat->attributes = fileEnt.attributes;
+    mutex_unlock(&fat_lock);
+    return true;
 }
 
 /// @brief checks if a specified file exists
@@ -1503,15 +1635,19 @@ void write_to_file(ata_drive hd, const char* dirPath,const char *fileName, const
 /// @param fileName the name of the file
 /// @param partDesc 
 /// @return true if exists, false otherwise
-bool is_file_exist(ata_drive hd, const char* dirPath, const char *fileName, partition_descr *partDesc) {
+bool is_file_exist(block_device* hd, const char* dirPath, const char *fileName, partition_descr *partDesc) {
+    mutex_lock(&fat_lock);
     uint32_t dirsCluster = find_dir_first_cluster(hd, dirPath, partDesc);
     if(dirsCluster == 0xFFFFFFFF) { //invalid path
+        mutex_unlock(&fat_lock);
         return false;
     }
     if(!is_file_in_dir(hd, dirsCluster, fileName, partDesc)) { // file not found
+        mutex_unlock(&fat_lock);
         return false;
     }
     
+    mutex_unlock(&fat_lock);
     return true;
 }
 
@@ -1520,18 +1656,21 @@ bool is_file_exist(ata_drive hd, const char* dirPath, const char *fileName, part
 /// @param dirPath the path of the dir
 /// @param partDesc 
 /// @return true if exists, false otherwise
-bool is_dir_exist(ata_drive hd, const char* dirPath, partition_descr *partDesc) {
+bool is_dir_exist(block_device* hd, const char* dirPath, partition_descr *partDesc) {
+    mutex_lock(&fat_lock);
     uint32_t dirsCluster = find_dir_first_cluster(hd, dirPath, partDesc);
     if(dirsCluster == 0xFFFFFFFF) { //invalid path
+        mutex_unlock(&fat_lock);
         return false;
     }
     
+    mutex_unlock(&fat_lock);
     return true;
 }
 
 /// @brief writes the contents of the whole file system
 /// @param hd 
 /// @param partDesc 
-void tree(ata_drive hd, partition_descr *partDesc) {
+void tree(block_device* hd, partition_descr *partDesc) {
     read_dir(hd, "", partDesc); 
 }
\ No newline at end of file
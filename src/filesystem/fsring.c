@@ -0,0 +1,242 @@
+#include <filesystem/fsring.h>
+#include <filesystem/fat.h>
+#include <multitasking.h>
+#include <hardwarecomms/cpu.h>
+#include <sync.h>
+#include <paging.h>
+
+// a ring and the volume its requests go to
+typedef struct {
+    fsring_t* volatile ring; // 0 once unregistered, the worker stops at the next request
+    block_device* hd;
+    partition_descr* partDesc;
+    task_t* owner;
+    volatile bool busy; // the worker is using the ring, its memory has to stay
+} fsring_binding;
+
+fsring_binding bindings[FSRING_MAX_RINGS];
+spinlock_t bindings_lock = SPINLOCK_INIT("fsring");
+wait_queue_t binding_idle; // woken when the worker is done with a ring
+volatile bool doorbell = false;
+wait_queue_t doorbell_waiters;
+
+/// @brief checks the memory a request names, a user task may only name its own window
+/// @param owner the task that registered the ring
+/// @param sqe 
+bool fsring_sqe_ok(task_t* owner, fsring_sqe* sqe)
+{
+    if (!owner->user)
+        return true;
+    // the names up to the longest path the fat code copies
+    if (!user_string_ok(owner, sqe->dirPath, 512) || !user_string_ok(owner, sqe->fileName, 512))
+        return false;
+    switch (sqe->opcode)
+    {
+    case FSRING_OP_READ:
+        return user_range_ok(owner, sqe->buff, sqe->len, true);
+    case FSRING_OP_WRITE:
+        return user_range_ok(owner, sqe->buff, sqe->len, false);
+    case FSRING_OP_STAT:
+        return user_range_ok(owner, sqe->buff, sizeof(fat_stat_t), true);
+    default:
+        return true;
+    }
+}
+
+/// @brief runs a single request, in the address space of the ring's owner
+/// @param binding the ring the request came from
+/// @param sqe the request
+/// @return the result for the completion
+int32_t fsring_exec(fsring_binding* binding, fsring_sqe* sqe)
+{
+    if (!fsring_sqe_ok(binding->owner, sqe))
+        return -1;
+
+    switch (sqe->opcode)
+    {
+    case FSRING_OP_READ:
+        return fat_read(binding->hd, sqe->dirPath, sqe->fileName, sqe->offset, (uint8_t*) sqe->buff, sqe->len, binding->partDesc);
+    case FSRING_OP_WRITE:
+        if (!is_file_exist(binding->hd, sqe->dirPath, sqe->fileName, binding->partDesc))
+            return -1;
+        write_to_file(binding->hd, sqe->dirPath, sqe->fileName, (const char*) sqe->buff, sqe->len, !(sqe->flags & FSRING_F_APPEND), binding->partDesc);
+        return sqe->len;
+    case FSRING_OP_CREATE:
+        if (!is_dir_exist(binding->hd, sqe->dirPath, binding->partDesc) || is_file_exist(binding->hd, sqe->dirPath, sqe->fileName, binding->partDesc))
+            return -1;
+        create_file(binding->hd, (char*) sqe->dirPath, (char*) sqe->fileName, binding->partDesc);
+        return 0;
+    case FSRING_OP_STAT:
+        return fat_stat(binding->hd, sqe->dirPath, sqe->fileName, (fat_stat_t*) sqe->buff, binding->partDesc) ? 0 : -1;
+    default:
+        return -1;
+    }
+}
+
+/// @brief runs the pending requests of a ring in submission order
+/// @param binding 
+void fsring_process(fsring_binding* binding)
+{
+    fsring_t* ring = binding->ring;
+    while (binding->ring && ring->sq_head != ring->sq_tail) {
+        // leaves the rest queued until the task makes room for completions
+        if (ring->cq_tail - ring->cq_head >= FSRING_ENTRIES)
+            break;
+
+        fsring_sqe sqe = ring->sq[ring->sq_head & FSRING_MASK];
+        ring->sq_head++;
+
+        // holds the fat lock over the checks and the operation together
+        mutex_lock(&fat_lock);
+        int32_t result = fsring_exec(binding, &sqe);
+        mutex_unlock(&fat_lock);
+
+        fsring_cqe* cqe = &ring->cq[ring->cq_tail & FSRING_MASK];
+        cqe->user_data = sqe.user_data;
+        cqe->result = result;
+        asm volatile("" : : : "memory");
+        ring->cq_tail++;
+    }
+}
+
+/// @brief the kernel worker, drains the rings whenever the doorbell was rung
+void fsring_worker_main()
+{
+    while (true) {
+        uint32_t flags = irq_save();
+        wait_event(&doorbell_waiters, doorbell);
+        doorbell = false;
+        irq_restore(flags);
+
+        for (int i = 0; i < FSRING_MAX_RINGS; i++)
+        {
+            flags = spin_lock_irqsave(&bindings_lock);
+            bool live = bindings[i].ring != 0;
+            bindings[i].busy = live;
+            spin_unlock_irqrestore(&bindings_lock, flags);
+            if (!live)
+                continue;
+
+            // the ring and everything its requests point at are in the owner's
+            // memory, which stays while the binding is busy
+            task_use_address_space(bindings[i].owner);
+            fsring_process(&bindings[i]);
+            task_use_address_space(0);
+            bindings[i].busy = false;
+            wake_all(&binding_idle);
+        }
+    }
+}
+
+/// @brief starts the worker task
+void fsring_init()
+{
+    wait_queue_init(&doorbell_waiters);
+    wait_queue_init(&binding_idle);
+    task_t* worker = spawn_kernel_task(fsring_worker_main, TASK_PRIO_BATCH);
+    if (worker)
+        set_task_name(worker, "fsring");
+}
+
+/// @brief registers a ring with the kernel for the calling task
+/// @param ring the rings, in the caller's own memory
+/// @param hd the drive its requests go to
+/// @param partDesc the partition its requests go to
+/// @return the ring slot, -1 if all are taken or the ring already is registered
+int fsring_setup(fsring_t* ring, block_device* hd, partition_descr* partDesc)
+{
+    // the worker writes both, for a user task they have to be its own
+    task_t* task = get_current_task();
+    if (task->user && (!user_range_ok(task, ring, sizeof(fsring_t), true) || !user_range_ok(task, partDesc, sizeof(partition_descr), true)))
+        return -1;
+
+    int slot = -1;
+    uint32_t flags = spin_lock_irqsave(&bindings_lock);
+    for (int i = 0; i < FSRING_MAX_RINGS; i++)
+    {
+        if (bindings[i].ring == ring) {
+            spin_unlock_irqrestore(&bindings_lock, flags);
+            return -1;
+        }
+        // a slot the worker is still leaving isnt free yet
+        if (slot < 0 && !bindings[i].ring && !bindings[i].busy)
+            slot = i;
+    }
+    if (slot >= 0) {
+        // the worker only looks at the ring once it is set, after the indices
+        ring->sq_head = ring->sq_tail = 0;
+        ring->cq_head = ring->cq_tail = 0;
+        bindings[slot].hd = hd;
+        bindings[slot].partDesc = partDesc;
+        bindings[slot].owner = task;
+        asm volatile("" : : : "memory");
+        bindings[slot].ring = ring;
+    }
+    spin_unlock_irqrestore(&bindings_lock, flags);
+    return slot;
+}
+
+/// @brief unregisters rings and waits until the worker is done with them
+/// @param ring the ring, 0 for all of the owner's
+/// @param owner the task that registered them
+/// @return the amount of rings unregistered
+int fsring_unbind(fsring_t* ring, task_t* owner)
+{
+    int found = 0;
+    bool unbound[FSRING_MAX_RINGS] = { false };
+    uint32_t flags = irq_save();
+    spin_lock(&bindings_lock);
+    for (int i = 0; i < FSRING_MAX_RINGS; i++)
+    {
+        if (bindings[i].ring && bindings[i].owner == owner && (!ring || bindings[i].ring == ring)) {
+            bindings[i].ring = 0;
+            unbound[i] = true;
+            found++;
+        }
+    }
+    spin_unlock(&bindings_lock);
+
+    for (int i = 0; i < FSRING_MAX_RINGS; i++)
+    {
+        if (unbound[i])
+            wait_event(&binding_idle, !bindings[i].busy);
+    }
+    irq_restore(flags);
+    return found;
+}
+
+/// @brief unregisters a ring of the calling task
+/// @param ring 
+/// @return 0, -1 if the task hasnt registered it
+int fsring_teardown(fsring_t* ring)
+{
+    if (!ring)
+        return -1;
+    return fsring_unbind(ring, get_current_task()) ? 0 : -1;
+}
+
+/// @brief drops every ring of an exiting task, so its memory can go
+/// @param task 
+void fsring_release_task(task_t* task)
+{
+    fsring_unbind(0, task);
+}
+
+/// @brief the doorbell, wakes the worker for the queued requests
+/// @param ring a ring the calling task registered
+/// @return the amount of requests waiting in the ring, -1 if the task doesnt own it
+int fsring_enter(fsring_t* ring)
+{
+    task_t* task = get_current_task();
+    bool owned = false;
+    uint32_t flags = spin_lock_irqsave(&bindings_lock);
+    for (int i = 0; i < FSRING_MAX_RINGS && !owned; i++)
+        owned = ring && bindings[i].ring == ring && bindings[i].owner == task;
+    spin_unlock_irqrestore(&bindings_lock, flags);
+    if (!owned)
+        return -1;
+
+    doorbell = true;
+    wake_one(&doorbell_waiters);
+    return ring->sq_tail - ring->sq_head;
+}
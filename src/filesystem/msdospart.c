@@ -1,13 +1,14 @@
 #include <filesystem/msdospart.h>
 #include <filesystem/fat.h>
+#include <drivers/blockdev.h>
 #include <io/screen.h>
 #include <memorymanagement.h>
 /// @brief reads the partiton table of the drive and prints basic info
 /// @param drive
 /// @return an array of partition descriptors
-partition_descr* read_partitions(ata_drive drive) {
+partition_descr* read_partitions(block_device* drive) {
     master_boot_record mbr;
-    read28(drive, 0,(uint8_t*)&mbr, sizeof(master_boot_record));
+    bdev_read_sector(drive, 0,(uint8_t*)&mbr, sizeof(master_boot_record));
 
     if(mbr.magicnum != 0xAA55)
     {
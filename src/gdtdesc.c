@@ -1,5 +1,6 @@
 #include <gdtdesc.h>
 #include <common/tools.h>
+#include <smp.h>
 extern void gdt_write(unsigned int);
 
 struct gdt_entry_struct
@@ -22,9 +23,10 @@ struct gdt_ptr_struct
 
 typedef struct gdt_ptr_struct gdt_ptr_t;
 
-#define GDT_ENTRIES_COUNT 6
+// one tss per cpu, cpu n uses selector TSS_SEG + n * 8
+#define GDT_ENTRIES_COUNT (5 + MAX_CPUS)
 gdt_entry_t gdt_entries[GDT_ENTRIES_COUNT];
-TSS tss;
+TSS tss[MAX_CPUS] __attribute__((aligned(4))); // 104 bytes each, so every esp0 stays aligned
 
 void gdt_set_gate(int idx, unsigned int base, unsigned int limit, unsigned char access, unsigned char granularity)
 {
@@ -39,28 +41,43 @@ void gdt_set_gate(int idx, unsigned int base, unsigned int limit, unsigned char
 
 void change_tss_esp0(uint32_t val)
 {
-	tss.esp0 = val;
+	tss[cpu_id()].esp0 = val;
 }
 
-void gdt_setup(void)
+uint32_t* get_tss_esp0_ptr(void)
 {
-	gdt_ptr_t gdt_ptr;
-	gdt_ptr.limit = (sizeof(gdt_entry_t) * GDT_ENTRIES_COUNT) - 1;
-	gdt_ptr.base  = (unsigned int)&gdt_entries;
+	// esp0 sits at offset 4 of an aligned tss, so the pointer is aligned too
+	return (uint32_t*) ((uint8_t*) &tss[cpu_id()] + __builtin_offsetof(TSS, esp0));
+}
 
-	memset((uint8_t*) &tss, 0, sizeof(tss));
-	tss.ss0 = KERNEL_DS;
+void gdt_setup(void)
+{
+	memset((uint8_t*) tss, 0, sizeof(tss));
 
 	gdt_set_gate(0, 0, 0, 0, 0);
 	gdt_set_gate(1, 0, 0xFFFFFFFF, 0x9A, 0xCF); // Ring 0 CS 0x8
 	gdt_set_gate(2, 0, 0xFFFFFFFF, 0x92, 0xCF); // Ring 0 DS 0x10
 	gdt_set_gate(3, 0, 0xFFFFFFFF, 0xFA, 0xCF); // Ring 3 CS 0x18
 	gdt_set_gate(4, 0, 0xFFFFFFFF, 0xF2, 0xCF); // Ring 3 DS 0x20
-	gdt_set_gate(5, (uint32_t) &tss, sizeof(tss), 0x89, 0x40); // TSS 0x28
+	for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+		tss[cpu].ss0 = KERNEL_DS;
+		gdt_set_gate(5 + cpu, (uint32_t) &tss[cpu], sizeof(TSS), 0x89, 0x40); // TSS 0x28 + cpu * 8
+	}
+
+	gdt_load_cpu(0);
+}
+
+/// @brief loads the shared gdt and the tss of a cpu, run by every cpu once
+/// @param cpu the index of the cpu
+void gdt_load_cpu(uint32_t cpu)
+{
+	gdt_ptr_t gdt_ptr;
+	gdt_ptr.limit = (sizeof(gdt_entry_t) * GDT_ENTRIES_COUNT) - 1;
+	gdt_ptr.base  = (unsigned int)&gdt_entries;
 
 	gdt_write((unsigned int)&gdt_ptr);
 
-	// load task register with the TSS segment selector 0x28
-	asm("ltr %%ax" :: "a"((uint16_t) TSS_SEG));
+	// the task register also tells cpu_id which cpu this is
+	asm("ltr %%ax" :: "a"((uint16_t) (TSS_SEG + cpu * 8)));
 }
 
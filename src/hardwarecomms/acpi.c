@@ -0,0 +1,66 @@
+#include <hardwarecomms/acpi.h>
+
+/// @brief sums the bytes of a table, valid tables sum to 0
+/// @param data 
+/// @param len 
+/// @return the checksum
+uint8_t acpi_checksum(const uint8_t* data, uint32_t len)
+{
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < len; i++)
+        sum += data[i];
+    return sum;
+}
+
+/// @brief scans a memory range for the rsdp, it sits on a 16 byte boundary
+/// @param start 
+/// @param end 
+/// @return the rsdp, 0 if not found
+acpi_rsdp* acpi_scan_rsdp(uint32_t start, uint32_t end)
+{
+    for (uint32_t addr = start; addr < end; addr += 16)
+    {
+        const char* sig = (const char*) addr;
+        if (sig[0] == 'R' && sig[1] == 'S' && sig[2] == 'D' && sig[3] == ' ' &&
+            sig[4] == 'P' && sig[5] == 'T' && sig[6] == 'R' && sig[7] == ' ' &&
+            acpi_checksum((const uint8_t*) addr, sizeof(acpi_rsdp)) == 0)
+            return (acpi_rsdp*) addr;
+    }
+    return 0;
+}
+
+/// @brief finds the rsdp in the first kb of the ebda or the bios rom area
+/// @return the rsdp, 0 if the machine has no acpi
+acpi_rsdp* acpi_find_rsdp()
+{
+    uint32_t ebda = ((uint32_t) *(uint16_t*) 0x40E) << 4;
+    acpi_rsdp* rsdp = 0;
+    if (ebda)
+        rsdp = acpi_scan_rsdp(ebda, ebda + 1024);
+    if (!rsdp)
+        rsdp = acpi_scan_rsdp(0xE0000, 0x100000);
+    return rsdp;
+}
+
+/// @brief finds an acpi table through the rsdt
+/// @param signature the 4 letter signature of the table
+/// @return the table, 0 if not found
+acpi_sdt_header* acpi_find_table(const char* signature)
+{
+    acpi_rsdp* rsdp = acpi_find_rsdp();
+    if (!rsdp)
+        return 0;
+
+    acpi_sdt_header* rsdt = (acpi_sdt_header*) rsdp->rsdtAddress;
+    uint32_t entries = (rsdt->length - sizeof(acpi_sdt_header)) / 4;
+    uint32_t* tables = (uint32_t*) (rsdt + 1);
+    for (uint32_t i = 0; i < entries; i++)
+    {
+        acpi_sdt_header* table = (acpi_sdt_header*) tables[i];
+        if (table->signature[0] == signature[0] && table->signature[1] == signature[1] &&
+            table->signature[2] == signature[2] && table->signature[3] == signature[3] &&
+            acpi_checksum((const uint8_t*) table, table->length) == 0)
+            return table;
+    }
+    return 0;
+}
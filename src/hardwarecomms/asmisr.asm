@@ -299,7 +299,9 @@ isr_common_stub:
 	mov gs, ax
 	pop eax
 
+	push esp ; registers_t* for the handler
 	call isr_handler
+	add esp, 4
 
 	pop gs
 	pop fs
@@ -329,7 +331,9 @@ irq_common_stub:
 	mov gs, ax
 	pop eax
 
+	push esp ; registers_t* for the handler
 	call irq_handler
+	add esp, 4
 
 	pop gs
 	pop fs
@@ -0,0 +1,155 @@
+#include <hardwarecomms/fpu.h>
+#include <hardwarecomms/cpu.h>
+#include <hardwarecomms/isr.h>
+#include <memorymanagement.h>
+#include <io/screen.h>
+#include <smp.h>
+
+#define CPUID_FXSR (1 << 24)
+#define CPUID_SSE (1 << 25)
+#define CR0_MP 0x2
+#define CR0_EM 0x4
+#define CR0_TS 0x8
+#define CR0_NE 0x20
+#define CR4_OSFXSR 0x200
+#define CR4_OSXMMEXCPT 0x400
+#define MXCSR_DEFAULT 0x1F80 // every sse exception masked
+
+// the task whose registers this cpu's fpu last held, see fpu_switch
+task_t* fpu_owner[MAX_CPUS];
+bool fpu_fxsr = false;
+bool fpu_sse = false;
+
+static inline uint32_t read_cr0(void)
+{
+    uint32_t cr0;
+    asm volatile("mov %%cr0, %0" : "=r" (cr0));
+    return cr0;
+}
+
+static inline void write_cr0(uint32_t cr0)
+{
+    asm volatile("mov %0, %%cr0" : : "r" (cr0));
+}
+
+/// @brief the 16 byte aligned save area of a task
+static inline uint8_t* fpu_state(task_t* task)
+{
+    return (uint8_t*) (((uint32_t) task->fpu_area + 15) & ~15);
+}
+
+/// @brief stores the fpu registers into a task
+static inline void fpu_save(task_t* task)
+{
+    if (fpu_fxsr)
+        asm volatile("fxsave (%0)" : : "r" (fpu_state(task)) : "memory");
+    else
+        asm volatile("fnsave (%0); fwait" : : "r" (fpu_state(task)) : "memory");
+}
+
+/// @brief loads the fpu registers of a task
+static inline void fpu_restore(task_t* task)
+{
+    if (fpu_fxsr)
+        asm volatile("fxrstor (%0)" : : "r" (fpu_state(task)) : "memory");
+    else
+        asm volatile("frstor (%0)" : : "r" (fpu_state(task)) : "memory");
+}
+
+/// @brief vector 7, the running task touched the fpu while cr0.ts was set.
+/// gives it the fpu, loading its registers or fresh ones on first use
+/// @param regs 
+void fpu_trap(registers_t* regs)
+{
+    asm volatile("clts");
+    uint32_t cpu = cpu_id();
+    task_t* task = get_current_task();
+    if (fpu_owner[cpu] == task && task->fpu_cpu == cpu)
+        return;
+
+    if (!task->fpu_area) {
+        task->fpu_area = malloc(FPU_STATE_SIZE + 15);
+        if (!task->fpu_area) {
+            terminal_write_string("No memory for fpu state\n");
+            if ((regs->cs & 3) == 3)
+                task_exit();
+            while (true)
+                asm volatile("cli; hlt");
+        }
+        asm volatile("fninit");
+        if (fpu_sse) {
+            uint32_t mxcsr = MXCSR_DEFAULT;
+            asm volatile("ldmxcsr %0" : : "m" (mxcsr));
+        }
+    } else {
+        fpu_restore(task);
+    }
+    fpu_owner[cpu] = task;
+    task->fpu_cpu = cpu;
+}
+
+/// @brief turns on the fpu and sse for the running cpu, left trapping until first use
+void fpu_init(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    fpu_fxsr = edx & CPUID_FXSR;
+    fpu_sse = fpu_fxsr && (edx & CPUID_SSE);
+
+    // native fpu errors, wait honors ts
+    write_cr0((read_cr0() & ~CR0_EM) | CR0_MP | CR0_NE);
+    if (fpu_fxsr) {
+        uint32_t cr4;
+        asm volatile("mov %%cr4, %0" : "=r" (cr4));
+        cr4 |= CR4_OSFXSR;
+        if (fpu_sse)
+            cr4 |= CR4_OSXMMEXCPT;
+        asm volatile("mov %0, %%cr4" : : "r" (cr4));
+    }
+    asm volatile("fninit");
+
+    fpu_owner[cpu_id()] = 0;
+    register_interrupt_handler(7, fpu_trap);
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+/// @brief called by schedule before switching stacks. the registers of a task
+/// that used the fpu are saved on the way out, and stay loaded, so the task
+/// coming back here without another task using the fpu in between doesnt trap.
+/// a task that never touches the fpu costs a cr0 write at most
+/// @param old 
+/// @param next 
+void fpu_switch(task_t* old, task_t* next)
+{
+    uint32_t cpu = cpu_id();
+    uint32_t cr0 = read_cr0();
+
+    // ts is clear only while the owner runs, so it used or was handed the fpu
+    if (!(cr0 & CR0_TS) && fpu_owner[cpu] == old && old->state != TASK_DEAD) {
+        fpu_save(old);
+        // fnsave leaves the fpu reinitialized
+        if (!fpu_fxsr)
+            fpu_owner[cpu] = 0;
+    }
+
+    if (fpu_owner[cpu] == next && next->fpu_cpu == cpu) {
+        if (cr0 & CR0_TS)
+            asm volatile("clts");
+    } else if (!(cr0 & CR0_TS)) {
+        write_cr0(cr0 | CR0_TS);
+    }
+}
+
+/// @brief frees the fpu state of a dead task, on the cpu that last ran it
+/// @param task 
+void fpu_release(task_t* task)
+{
+    uint32_t cpu = cpu_id();
+    if (fpu_owner[cpu] == task)
+        fpu_owner[cpu] = 0;
+    if (task->fpu_area) {
+        free(task->fpu_area);
+        task->fpu_area = 0;
+    }
+    task->fpu_cpu = FPU_NO_CPU;
+}
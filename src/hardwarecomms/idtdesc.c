@@ -4,6 +4,7 @@
 #include <drivers/keyboard.h>
 #include <io/screen.h>
 #include <multitasking.h>
+#include <hardwarecomms/pit.h>
 extern void idt_write(unsigned int);
 
 extern void isr0(void);
@@ -303,7 +304,7 @@ void irq_setup(){
 	outb(0xA1, 0x01);
 	outb(0x21, 0x00);
 	outb(0xA1, 0x00);
-	register_irq_callback(IRQ0, &schedule);
+	register_irq_callback(IRQ0, &timer_interrupt);
 	register_irq_callback(IRQ1,&keyboard_input);
 }
 
@@ -318,10 +319,6 @@ void idt_set_gate(int idx, unsigned int base, unsigned short selector, unsigned
 }
 
 void idt_setup(){
-	idt_ptr_t idt_ptr;
-	idt_ptr.limit=sizeof(idt_entry_t)*256-1;
-	idt_ptr.base=(unsigned int)&idt_entries;
-	
 	idt_set_gate(0,(unsigned int)isr0,0x08,0x8e);
 	idt_set_gate(1,(unsigned int)isr1,0x08,0x8e);
 	idt_set_gate(2,(unsigned int)isr2,0x08,0x8e);
@@ -450,7 +447,7 @@ void idt_setup(){
 	idt_set_gate(125,(unsigned int)isr125,0x08,0x8e);
 	idt_set_gate(126,(unsigned int)isr126,0x08,0x8e);
 	idt_set_gate(127,(unsigned int)isr127,0x08,0x8e);
-	idt_set_gate(128,(unsigned int)isr128,0x08,0x8e);
+	idt_set_gate(128,(unsigned int)isr128,0x08,0xee); // DPL 3, reachable from user mode
 	idt_set_gate(129,(unsigned int)isr129,0x08,0x8e);
 	idt_set_gate(130,(unsigned int)isr130,0x08,0x8e);
 	idt_set_gate(131,(unsigned int)isr131,0x08,0x8e);
@@ -579,11 +576,19 @@ void idt_setup(){
 	idt_set_gate(254,(unsigned int)isr254,0x08,0x8e);
 	idt_set_gate(255,(unsigned int)isr255,0x08,0x8e);
 
-	idt_write((unsigned int)&idt_ptr);
+	idt_load();
 
 	irq_setup();
 }
 
+void idt_load(){
+	idt_ptr_t idt_ptr;
+	idt_ptr.limit=sizeof(idt_entry_t)*256-1;
+	idt_ptr.base=(unsigned int)&idt_entries;
+
+	idt_write((unsigned int)&idt_ptr);
+}
+
 void interrupts_activate()
 {
 	__asm__("sti");
@@ -3,30 +3,78 @@
 #include <hardwarecomms/portio.h>
 #include <multitasking.h>
 #include <syscalls.h>
+#include <hardwarecomms/softirq.h>
 void (*irq_callbacks[16])();
+void (*irq_shared_callbacks[16][IRQ_MAX_SHARED])();
+void (*interrupt_handlers[256])(registers_t*);
 
-void isr_handler(registers_t regs)
+void isr_handler(registers_t* regs)
 {
-	if((uint8_t) regs.int_no != 0x80) {
+	bool from_user = (regs->cs & 3) == 3;
+	if (from_user)
+		account_kernel_entry();
+
+	if (interrupt_handlers[(uint8_t) regs->int_no] != 0) {
+		(*interrupt_handlers[(uint8_t) regs->int_no])(regs);
+	} else if((uint8_t) regs->int_no != 0x80) {
 		terminal_write_string("Recieved interrupt: ");
-		terminal_write_int(regs.int_no, 16);
+		terminal_write_int(regs->int_no, 16);
 		terminal_write_string("\n");
 	} else {
 		handle_syscall(regs);
 	}
+
+	if (from_user)
+		account_kernel_exit();
 }
 
-void irq_handler(registers_t regs)
-{	outb(0x20, 0x20);
-	if (regs.int_no >= IRQ8){
+void irq_handler(registers_t* regs)
+{	bool from_user = (regs->cs & 3) == 3;
+	if (from_user)
+		account_kernel_entry();
+
+	outb(0x20, 0x20);
+	if (regs->int_no >= IRQ8){
 		outb(0xA0, 0x20);
 	}
-	if (irq_callbacks[regs.int_no-IRQ0]!=0){
-		(*irq_callbacks[regs.int_no-IRQ0])();
+	if (irq_callbacks[regs->int_no-IRQ0]!=0){
+		(*irq_callbacks[regs->int_no-IRQ0])();
 	}
+	// pci lines are shared, every device on the line checks if it was the one
+	for (int i = 0; i < IRQ_MAX_SHARED && irq_shared_callbacks[regs->int_no-IRQ0][i]; i++)
+		(*irq_shared_callbacks[regs->int_no-IRQ0][i])();
+	// bottom halves queued by the callback run after EOI with interrupts on
+	do_softirq();
+	// an irq nested in a bottom half leaves the switch to the outer one
+	if (!softirq_active())
+		schedule_if_needed();
+
+	if (from_user)
+		account_kernel_exit();
 }
 
 void register_irq_callback(int irq,void (*callback)()){
 	irq_callbacks[irq-IRQ0]=callback;
 }
 
+/// @brief adds a callback to a line other devices may be on too
+/// @param irq 
+/// @param callback must check its own device, it runs on every irq of the line
+/// @return false if the line has no room left
+bool register_shared_irq_callback(int irq,void (*callback)()){
+	for (int i = 0; i < IRQ_MAX_SHARED; i++)
+	{
+		if (!irq_shared_callbacks[irq-IRQ0][i]) {
+			irq_shared_callbacks[irq-IRQ0][i]=callback;
+			return true;
+		}
+	}
+	return false;
+}
+
+/// @brief handles a vector that doesnt go through the pic, like the local apic ones
+/// @param vector 
+/// @param handler called with the interrupted frame, sends its own EOI
+void register_interrupt_handler(uint8_t vector, void (*handler)(registers_t*)){
+	interrupt_handlers[vector]=handler;
+}
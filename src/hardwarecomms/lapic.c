@@ -0,0 +1,130 @@
+#include <hardwarecomms/lapic.h>
+#include <hardwarecomms/pit.h>
+#include <paging.h>
+
+enum LAPIC_REGS {
+    LAPIC_ID = 0x20,
+    LAPIC_EOI = 0xB0,
+    LAPIC_SVR = 0xF0,
+    LAPIC_ICR_LOW = 0x300,
+    LAPIC_ICR_HIGH = 0x310,
+    LAPIC_LVT_TIMER = 0x320,
+    LAPIC_TIMER_INITIAL = 0x380,
+    LAPIC_TIMER_CURRENT = 0x390,
+    LAPIC_TIMER_DIVIDE = 0x3E0,
+};
+
+#define ICR_DELIVERY_PENDING (1 << 12)
+#define ICR_LEVEL_ASSERT (1 << 14)
+#define ICR_LEVEL_TRIGGER (1 << 15)
+#define ICR_INIT (5 << 8)
+#define ICR_STARTUP (6 << 8)
+#define LVT_TIMER_PERIODIC (1 << 17)
+#define TIMER_DIVIDE_16 0x3
+
+volatile uint32_t* lapic = 0;
+uint32_t lapic_timer_count = 0; // timer counts per scheduler tick
+
+static inline uint32_t lapic_read(uint32_t reg)
+{
+    return lapic[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value)
+{
+    lapic[reg / 4] = value;
+}
+
+/// @brief sets the mmio base of the local apics
+/// @param base physical address from the madt
+void lapic_init(uint32_t base)
+{
+    lapic = (volatile uint32_t*) map_mmio(base, 0x1000);
+}
+
+/// @brief software enables the local apic of this cpu
+void lapic_enable(void)
+{
+    lapic_write(LAPIC_SVR, 0x100 | LAPIC_SPURIOUS_VECTOR);
+}
+
+/// @brief returns the apic id of this cpu
+uint8_t lapic_id(void)
+{
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+/// @brief signals end of interrupt to this cpu's apic
+void lapic_eoi(void)
+{
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/// @brief sends an interrupt command and waits for it to be accepted
+/// @param apic_id the destination
+/// @param command the low icr dword
+void lapic_send_command(uint8_t apic_id, uint32_t command)
+{
+    lapic_write(LAPIC_ICR_HIGH, ((uint32_t) apic_id) << 24);
+    lapic_write(LAPIC_ICR_LOW, command);
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_DELIVERY_PENDING)
+        asm volatile("pause");
+}
+
+/// @brief resets a cpu into wait-for-sipi
+/// @param apic_id 
+void lapic_send_init(uint8_t apic_id)
+{
+    lapic_send_command(apic_id, ICR_INIT | ICR_LEVEL_ASSERT);
+}
+
+/// @brief ends the init started by lapic_send_init, old apics need it before a startup
+/// @param apic_id 
+void lapic_send_init_deassert(uint8_t apic_id)
+{
+    lapic_send_command(apic_id, ICR_INIT | ICR_LEVEL_TRIGGER);
+}
+
+/// @brief starts a cpu in real mode at vector * 0x1000
+/// @param apic_id 
+/// @param vector the page of the trampoline
+void lapic_send_startup(uint8_t apic_id, uint8_t vector)
+{
+    lapic_send_command(apic_id, ICR_STARTUP | vector);
+}
+
+/// @brief sends a fixed interrupt to a cpu
+/// @param apic_id 
+/// @param vector 
+void lapic_send_ipi(uint8_t apic_id, uint8_t vector)
+{
+    lapic_send_command(apic_id, vector);
+}
+
+/// @brief measures the apic timer against the pit, needs interrupts on
+/// @param hz the rate lapic_timer_start should fire at
+void lapic_timer_calibrate(uint32_t hz)
+{
+    lapic_write(LAPIC_TIMER_DIVIDE, TIMER_DIVIDE_16);
+
+    // start on a tick edge so exactly 10 pit periods are measured
+    uint32_t start = get_ticks();
+    while (get_ticks() == start)
+        asm volatile("pause");
+    start = get_ticks();
+    lapic_write(LAPIC_TIMER_INITIAL, 0xFFFFFFFF);
+    while (get_ticks() - start < 10)
+        asm volatile("pause");
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+    lapic_write(LAPIC_TIMER_INITIAL, 0);
+
+    lapic_timer_count = (uint32_t) ((uint64_t) elapsed * TIMER_HZ / 10 / hz);
+}
+
+/// @brief starts the periodic scheduler tick on this cpu
+void lapic_timer_start(void)
+{
+    lapic_write(LAPIC_TIMER_DIVIDE, TIMER_DIVIDE_16);
+    lapic_write(LAPIC_LVT_TIMER, LVT_TIMER_PERIODIC | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INITIAL, lapic_timer_count);
+}
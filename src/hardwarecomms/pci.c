@@ -7,37 +7,6 @@ enum PCI_IO {
     PCI_CMD_PORT   = 0xCF8,
 };
 
-typedef enum BaseAddressRegisterType {
-    BAR_MEM_MAP = 0,
-    BAR_IO = 1,
-} bar_type_t;
-
-typedef struct pci_entry_desc {
-    uint16_t portBase;
-    uint16_t interrupt;
-
-    uint8_t bus;
-    uint8_t device;
-    uint8_t function;
-
-    uint16_t vendorID;
-    uint16_t deviceID;
-
-    uint8_t classID;
-    uint8_t subclassID;
-    uint8_t interfaceID;
-
-    uint8_t revision;
-
-} pci_entry_desc_t;
-
-typedef struct base_addrs_reg {
-    bool prefetchable;
-    uint8_t* addrs;
-    uint32_t size;
-    bar_type_t type;
-} bar_t;
-
 //reades a certain pci device
 uint32_t pci_read(uint8_t bus, uint8_t device, uint8_t function, uint8_t registeroffset)
 {
@@ -136,9 +105,11 @@ bar_t get_base_address_register(uint8_t bus, uint8_t device, uint8_t func, size_
     if (res.type == BAR_MEM_MAP) {
         switch ((barVal >> 1) & 0x3)
         {
-        case 0:
-        case 1:
-        case 2:
+        case 0: // 32 bit
+        case 1: // below 1mb
+        case 2: // 64 bit, only the low half is reachable here
+            res.addrs = (uint8_t*)(barVal & ~0xF);
+            res.prefetchable = barVal & 0x8;
             break;
         }
     } else {
@@ -176,4 +147,74 @@ void select_drivers()
     }
 }
 
+/// @brief scans the pci buses for a device
+/// @param match decides if an entry is the one looked for
+/// @param a passed to match
+/// @param b passed to match
+/// @param index how many matches to skip
+/// @param out gets the entry
+/// @return true if it was found
+bool pci_find(bool (*match)(pci_entry_desc_t*, uint16_t, uint16_t), uint16_t a, uint16_t b, uint32_t index, pci_entry_desc_t* out)
+{
+    for (size_t bus = 0; bus < 8; bus++)
+    {
+        for (size_t device = 0; device < 32; device++)
+        {
+            size_t func_count = device_has_funcs(bus, device)? 8 : 1;
+            for (size_t func = 0; func < func_count; func++)
+            {
+                pci_entry_desc_t entry = create_entry(bus, device, func);
+                if (entry.vendorID == 0x0000 || entry.vendorID == 0xFFFF)
+                    continue;
+                if (!match(&entry, a, b) || index-- > 0)
+                    continue;
+                *out = entry;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool match_class(pci_entry_desc_t* entry, uint16_t classID, uint16_t subclassID)
+{
+    return entry->classID == classID && entry->subclassID == subclassID;
+}
 
+bool match_device(pci_entry_desc_t* entry, uint16_t vendorID, uint16_t deviceID)
+{
+    return entry->vendorID == vendorID && entry->deviceID == deviceID;
+}
+
+/// @brief finds a device by what it is, like 0x01 0x01 for ide controllers
+/// @param classID 
+/// @param subclassID 
+/// @param index how many matches to skip
+/// @param out gets the entry
+/// @return true if it was found
+bool pci_find_class(uint8_t classID, uint8_t subclassID, uint32_t index, pci_entry_desc_t* out)
+{
+    return pci_find(match_class, classID, subclassID, index, out);
+}
+
+/// @brief finds a device by vendor and device id
+/// @param vendorID 
+/// @param deviceID 
+/// @param index how many matches to skip
+/// @param out gets the entry
+/// @return true if it was found
+bool pci_find_device(uint16_t vendorID, uint16_t deviceID, uint32_t index, pci_entry_desc_t* out)
+{
+    return pci_find(match_device, vendorID, deviceID, index, out);
+}
+
+/// @brief turns on bits of the command register, like decoding its bars or bus mastering
+/// @param entry 
+/// @param command PCI_COMMAND_ bits
+void pci_enable(pci_entry_desc_t* entry, uint16_t command)
+{
+    uint32_t reg = pci_read(entry->bus, entry->device, entry->function, 0x04);
+    // the upper half is the status register, its bits clear when written with 1
+    reg = (reg & 0xFFFF) | command;
+    pci_write(entry->bus, entry->device, entry->function, 0x04, reg);
+}
@@ -0,0 +1,90 @@
+#include <hardwarecomms/pit.h>
+#include <hardwarecomms/portio.h>
+#include <multitasking.h>
+#include <hardwarecomms/cpu.h>
+#include <timer.h>
+
+enum PIT_IO {
+    PIT_CHANNEL0_PORT = 0x40,
+    PIT_CMD_PORT = 0x43,
+};
+
+#define PIT_BASE_FREQ 1193182
+
+volatile uint32_t ticks = 0;
+uint32_t tsc_khz = 0; // tsc cycles per millisecond
+
+#define TSC_CALIBRATE_TICKS 50
+
+/// @brief programs channel 0 to fire irq0 at a fixed rate
+/// @param hz interrupts per second
+void pit_init(uint32_t hz)
+{
+    uint32_t divisor = PIT_BASE_FREQ / hz;
+    outb(PIT_CMD_PORT, 0x36); // channel 0, lobyte/hibyte, square wave
+    outb(PIT_CHANNEL0_PORT, divisor & 0xFF);
+    outb(PIT_CHANNEL0_PORT, (divisor >> 8) & 0xFF);
+}
+
+/// @brief irq0 callback
+void timer_interrupt(void)
+{
+    ticks++;
+    timer_tick();
+    scheduler_tick();
+}
+
+/// @brief returns the amount of timer interrupts since boot
+uint32_t get_ticks(void)
+{
+    return ticks;
+}
+
+/// @brief converts a duration to timer ticks, rounding up
+/// @param ns 
+uint32_t ns_to_ticks(uint64_t ns)
+{
+    return (uint32_t) ((ns * TIMER_HZ + 999999999ULL) / 1000000000ULL);
+}
+
+/// @brief busy waits, for early boot code that cant sleep, needs interrupts on
+/// @param ms 
+void timer_delay_ms(uint32_t ms)
+{
+    uint32_t start = ticks;
+    uint32_t wait = (ms * TIMER_HZ + 999) / 1000;
+    while (ticks - start < wait + 1)
+        asm volatile("pause");
+}
+
+/// @brief measures the tsc frequency against the pit, needs interrupts on
+void tsc_calibrate(void)
+{
+    // starts on a tick edge so whole pit periods are measured
+    uint32_t start = ticks;
+    while (ticks == start)
+        asm volatile("pause");
+    start = ticks;
+    uint64_t tsc_start = rdtsc();
+    while (ticks - start < TSC_CALIBRATE_TICKS)
+        asm volatile("pause");
+    uint64_t cycles = rdtsc() - tsc_start;
+
+    tsc_khz = (uint32_t) (cycles * TIMER_HZ / TSC_CALIBRATE_TICKS / 1000);
+}
+
+/// @brief returns the calibrated tsc frequency, 0 before tsc_calibrate
+uint32_t get_tsc_khz(void)
+{
+    return tsc_khz;
+}
+
+/// @brief converts tsc cycles to nanoseconds
+/// @param cycles 
+/// @return the nanoseconds, 0 before tsc_calibrate
+uint64_t cycles_to_ns(uint64_t cycles)
+{
+    if (tsc_khz == 0)
+        return 0;
+    return cycles * 1000000 / tsc_khz;
+}
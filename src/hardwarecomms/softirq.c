@@ -0,0 +1,80 @@
+#include <hardwarecomms/softirq.h>
+#include <hardwarecomms/cpu.h>
+#include <spinlock.h>
+#include <smp.h>
+
+// amount of times the pending list is drained per irq, bounds the time
+// spent in bottom halves if top halves keep rescheduling work
+#define MAX_SOFTIRQ_RESTART 10
+
+tasklet_t* pending_head = 0;
+tasklet_t* pending_tail = 0;
+spinlock_t pending_lock = SPINLOCK_INIT("tasklets");
+bool in_softirq[MAX_CPUS];
+
+/// @brief initializes a tasklet
+/// @param tasklet 
+/// @param func the function to run in the bottom half
+/// @param data passed to func
+void tasklet_init(tasklet_t* tasklet, void (*func)(uint32_t), uint32_t data)
+{
+    tasklet->func = func;
+    tasklet->data = data;
+    tasklet->scheduled = false;
+    tasklet->next = 0;
+}
+
+/// @brief queues a tasklet to run once interrupts are back on,
+/// scheduling an already pending tasklet does nothing
+/// @param tasklet 
+void tasklet_schedule(tasklet_t* tasklet)
+{
+    uint32_t flags = spin_lock_irqsave(&pending_lock);
+    if (!tasklet->scheduled) {
+        tasklet->scheduled = true;
+        tasklet->next = 0;
+        if (pending_tail)
+            pending_tail->next = tasklet;
+        else
+            pending_head = tasklet;
+        pending_tail = tasklet;
+    }
+    spin_unlock_irqrestore(&pending_lock, flags);
+}
+
+/// @brief runs pending tasklets with interrupts enabled,
+/// must be called with interrupts disabled, returns with them disabled
+void do_softirq(void)
+{
+    uint32_t cpu = cpu_id();
+    // an irq that arrived while we were running tasklets, its work is
+    // picked up by the loop below
+    if (in_softirq[cpu])
+        return;
+    in_softirq[cpu] = true;
+
+    for (int restart = 0; pending_head && restart < MAX_SOFTIRQ_RESTART; restart++)
+    {
+        spin_lock(&pending_lock);
+        tasklet_t* list = pending_head;
+        pending_head = pending_tail = 0;
+        spin_unlock(&pending_lock);
+
+        asm volatile("sti");
+        while (list) {
+            tasklet_t* tasklet = list;
+            list = tasklet->next;
+            tasklet->scheduled = false;
+            tasklet->func(tasklet->data);
+        }
+        asm volatile("cli");
+    }
+
+    in_softirq[cpu] = false;
+}
+
+/// @brief checks if this cpu is running tasklets right now
+bool softirq_active(void)
+{
+    return in_softirq[cpu_id()];
+}
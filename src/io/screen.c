@@ -1,6 +1,7 @@
 #include <io/screen.h>
 #include <common/tools.h>
 #include <common/str.h>
+#include <spinlock.h>
 static inline uint8_t vga_entry_color(enum vga_color fg, enum vga_color bg)
 {
     return fg | bg << 4;
@@ -17,8 +18,10 @@ size_t terminal_row;
 size_t terminal_column;
 uint8_t terminal_color;
 uint16_t* terminal_buffer;
+spinlock_t terminal_lock = SPINLOCK_INIT("terminal");
 
 void terminal_init(void) {
+    uint32_t flags = spin_lock_irqsave(&terminal_lock);
     terminal_row = 0;
     terminal_column = 0;
     terminal_color = vga_entry_color(COLOR_GREEN, COLOR_BLACK);
@@ -29,6 +32,7 @@ void terminal_init(void) {
             terminal_buffer[idx] = vga_entry(0, terminal_color);
         }
     }
+    spin_unlock_irqrestore(&terminal_lock, flags);
 }
 
 void terminal_set_color(uint8_t color)
@@ -75,8 +79,10 @@ void terminal_put_char(char c)
 
 void terminal_write(const char* data, size_t size)
 {
+    uint32_t flags = spin_lock_irqsave(&terminal_lock);
     for (size_t i = 0; i < size ; i++)
         terminal_put_char(data[i]);
+    spin_unlock_irqrestore(&terminal_lock, flags);
 }
 
 void terminal_write_string(const char* data)
@@ -93,6 +99,7 @@ void terminal_write_int(int i, int base)
 
 void terminal_rem(void)
 {
+    uint32_t flags = spin_lock_irqsave(&terminal_lock);
     if (terminal_column-- == 0) {
         terminal_column = VGA_WIDTH;
         if(terminal_row > 0) {
@@ -109,4 +116,5 @@ void terminal_rem(void)
         }
     }
     terminal_put_entry_at(0, terminal_color, terminal_column, terminal_row);
+    spin_unlock_irqrestore(&terminal_lock, flags);
 }
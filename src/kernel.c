@@ -8,12 +8,22 @@
 #include <hardwarecomms/pci.h>
 #include <memorymanagement.h>
 #include <drivers/ata.h>
+#include <drivers/blkqueue.h>
+#include <drivers/ahci.h>
+#include <drivers/virtioblk.h>
 #include <userinter/shell.h>
 #include <userinter/output.h>
 #include <stdout.h>
 #include <filesystem/msdospart.h>
 #include <filesystem/fat.h>
 #include <multitasking.h>
+#include <syscalls.h>
+#include <filesystem/fsring.h>
+#include <hardwarecomms/pit.h>
+#include <smp.h>
+#include <drivers/serial.h>
+#include <paging.h>
+#include <hardwarecomms/fpu.h>
 
 void boot_log(const char* msg, bool ok) {
     terminal_write_string("[INFO] ");
@@ -40,32 +50,109 @@ int kmain(void *mbd, unsigned int magic){
     }
     terminal_write_string("[BOOT] Multiboot header valid.\n");
 
+    boot_log("Initializing serial port...", serial_init());
+
     boot_log("Initializing GDT...", true);
     gdt_setup();
 
     boot_log("Setting up heap...", true);
     uint32_t* memupper = (uint32_t*)(((size_t)mbd) + 8);
     size_t heap = 10*1024*1024;
-    init_memory(heap, (*memupper)*1024 - heap - 10*1024);
+    size_t memory = (*memupper)*1024 - heap - 10*1024;
+    // only memory below the user window is mapped for the kernel
+    if (memory > USER_BASE - heap)
+        memory = USER_BASE - heap;
+    // half goes to the heap, the rest is handed out as page frames
+    init_memory(heap, memory / 2);
+
+    boot_log("Enabling paging...", paging_init(heap + memory / 2, memory - memory / 2));
 
     kb_init();
     boot_log("Initializing keyboard...", kb_self_test());
 
+    boot_log("Initializing multitasking...", true);
+    init_multitasking();
+
+    boot_log("Enabling fast syscalls...", true);
+    syscall_fast_init();
+
     boot_log("Initializing IDT...", true);
     idt_setup();
 
+    boot_log("Enabling FPU and SSE...", true);
+    fpu_init();
+
+    boot_log("Starting timer...", true);
+    pit_init(TIMER_HZ);
+
     boot_log("Enabling interrupts...", true);
     interrupts_activate();
 
-    boot_log("Initializing ATA device...", true);
+    boot_log("Calibrating TSC...", true);
+    tsc_calibrate();
+
+    smp_init();
+    boot_log("Starting application processors...", true);
+    terminal_write_string("[INFO] ");
+    terminal_write_int(cpu_count(), 10);
+    terminal_write_string(" cpu(s) online\n");
+
     ata_drive ataSlave = create_ata(false, 0x1F0);
-    identify(ataSlave);
+    boot_log("Initializing ATA device...", identify(&ataSlave));
+    if (ataSlave.identified) {
+        terminal_write_string("[INFO] ");
+        terminal_write_string(ataSlave.model);
+        terminal_write_string(", ");
+        terminal_write_int((int) (ataSlave.totalSectors / 2048), 10);
+        terminal_write_string(" MiB\n");
+        boot_log("Enabling IDE DMA...", ata_dma_init(&ataSlave));
+    }
+    block_device* disk = blk_queue_init(ataSlave);
+    boot_log("Starting block queue...", disk != 0);
+
+    boot_log("Initializing AHCI...", ahci_init());
+    for (int i = 0; i < ahci_disk_count(); i++)
+    {
+        ahci_port* port = ahci_get_disk(i);
+        terminal_write_string("[INFO] ");
+        terminal_write_string(port->model);
+        terminal_write_string(", ");
+        terminal_write_int((int) (port->sectors / 2048), 10);
+        terminal_write_string(" MiB, ncq depth ");
+        terminal_write_int(port->depth, 10);
+        terminal_write_string("\n");
+    }
+
+    boot_log("Initializing virtio block...", virtio_blk_init());
+    for (int i = 0; i < virtio_blk_disk_count(); i++)
+    {
+        virtio_blk* vb = virtio_blk_get_disk(i);
+        terminal_write_string("[INFO] virtio disk, ");
+        terminal_write_int((int) (vb->sectors / 2048), 10);
+        terminal_write_string(vb->indirect ? " MiB, indirect\n" : " MiB\n");
+    }
+    // machines without an ide disk boot from the first virtio one, then the first sata one
+    if (!disk && virtio_blk_disk_count() > 0)
+        disk = &virtio_blk_get_disk(0)->dev;
+    if (!disk && ahci_disk_count() > 0)
+        disk = &ahci_get_disk(0)->dev;
+
+    // the partitions and the shell all need a disk, without one there is nothing to start
+    boot_log("Finding a boot disk...", disk != 0);
+    if (!disk) {
+        terminal_write_string("[INFO] No disk found, halting\n");
+        while (true)
+            asm volatile("sti; hlt");
+    }
     
     boot_log("Loading partitions...", true);
-    partition_descr *part_descriptors = read_partitions(ataSlave);
+    partition_descr *part_descriptors = read_partitions(disk);
+
+    boot_log("Starting filesystem worker...", true);
+    fsring_init();
 
     boot_log("Starting shell...", true);
-    start_shell(ataSlave, part_descriptors);
+    start_shell(disk, part_descriptors);
     
 
     return 0;
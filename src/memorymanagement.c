@@ -1,4 +1,5 @@
 #include <memorymanagement.h>
+#include <spinlock.h>
 
 typedef struct MemoryChunck
 {
@@ -9,6 +10,7 @@ typedef struct MemoryChunck
 } MemoryChunck;
 
 MemoryChunck* first;
+spinlock_t heap_lock = SPINLOCK_INIT("heap");
 
 //initiates heap, start is the address of the start of the heap and size is the size of it
 void init_memory(size_t start, size_t size)
@@ -31,6 +33,7 @@ void init_memory(size_t start, size_t size)
 void* malloc(size_t size)
 {
     MemoryChunck *res = 0;
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
 
     for (MemoryChunck* c = first; c != 0 && res == 0; c = c->next)
     {
@@ -38,8 +41,10 @@ void* malloc(size_t size)
             res = c;
     }
 
-    if (res == 0)
+    if (res == 0) {
+        spin_unlock_irqrestore(&heap_lock, flags);
         return 0;
+    }
     
     //if there is enough memory, creates a new unallocated memory chunk after the one just alloctaed
     if (res->size >= size + sizeof(MemoryChunck) + 1) {
@@ -57,6 +62,7 @@ void* malloc(size_t size)
     }
     
     res->allocated = true;
+    spin_unlock_irqrestore(&heap_lock, flags);
     return (void*)(((size_t)res) + sizeof(MemoryChunck));
 }
 
@@ -74,6 +80,7 @@ void* calloc(size_t n, size_t size)
 void free(void* ptr)
 {
     MemoryChunck* chunk = ptr - sizeof(MemoryChunck);
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
 
     chunk->allocated = false;
     //if the chunk before was not allocated it merges both chuncks
@@ -93,4 +100,5 @@ void free(void* ptr)
         if (chunk->next != 0)
             chunk->next->perv = chunk;
     }
-}
\ No newline at end of file
+    spin_unlock_irqrestore(&heap_lock, flags);
+}
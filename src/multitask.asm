@@ -33,6 +33,10 @@ switch_context:
 
 global new_task_setup
 new_task_setup:
+	; let the previous task be picked up by other cpus
+	extern schedule_tail
+	call schedule_tail
+
 	; update the segment registers
 	pop ebx
 	mov ds, bx
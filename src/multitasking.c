@@ -2,8 +2,20 @@
 #include <common/types.h>
 #include <gdtdesc.h>
 #include <io/screen.h>
+#include <hardwarecomms/cpu.h>
+#include <hardwarecomms/pit.h>
+#include <memorymanagement.h>
+#include <smp.h>
+#include <spinlock.h>
+#include <paging.h>
+#include <hardwarecomms/fpu.h>
+#include <filesystem/fsring.h>
 #define MAX_TASKS 256
 #define KSTACK_SIZE 4096
+#define SLICE_TICKS_PER_LEVEL 5
+#define STARVATION_TICKS 100 // a task waiting this long runs even with higher priorities ready
+
+void task_return();
 
 /// @brief creates a new task
 /// @param callback a pointer to the function the task needs to exec
@@ -13,11 +25,27 @@ task_t create_task(uint32_t callback, uint32_t user_stack, uint32_t kernel_stack
     task_t task;
     
 
+    uint32_t* directory = kernel_directory;
+    if (!is_kernel_task) {
+        // without frames for its own directory the task still runs, just without a user window
+        uint32_t* own = address_space_create();
+        if (own)
+            directory = own;
+    }
+
 	if (!is_kernel_task) {
 		// we can pass things to the task by pushing to its user stack
 		// with cdecl, this will pass it as arguments
 		user_stack -= 4;
-		*(uint32_t*) user_stack = 0; // task func return address, shouldnt be used
+		uint32_t* slot = (uint32_t*) user_stack;
+		if (directory) {
+			// a stack in the user window is only reachable through the new directory
+			if (!paging_translate(directory, user_stack))
+				map_user_page(directory, user_stack, PAGE_USER | PAGE_WRITE);
+			slot = (uint32_t*) paging_translate(directory, user_stack);
+		}
+		if (slot)
+			*slot = 0; // task func return address, shouldnt be used
 	}
 
     uint32_t cs = is_kernel_task ? KERNEL_CS : (USER_CS | 3);
@@ -34,48 +62,847 @@ task_t create_task(uint32_t callback, uint32_t user_stack, uint32_t kernel_stack
     init_stack -> cs = cs;
     init_stack -> eflags = 0x200;
 
-    init_stack -> useresp = user_stack;
+    // a same ring iret leaves useresp on the stack, for kernel tasks
+    // it becomes the return address of the task function
+    init_stack -> useresp = is_kernel_task ? (uint32_t) task_return : user_stack;
     init_stack -> ss = ds;
 
     task.kstack = (uint32_t) kesp;
     task.kstack_bottom = kernel_stack;
+    task.page_directory = directory;
+    task.image = 0;
+    task.user = !is_kernel_task;
+    task.fpu_area = 0;
+    task.fpu_cpu = FPU_NO_CPU;
+    task.id = 0;
+    task.name = "task";
+    task.state = TASK_READY;
+    task.priority = TASK_PRIO_DEFAULT;
+    task.time_slice = 0;
+    task.cpu = 0;
+    task.on_cpu = false;
+    task.pinned = false;
+    task.next = 0;
+    task.wait_next = 0;
+    timer_init(&task.sleep_timer, 0, 0);
+    task.owned_memory = 0;
+    wait_queue_init(&task.exit_waiters);
+    task.user_cycles = task.kernel_cycles = 0;
+    task.cycle_stamp = task.last_run = task.wake_stamp = task.top_mark = 0;
+    task.voluntary_switches = task.involuntary_switches = 0;
     return task;
 }
 
 //initial taskManager values
 int numTasks = 0;
-int currentTask = -1;
-task_t* tasks[MAX_TASKS]; 
+uint32_t next_task_id = 0;
+task_t* tasks[MAX_TASKS]; // every live task, runnable or not
+task_t boot_task;
+task_t* dead_tasks = 0; // waiting for the reaper to free their memory
+spinlock_t tasks_lock = SPINLOCK_INIT("tasks");
+spinlock_t dead_lock = SPINLOCK_INIT("dead tasks");
+
+// the scheduler state of one cpu, one fifo per priority,
+// bit p of the bitmap is set while queue p isnt empty
+typedef struct {
+    spinlock_t lock;
+    task_t* head[NUM_PRIORITIES];
+    task_t* tail[NUM_PRIORITIES];
+    uint32_t bitmap;
+    volatile uint32_t nr_ready;
+    task_t* current;
+    task_t* idle; // runs when no queue has a ready task, never queued itself
+    task_t* prev; // the task switched away from, released by schedule_tail
+    volatile bool need_resched;
+    bool online;
+} runqueue_t;
+
+runqueue_t runqueues[MAX_CPUS];
+
+/// @brief the run queue of the running cpu, interrupts must be off so the task cant migrate
+static inline runqueue_t* this_rq()
+{
+    return &runqueues[cpu_id()];
+}
+
+/// @brief the time slice of a priority, higher priorities run longer
+/// @param priority 
+/// @return the slice in timer ticks
+static inline uint32_t slice_for(uint8_t priority)
+{
+    return (NUM_PRIORITIES - priority) * SLICE_TICKS_PER_LEVEL;
+}
+
+/// @brief puts a ready task at the end of its priority queue, rq lock held
+/// @param rq 
+/// @param task 
+void run_queue_push(runqueue_t* rq, task_t* task)
+{
+    task->next = 0;
+    task->cpu = rq - runqueues;
+    if (rq->tail[task->priority])
+        rq->tail[task->priority]->next = task;
+    else
+        rq->head[task->priority] = task;
+    rq->tail[task->priority] = task;
+    rq->bitmap |= 1 << task->priority;
+    rq->nr_ready++;
+    task->ready_tick = get_ticks();
+}
+
+/// @brief puts a preempted task back at the front of its priority queue,
+/// it goes on with the rest of its slice before the others get their turn, rq lock held
+/// @param rq 
+/// @param task 
+void run_queue_push_head(runqueue_t* rq, task_t* task)
+{
+    task->cpu = rq - runqueues;
+    task->next = rq->head[task->priority];
+    if (!task->next)
+        rq->tail[task->priority] = task;
+    rq->head[task->priority] = task;
+    rq->bitmap |= 1 << task->priority;
+    rq->nr_ready++;
+    task->ready_tick = get_ticks();
+}
+
+/// @brief takes the first task of the highest non empty priority queue, rq lock held.
+/// a lower queue whose first task has waited STARVATION_TICKS goes first once,
+/// so a busy high priority cant starve the rest
+/// @param rq 
+/// @return the task, 0 if nothing is ready
+task_t* run_queue_pop(runqueue_t* rq)
+{
+    if (!rq->bitmap)
+        return 0;
+    uint8_t priority = __builtin_ctz(rq->bitmap);
+    uint32_t now = get_ticks();
+    for (uint32_t lower = rq->bitmap & ~(1 << priority); lower; lower &= lower - 1)
+    {
+        uint8_t p = __builtin_ctz(lower);
+        if (now - rq->head[p]->ready_tick >= STARVATION_TICKS) {
+            priority = p;
+            break;
+        }
+    }
+
+    task_t* task = rq->head[priority];
+    rq->head[priority] = task->next;
+    if (!task->next) {
+        rq->tail[priority] = 0;
+        rq->bitmap &= ~(1 << priority);
+    }
+    task->next = 0;
+    rq->nr_ready--;
+    return task;
+}
+
+/// @brief takes a ready task from another cpu, the own rq lock is held so
+/// the others are only tried, never waited for
+/// @param rq the run queue of the stealing cpu
+/// @return the task, 0 if there was nothing to take
+task_t* steal_task(runqueue_t* rq)
+{
+    uint32_t self = rq - runqueues;
+    for (uint32_t i = 1; i < MAX_CPUS; i++)
+    {
+        runqueue_t* victim = &runqueues[(self + i) % MAX_CPUS];
+        if (!victim->online || victim->nr_ready == 0)
+            continue;
+        if (!spin_trylock(&victim->lock))
+            continue;
+        task_t* task = run_queue_pop(victim);
+        // a task still switching out over there stays, two cpus waiting
+        // on each others tasks would never finish
+        if (task && (task->on_cpu || task->pinned)) {
+            uint32_t ready_tick = task->ready_tick;
+            run_queue_push_head(victim, task);
+            task->ready_tick = ready_tick;
+            task = 0;
+        }
+        spin_unlock(&victim->lock);
+        if (task)
+            return task;
+    }
+    return 0;
+}
+
+/// @brief checks if another cpu has tasks waiting for their turn
+/// @return true if steal_task could find something
+bool work_to_steal()
+{
+    uint32_t self = cpu_id();
+    for (uint32_t i = 0; i < MAX_CPUS; i++)
+    {
+        if (i != self && runqueues[i].online && runqueues[i].nr_ready > 0)
+            return true;
+    }
+    return false;
+}
+
+/// @brief interrupts an idle cpu so it steals the new work
+void kick_idle_cpu()
+{
+    uint32_t self = cpu_id();
+    for (uint32_t i = 0; i < MAX_CPUS; i++)
+    {
+        if (i != self && runqueues[i].online && runqueues[i].current == runqueues[i].idle) {
+            smp_send_resched(i);
+            return;
+        }
+    }
+}
+
+/// @brief frees the memory of tasks that died and owned it,
+/// never runs on the stack it frees since a dead task doesnt run again
+void reap_dead_tasks()
+{
+    uint32_t flags = spin_lock_irqsave(&dead_lock);
+    task_t* list = dead_tasks;
+    dead_tasks = 0;
+    spin_unlock_irqrestore(&dead_lock, flags);
+
+    while (list) {
+        task_t* task = list;
+        list = task->next;
+        if (task->on_cpu) {
+            // still switching away from its stack on another cpu
+            flags = spin_lock_irqsave(&dead_lock);
+            task->next = dead_tasks;
+            dead_tasks = task;
+            spin_unlock_irqrestore(&dead_lock, flags);
+            continue;
+        }
+        free(task->owned_memory);
+    }
+}
+
+/// @brief the idle task, reaps dead tasks, takes work from busy cpus
+/// and halts until the next interrupt
+void idle_main()
+{
+    while (true) {
+        reap_dead_tasks();
+        if (work_to_steal())
+            task_yield();
+        asm volatile("sti; hlt");
+    }
+}
+
+/// @brief fills in a task for code that is already running on a cpu,
+/// its state gets filled in by the first switch away from it
+/// @param task 
+/// @param priority 
+/// @param cpu 
+void init_running_task(task_t* task, uint8_t priority, uint32_t cpu)
+{
+    // runs in ring 0 only, so it never needs tss.esp0
+    task->kstack = 0;
+    task->kstack_bottom = 0;
+    task->page_directory = kernel_directory;
+    task->image = 0;
+    task->user = false;
+    task->fpu_area = 0;
+    task->fpu_cpu = FPU_NO_CPU;
+    task->state = TASK_RUNNING;
+    task->priority = priority;
+    task->time_slice = slice_for(priority < NUM_PRIORITIES ? priority : NUM_PRIORITIES - 1);
+    task->cpu = cpu;
+    task->on_cpu = true;
+    task->pinned = false;
+    task->next = 0;
+    task->wait_next = 0;
+    timer_init(&task->sleep_timer, 0, 0);
+    task->owned_memory = 0;
+    wait_queue_init(&task->exit_waiters);
+    task->id = 0;
+    task->name = "task";
+    task->user_cycles = task->kernel_cycles = 0;
+    task->cycle_stamp = task->last_run = rdtsc();
+    task->wake_stamp = 0;
+    task->top_mark = 0;
+    task->voluntary_switches = task->involuntary_switches = 0;
+}
+
+/// @brief adds a task to the list of live tasks and gives it an id
+/// @param task 
+/// @return false if MAX_TASKS are alive
+bool register_task(task_t* task)
+{
+    uint32_t flags = spin_lock_irqsave(&tasks_lock);
+    if(numTasks >= MAX_TASKS) {
+        spin_unlock_irqrestore(&tasks_lock, flags);
+        return false;
+    }
+    task->id = next_task_id++;
+    tasks[numTasks++] = task;
+    spin_unlock_irqrestore(&tasks_lock, flags);
+    return true;
+}
+
+/// @brief registers the code that is currently running (kmain) as the first task
+void init_multitasking()
+{
+    runqueue_t* rq = &runqueues[0];
+    // runs the shell
+    spin_init(&rq->lock, "run queue");
+    init_running_task(&boot_task, TASK_PRIO_INTERACTIVE, 0);
+    boot_task.name = "shell";
+    register_task(&boot_task);
+    rq->current = &boot_task;
+
+    task_t* idle_task = spawn_kernel_task(idle_main, NUM_PRIORITIES - 1);
+    if (!idle_task) {
+        // schedule has nothing to fall back on without it
+        terminal_write_string("ERROR: no memory for the idle task\n");
+        while (true)
+            asm volatile("cli; hlt");
+    }
+    // below every real priority, so any wakeup preempts it
+    idle_task->priority = NUM_PRIORITIES;
+    idle_task->state = TASK_READY;
+    idle_task->name = "idle";
+    register_task(idle_task);
+    rq->idle = idle_task;
+    rq->online = true;
+}
+
+/// @brief registers the code running on a freshly started cpu as its idle task
+/// @param cpu 
+void init_cpu_scheduler(uint32_t cpu)
+{
+    runqueue_t* rq = &runqueues[cpu];
+    task_t* idle_task = (task_t*) malloc(sizeof(task_t));
+    if (!idle_task) {
+        // the cpu never checks in and smp_boot_ap parks it again
+        terminal_write_string("ERROR: no memory for an idle task\n");
+        while (true)
+            asm volatile("cli; hlt");
+    }
+    spin_init(&rq->lock, "run queue");
+    init_running_task(idle_task, NUM_PRIORITIES, cpu);
+    idle_task->name = "idle";
+    register_task(idle_task);
+    rq->current = rq->idle = idle_task;
+    rq->online = true;
+}
 
-/// @brief adds a task to tasks loop
+/// @brief adds a task to the scheduler and makes it ready
 /// @param task the task to be added
 /// @return true if successfully added, otherwise, false
 bool add_task(task_t* task)
 {
-    if(numTasks >= MAX_TASKS)
+    if (!register_task(task))
         return false;
-    tasks[numTasks++] = task;
+
+    uint32_t flags = irq_save();
+    runqueue_t* rq = this_rq();
+    spin_lock(&rq->lock);
+    task->state = TASK_READY;
+    task->time_slice = slice_for(task->priority);
+    run_queue_push(rq, task);
+    if (task->priority < rq->current->priority)
+        rq->need_resched = true;
+    spin_unlock(&rq->lock);
+
+    kick_idle_cpu();
+    irq_restore(flags);
     return true;
 }
 
-/// @brief Saves cpu state of current task and returns the state of the next task
-/// @param cpuState the current cpu state 
-/// @return the xpu state of the next task
+/// @brief checks if a task hasnt exited yet
+/// @param task 
+/// @return true if it is still registered
+bool is_task_alive(task_t* task)
+{
+    bool alive = false;
+    uint32_t flags = spin_lock_irqsave(&tasks_lock);
+    for (int i = 0; i < numTasks; i++)
+    {
+        if(tasks[i] == task) {
+            alive = true;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&tasks_lock, flags);
+    return alive;
+}
+
+/// @brief returns the running task
+task_t* get_current_task()
+{
+    uint32_t flags = irq_save();
+    task_t* task = this_rq()->current;
+    irq_restore(flags);
+    return task;
+}
+
+/// @brief changes the priority of a task that wasnt added yet or is the running one
+/// @param task 
+/// @param priority 0 (highest) to NUM_PRIORITIES - 1
+void set_task_priority(task_t* task, uint8_t priority)
+{
+    if (priority >= NUM_PRIORITIES)
+        priority = NUM_PRIORITIES - 1;
+    task->priority = priority;
+}
+
+/// @brief names a task for the top command
+/// @param task 
+/// @param name a string that lives as long as the task
+void set_task_name(task_t* task, const char* name)
+{
+    task->name = name;
+}
+
+/// @brief copies the live tasks for listing and starts a new measuring window
+/// @param out 
+/// @param max the size of out
+/// @return the amount of tasks copied
+int task_snapshot(task_info_t* out, int max)
+{
+    uint32_t flags = spin_lock_irqsave(&tasks_lock);
+    int count = 0;
+    for (int i = 0; i < numTasks && count < max; i++)
+    {
+        task_t* task = tasks[i];
+        uint64_t used = task->user_cycles + task->kernel_cycles;
+        // the running tasks havent been charged for their current stretch yet
+        if (task->state == TASK_RUNNING)
+            used += rdtsc() - task->cycle_stamp;
+
+        task_info_t* info = &out[count++];
+        info->id = task->id;
+        info->name = task->name;
+        info->state = task->state;
+        info->priority = task->priority;
+        info->cpu = task->cpu;
+        info->user_cycles = task->user_cycles;
+        info->kernel_cycles = task->kernel_cycles;
+        info->window_cycles = used - task->top_mark;
+        info->last_run = task->last_run;
+        info->voluntary_switches = task->voluntary_switches;
+        info->involuntary_switches = task->involuntary_switches;
+        task->top_mark = used;
+    }
+    spin_unlock_irqrestore(&tasks_lock, flags);
+    return count;
+}
+
+/// @brief charges the running task for the user mode stretch that just ended,
+/// called with interrupts disabled when an interrupt or syscall comes from ring 3
+void account_kernel_entry()
+{
+    task_t* current = this_rq()->current;
+    uint64_t now = rdtsc();
+    current->user_cycles += now - current->cycle_stamp;
+    current->cycle_stamp = now;
+}
+
+/// @brief charges the running task for the kernel stretch that just ended,
+/// called with interrupts disabled right before returning to ring 3
+void account_kernel_exit()
+{
+    task_t* current = this_rq()->current;
+    uint64_t now = rdtsc();
+    current->kernel_cycles += now - current->cycle_stamp;
+    current->cycle_stamp = now;
+}
+
+/// @brief releases the task this cpu just switched away from,
+/// runs first thing in the task that was switched to
+void schedule_tail()
+{
+    runqueue_t* rq = this_rq();
+    task_t* prev = rq->prev;
+    if (!prev)
+        return;
+    rq->prev = 0;
+
+    // a dead task's directory was loaded here until the switch, now nothing uses it
+    uint32_t* dead_directory = 0;
+    if (prev->state == TASK_DEAD) {
+        fpu_release(prev);
+        if (prev->page_directory != kernel_directory) {
+            dead_directory = prev->page_directory;
+            prev->page_directory = kernel_directory;
+        }
+    }
+    // the task may be freed from here on
+    prev->on_cpu = false;
+    address_space_destroy(dead_directory);
+}
+
+/// @brief switches to the highest priority ready task, must be called with interrupts disabled.
+/// a running task that used up its slice goes to the back of its queue, one preempted
+/// before that to the front, a blocked or dead one is left out.
+/// an empty queue takes work from another cpu before falling back to idle
 void schedule()
 {
-    if(numTasks <= 0)
+    runqueue_t* rq = this_rq();
+    task_t* old = rq->current;
+    rq->need_resched = false;
+
+    spin_lock(&rq->lock);
+    bool preempted = old->state == TASK_RUNNING;
+    if (preempted) {
+        old->state = TASK_READY;
+        if (old != rq->idle && old->time_slice)
+            run_queue_push_head(rq, old);
+        else if (old != rq->idle)
+            run_queue_push(rq, old);
+    }
+
+    task_t* next = run_queue_pop(rq);
+    if (!next)
+        next = steal_task(rq);
+    if (!next)
+        next = rq->idle;
+
+    next->state = TASK_RUNNING;
+    next->cpu = rq - runqueues;
+    if (next->time_slice == 0)
+        next->time_slice = slice_for(next->priority);
+    rq->current = next;
+    spin_unlock(&rq->lock);
+
+    if(next == old)
         return;
-    
-    task_t* old;
-    task_t* next;
 
-    if(currentTask >= 0)
-       old = tasks[currentTask];
-    
-    if(++currentTask >= numTasks)
-        currentTask %= numTasks;
-    
-    next = tasks[currentTask];
+    // schedule always runs in the kernel, the user part was charged on entry
+    uint64_t now = rdtsc();
+    old->kernel_cycles += now - old->cycle_stamp;
+    if (preempted)
+        old->involuntary_switches++;
+    else
+        old->voluntary_switches++;
+    next->cycle_stamp = next->last_run = now;
+
+    while (next->on_cpu)
+        asm volatile("pause");
+    next->on_cpu = true;
+    rq->prev = old;
     change_tss_esp0(next->kstack_bottom);
+    fpu_switch(old, next);
+    // kernel mappings are global, so only the user window leaves the tlb
+    if (next->page_directory != old->page_directory)
+        asm volatile("mov %0, %%cr3" : : "r" (next->page_directory) : "memory");
     switch_context(old, next);
-}
\ No newline at end of file
+    schedule_tail();
+}
+
+/// @brief charges the running task for a timer tick,
+/// called from irq0 on the boot cpu and the apic timer on the others
+void scheduler_tick()
+{
+    runqueue_t* rq = this_rq();
+    task_t* current = rq->current;
+    if (current == rq->idle)
+        return;
+    if (current->time_slice > 0)
+        current->time_slice--;
+    // an equal priority task is waiting for its turn
+    if (current->time_slice == 0)
+        rq->need_resched = true;
+}
+
+/// @brief preempts the running task if a tick or wakeup asked for it,
+/// called on the way out of an irq with interrupts disabled
+void schedule_if_needed()
+{
+    if (this_rq()->need_resched)
+        schedule();
+}
+
+/// @brief makes the next schedule_if_needed on this cpu switch tasks
+void request_resched()
+{
+    this_rq()->need_resched = true;
+}
+
+/// @brief gives up the rest of the time slice
+void task_yield()
+{
+    uint32_t flags = irq_save();
+    // an empty slice sends it to the back of its queue
+    this_rq()->current->time_slice = 0;
+    schedule();
+    irq_restore(flags);
+}
+
+/// @brief puts the running task to sleep until task_wake,
+/// must be called with interrupts disabled after checking the wait condition
+void task_block()
+{
+    this_rq()->current->state = TASK_BLOCKED;
+    schedule();
+}
+
+/// @brief makes a blocked task ready again on the cpu it last ran on, safe from irq context
+/// @param task 
+void task_wake(task_t* task)
+{
+    uint32_t flags = irq_save();
+    runqueue_t* rq;
+    // a blocked task doesnt move, the loop only matters if it was already woken
+    while (true) {
+        rq = &runqueues[task->cpu];
+        spin_lock(&rq->lock);
+        if (rq == &runqueues[task->cpu])
+            break;
+        spin_unlock(&rq->lock);
+    }
+
+    bool kick = false;
+    if (task->state == TASK_BLOCKED) {
+        task->wake_stamp = rdtsc();
+        if (rq->current == task) {
+            // it didnt get to switch away yet, so it just keeps running
+            task->state = TASK_RUNNING;
+        } else {
+            task->state = TASK_READY;
+            run_queue_push(rq, task);
+            if (task->priority < rq->current->priority) {
+                rq->need_resched = true;
+                kick = true;
+            }
+        }
+    }
+    spin_unlock(&rq->lock);
+
+    if (kick)
+        smp_send_resched(rq - runqueues);
+    irq_restore(flags);
+}
+
+/// @brief removes the running task from the scheduler and switches away from it.
+/// memory handed to the task (spawn_kernel_task) is freed by the reaper,
+/// otherwise it belongs to whoever created the task, see task_join
+void task_exit()
+{
+    // may sleep until the fsring worker lets go of the task's rings
+    fsring_release_task(get_current_task());
+
+    asm volatile("cli");
+    task_t* current = this_rq()->current;
+
+    spin_lock(&tasks_lock);
+    for (int i = 0; i < numTasks; i++)
+    {
+        if (tasks[i] == current) {
+            tasks[i] = tasks[--numTasks];
+            break;
+        }
+    }
+    spin_unlock(&tasks_lock);
+
+    current->state = TASK_DEAD;
+    wake_all(&current->exit_waiters);
+    if (current->owned_memory) {
+        spin_lock(&dead_lock);
+        current->next = dead_tasks;
+        dead_tasks = current;
+        spin_unlock(&dead_lock);
+    }
+    schedule();
+}
+
+/// @brief returns from a task function, ends the task
+void task_return()
+{
+    task_exit();
+}
+
+/// @brief creates and starts a kernel task, its stack and descriptor are freed when it exits
+/// @param func the function the task runs, returning from it ends the task
+/// @param priority 
+/// @return the task, 0 if out of memory or tasks
+task_t* spawn_kernel_task(void (*func)(), uint8_t priority)
+{
+    // the descriptor sits at the bottom of the block, under the stack
+    uint8_t* memory = (uint8_t*) malloc(sizeof(task_t) + KSTACK_SIZE);
+    if (!memory)
+        return 0;
+    task_t* task = (task_t*) memory;
+    uint32_t kernel_stack = (uint32_t) (memory + sizeof(task_t) + KSTACK_SIZE) & ~0xF;
+
+    *task = create_task((uint32_t) func, 0, kernel_stack, true);
+    task->owned_memory = memory;
+    set_task_priority(task, priority);
+    // the idle task is started by the scheduler, not the run queues
+    if (func != idle_main && !add_task(task)) {
+        free(memory);
+        return 0;
+    }
+    return task;
+}
+
+/// @brief lets a kernel task work on another task's behalf in that task's
+/// address space, its window faults in against the other task's program.
+/// the other task must not exit before the kernel task switches back
+/// @param owner 0 to go back to the kernel's address space
+void task_use_address_space(task_t* owner)
+{
+    task_t* task = get_current_task();
+    uint32_t flags = irq_save();
+    task->page_directory = owner ? owner->page_directory : kernel_directory;
+    task->image = owner ? owner->image : 0;
+    asm volatile("mov %0, %%cr3" : : "r" (task->page_directory) : "memory");
+    irq_restore(flags);
+}
+
+/// @brief waits for a task to exit, only for tasks whose memory the caller owns
+/// @param task 
+void task_join(task_t* task)
+{
+    uint32_t flags = irq_save();
+    wait_event(&task->exit_waiters, task->state == TASK_DEAD);
+    irq_restore(flags);
+    // the caller may free the stack once the task left it
+    while (task->on_cpu)
+        asm volatile("pause");
+}
+
+/// @brief timer callback of task_sleep
+/// @param data the sleeping task
+void sleep_timer_expired(uint32_t data)
+{
+    task_wake((task_t*) data);
+}
+
+/// @brief blocks the running task for at least the given time
+/// @param ns nanoseconds to sleep, rounded up to timer ticks
+void task_sleep(uint64_t ns)
+{
+    uint32_t sleep_ticks = ns_to_ticks(ns);
+    if (sleep_ticks == 0)
+        sleep_ticks = 1;
+
+    uint32_t flags = irq_save();
+    task_t* current = this_rq()->current;
+
+    // blocked before the timer is armed, an early expiry then just keeps it running
+    current->state = TASK_BLOCKED;
+    timer_init(&current->sleep_timer, sleep_timer_expired, (uint32_t) current);
+    timer_add(&current->sleep_timer, sleep_ticks);
+    schedule();
+    irq_restore(flags);
+}
+
+/// @brief timer callback of wait_event_timeout
+/// @param data the wait_timeout_t
+void wait_timeout_expired(uint32_t data)
+{
+    wait_timeout_t* timeout = (wait_timeout_t*) data;
+    timeout->expired = true;
+    task_wake(timeout->task);
+}
+
+/// @brief arms the timeout of a wait for the running task
+/// @param timeout 
+/// @param ticks 
+void wait_timeout_start(wait_timeout_t* timeout, uint32_t ticks)
+{
+    timeout->task = this_rq()->current;
+    timeout->expired = false;
+    timer_init(&timeout->timer, wait_timeout_expired, (uint32_t) timeout);
+    timer_add(&timeout->timer, ticks);
+}
+
+/// @brief disarms the timeout once the wait is over, a late expiry
+/// could otherwise wake the task out of its next wait
+/// @param timeout 
+void wait_timeout_stop(wait_timeout_t* timeout)
+{
+    timer_cancel_sync(&timeout->timer);
+}
+
+/// @brief initializes an empty wait queue
+/// @param queue 
+void wait_queue_init(wait_queue_t* queue)
+{
+    spin_init(&queue->lock, 0);
+    queue->head = queue->tail = 0;
+}
+
+/// @brief queues the running task and marks it blocked, see wait_event.
+/// must be called with interrupts disabled
+/// @param queue 
+void wait_queue_prepare(wait_queue_t* queue)
+{
+    task_t* current = this_rq()->current;
+    spin_lock(&queue->lock);
+    current->wait_next = 0;
+    if (queue->tail)
+        queue->tail->wait_next = current;
+    else
+        queue->head = current;
+    queue->tail = current;
+    current->state = TASK_BLOCKED;
+    spin_unlock(&queue->lock);
+}
+
+/// @brief undoes wait_queue_prepare when the condition came true before blocking
+/// @param queue 
+void wait_queue_finish(wait_queue_t* queue)
+{
+    runqueue_t* rq = this_rq();
+    task_t* current = rq->current;
+
+    spin_lock(&queue->lock);
+    task_t* prev = 0;
+    for (task_t* task = queue->head; task; prev = task, task = task->wait_next)
+    {
+        if (task != current)
+            continue;
+        if (prev)
+            prev->wait_next = task->wait_next;
+        else
+            queue->head = task->wait_next;
+        if (queue->tail == task)
+            queue->tail = prev;
+        break;
+    }
+    current->wait_next = 0;
+    spin_unlock(&queue->lock);
+
+    // a waker that got here first already set it running
+    spin_lock(&rq->lock);
+    current->state = TASK_RUNNING;
+    spin_unlock(&rq->lock);
+}
+
+/// @brief wakes the task that waited the longest, safe from irq context
+/// @param queue 
+void wake_one(wait_queue_t* queue)
+{
+    uint32_t flags = spin_lock_irqsave(&queue->lock);
+    task_t* task = queue->head;
+    if (task) {
+        queue->head = task->wait_next;
+        if (!queue->head)
+            queue->tail = 0;
+        task->wait_next = 0;
+    }
+    spin_unlock(&queue->lock);
+    if (task)
+        task_wake(task);
+    irq_restore(flags);
+}
+
+/// @brief wakes every task on a queue, safe from irq context
+/// @param queue 
+void wake_all(wait_queue_t* queue)
+{
+    uint32_t flags = spin_lock_irqsave(&queue->lock);
+    task_t* task = queue->head;
+    queue->head = queue->tail = 0;
+    spin_unlock(&queue->lock);
+    while (task) {
+        task_t* next = task->wait_next;
+        task->wait_next = 0;
+        task_wake(task);
+        task = next;
+    }
+    irq_restore(flags);
+}
@@ -0,0 +1,388 @@
+#include <paging.h>
+#include <hardwarecomms/cpu.h>
+#include <common/tools.h>
+#include <spinlock.h>
+#include <multitasking.h>
+#include <elf.h>
+#include <io/screen.h>
+#include <hardwarecomms/isr.h>
+
+#define PDE_INDEX(addr) ((addr) >> 22)
+#define PTE_INDEX(addr) (((addr) >> 12) & 0x3FF)
+#define FRAME_MASK 0xFFFFF000
+
+#define CPUID_PSE (1 << 3)
+#define CPUID_PGE (1 << 13)
+#define CR4_PSE 0x10
+#define CR4_PGE 0x80
+#define CR0_WP 0x10000
+#define CR0_PG 0x80000000
+
+// from the linker script
+extern char code[], rodata_end[], user_data[], user_data_end[], end[];
+
+uint32_t* kernel_directory = 0;
+bool paging_enabled = false;
+uint32_t cr4_features = 0; // the cr4 bits every cpu turns on
+
+// frames are handed out from the region once and recycled through a stack,
+// a free frame holds the address of the next one
+uint32_t frames_next = 0;
+uint32_t frames_end = 0;
+uint32_t free_frames = 0;
+spinlock_t frame_lock = SPINLOCK_INIT("frames");
+
+/// @brief loads a page directory
+static inline void write_cr3(uint32_t* directory)
+{
+    asm volatile("mov %0, %%cr3" : : "r" (directory) : "memory");
+}
+
+/// @brief flushes one page from the tlb of this cpu
+static inline void invlpg(uint32_t virt)
+{
+    asm volatile("invlpg (%0)" : : "r" (virt) : "memory");
+}
+
+/// @brief takes a physical frame
+/// @return its address, 0 if none are left
+uint32_t frame_alloc(void)
+{
+    uint32_t frame = 0;
+    uint32_t flags = spin_lock_irqsave(&frame_lock);
+    if (free_frames) {
+        frame = free_frames;
+        free_frames = *(uint32_t*) frame;
+    } else if (frames_next < frames_end) {
+        frame = frames_next;
+        frames_next += PAGE_SIZE;
+    }
+    spin_unlock_irqrestore(&frame_lock, flags);
+    return frame;
+}
+
+/// @brief gives a frame back
+/// @param frame 
+void frame_free(uint32_t frame)
+{
+    uint32_t flags = spin_lock_irqsave(&frame_lock);
+    *(uint32_t*) frame = free_frames;
+    free_frames = frame;
+    spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/// @brief takes a frame and zeroes it
+/// @return its address, 0 if none are left
+uint32_t frame_alloc_zeroed(void)
+{
+    uint32_t frame = frame_alloc();
+    if (frame)
+        memset((unsigned char*) frame, 0, PAGE_SIZE);
+    return frame;
+}
+
+/// @brief vector 14, pages in programs and their stacks, ends a user task
+/// that touched memory it doesnt have and halts on a kernel fault
+/// @param regs 
+void page_fault_handler(registers_t* regs)
+{
+    uint32_t addr;
+    asm volatile("mov %%cr2, %0" : "=r" (addr));
+    task_t* task = get_current_task();
+
+    // faults from the kernel too, a syscall may touch a page the task hasnt yet
+    if (!(regs->err_code & PAGE_PRESENT) && elf_handle_fault(task, addr))
+        return;
+
+    terminal_write_string("Page fault at ");
+    terminal_write_int(addr, 16);
+    terminal_write_string(" eip ");
+    terminal_write_int(regs->eip, 16);
+    terminal_write_string(" error ");
+    terminal_write_int(regs->err_code, 16);
+    terminal_write_string("\n");
+    if ((regs->cs & 3) == 3)
+        task_exit();
+
+    while (true)
+        asm volatile("cli; hlt");
+}
+
+/// @brief builds the kernel directory and turns paging on for the boot cpu
+/// @param frames_start the memory page tables and user pages come from
+/// @param frames_size 
+/// @return false if the cpu cant do 4mb pages, paging then stays off
+bool paging_init(size_t frames_start, size_t frames_size)
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_PSE))
+        return false;
+    cr4_features = CR4_PSE;
+    uint32_t global = 0;
+    if (edx & CPUID_PGE) {
+        cr4_features |= CR4_PGE;
+        global = PAGE_GLOBAL;
+    }
+
+    frames_next = (frames_start + PAGE_SIZE - 1) & FRAME_MASK;
+    frames_end = (frames_start + frames_size) & FRAME_MASK;
+
+    kernel_directory = (uint32_t*) frame_alloc_zeroed();
+    if (!kernel_directory)
+        return false;
+
+    for (uint32_t addr = 0; addr < USER_BASE; addr += LARGE_PAGE_SIZE)
+    {
+        if (addr >= (uint32_t) end) {
+            kernel_directory[PDE_INDEX(addr)] = addr | PAGE_PRESENT | PAGE_WRITE | PAGE_LARGE | global;
+            continue;
+        }
+
+        // the kernel image gets small pages, the ring 3 code in it (sysbench)
+        // reads its code and constants and writes its .user data
+        uint32_t* table = (uint32_t*) frame_alloc_zeroed();
+        if (!table)
+            return false;
+        for (int pte = 0; pte < 1024; pte++)
+        {
+            uint32_t page = addr + pte * PAGE_SIZE;
+            uint32_t flags = PAGE_PRESENT | PAGE_WRITE | global;
+            if (page + PAGE_SIZE > (uint32_t) code && page < (uint32_t) rodata_end)
+                flags = PAGE_PRESENT | PAGE_USER | global;
+            else if (page >= (uint32_t) user_data && page < (uint32_t) user_data_end)
+                flags |= PAGE_USER;
+            table[pte] = page | flags;
+        }
+        // the table decides, the directory entry has to let user pages through
+        kernel_directory[PDE_INDEX(addr)] = (uint32_t) table | PAGE_PRESENT | PAGE_WRITE | PAGE_USER;
+    }
+    // the local apics, io apics and pci bars
+    for (uint32_t addr = USER_TOP; addr != 0; addr += LARGE_PAGE_SIZE)
+        kernel_directory[PDE_INDEX(addr)] = addr | PAGE_PRESENT | PAGE_WRITE | PAGE_NOCACHE | PAGE_WRITETHROUGH | PAGE_LARGE | global;
+
+    register_interrupt_handler(14, page_fault_handler);
+    paging_enable_cpu();
+    paging_enabled = true;
+    return true;
+}
+
+/// @brief turns paging on for the running cpu with the kernel directory
+void paging_enable_cpu(void)
+{
+    if (!kernel_directory)
+        return;
+
+    uint32_t cr4, cr0;
+    asm volatile("mov %%cr4, %0" : "=r" (cr4));
+    asm volatile("mov %0, %%cr4" : : "r" (cr4 | cr4_features));
+    write_cr3(kernel_directory);
+    asm volatile("mov %%cr0, %0" : "=r" (cr0));
+    // wp makes read only user pages read only for the kernel too
+    asm volatile("mov %0, %%cr0" : : "r" (cr0 | CR0_PG | CR0_WP) : "memory");
+}
+
+/// @brief creates a directory sharing the kernel mappings with an empty user window
+/// @return the directory, 0 if out of frames or paging is off
+uint32_t* address_space_create(void)
+{
+    if (!paging_enabled)
+        return 0;
+    uint32_t* directory = (uint32_t*) frame_alloc();
+    if (!directory)
+        return 0;
+    memcpy(directory, kernel_directory, PAGE_SIZE);
+    return directory;
+}
+
+/// @brief frees a directory with its page tables and every page in its user window,
+/// must not be loaded on any cpu
+/// @param directory 
+void address_space_destroy(uint32_t* directory)
+{
+    if (!directory || directory == kernel_directory)
+        return;
+
+    for (uint32_t pde = PDE_INDEX(USER_BASE); pde < PDE_INDEX(USER_TOP); pde++)
+    {
+        if (!(directory[pde] & PAGE_PRESENT))
+            continue;
+        uint32_t* table = (uint32_t*) (directory[pde] & FRAME_MASK);
+        for (int pte = 0; pte < 1024; pte++)
+        {
+            if (table[pte] & PAGE_PRESENT)
+                frame_free(table[pte] & FRAME_MASK);
+        }
+        frame_free((uint32_t) table);
+    }
+    frame_free((uint32_t) directory);
+}
+
+/// @brief finds the page table entry of a user window address
+/// @param directory 
+/// @param virt 
+/// @param create whether to add a missing page table
+/// @return the entry, 0 if there is no table or virt is outside the window
+uint32_t* find_pte(uint32_t* directory, uint32_t virt, bool create)
+{
+    if (virt < USER_BASE || virt >= USER_TOP)
+        return 0;
+
+    uint32_t* pde = &directory[PDE_INDEX(virt)];
+    if (!(*pde & PAGE_PRESENT)) {
+        if (!create)
+            return 0;
+        uint32_t table = frame_alloc_zeroed();
+        if (!table)
+            return 0;
+        // the page entries decide the actual access
+        *pde = table | PAGE_PRESENT | PAGE_WRITE | PAGE_USER;
+    }
+    return &((uint32_t*) (*pde & FRAME_MASK))[PTE_INDEX(virt)];
+}
+
+/// @brief maps a page in the user window of an address space
+/// @param directory 
+/// @param virt page aligned address between USER_BASE and USER_TOP
+/// @param phys page aligned frame
+/// @param flags PAGE_WRITE and PAGE_USER as needed
+/// @return false if virt is outside the window or a page table couldnt be allocated
+bool paging_map(uint32_t* directory, uint32_t virt, uint32_t phys, uint32_t flags)
+{
+    uint32_t* pte = find_pte(directory, virt, true);
+    if (!pte)
+        return false;
+    *pte = (phys & FRAME_MASK) | (flags & 0xFFF) | PAGE_PRESENT;
+    invlpg(virt);
+    return true;
+}
+
+/// @brief removes a page from the user window, the frame stays with the caller
+/// @param directory 
+/// @param virt 
+/// @return the frame it mapped, 0 if it wasnt mapped
+uint32_t paging_unmap(uint32_t* directory, uint32_t virt)
+{
+    uint32_t* pte = find_pte(directory, virt, false);
+    if (!pte || !(*pte & PAGE_PRESENT))
+        return 0;
+    uint32_t frame = *pte & FRAME_MASK;
+    *pte = 0;
+    // other cpus only ever load the directory of the task running here
+    invlpg(virt);
+    return frame;
+}
+
+/// @brief looks up the physical address behind a virtual one
+/// @param directory 
+/// @param virt 
+/// @return the physical address, 0 if it isnt mapped
+uint32_t paging_translate(uint32_t* directory, uint32_t virt)
+{
+    if (virt < USER_BASE || virt >= USER_TOP)
+        return (directory[PDE_INDEX(virt)] & PAGE_PRESENT) ? virt : 0;
+    uint32_t* pte = find_pte(directory, virt, false);
+    if (!pte || !(*pte & PAGE_PRESENT))
+        return 0;
+    return (*pte & FRAME_MASK) | (virt & ~FRAME_MASK);
+}
+
+/// @brief the physical address of memory in an address space, for dma
+/// set up by a task other than the one the memory belongs to
+/// @param directory 0 for the running task's
+/// @param addr 
+/// @return the physical address, 0 if it isnt mapped
+uint32_t virt_to_phys_in(uint32_t* directory, const void* addr)
+{
+    if (!paging_enabled)
+        return (uint32_t) addr;
+    return paging_translate(directory ? directory : get_current_task()->page_directory, (uint32_t) addr);
+}
+
+/// @brief the physical address of memory the running task can see, for dma
+/// @param addr 
+/// @return the physical address, 0 if it isnt mapped
+uint32_t virt_to_phys(const void* addr)
+{
+    return virt_to_phys_in(0, addr);
+}
+
+/// @brief checks that a task could reach memory from user mode itself, for
+/// pointers it hands the kernel. pages of its program it hasnt touched yet are paged in
+/// @param task 
+/// @param addr 
+/// @param len 
+/// @param write whether the kernel will write it
+/// @return false if part of it isnt in the task's window or is read only
+bool user_range_ok(task_t* task, const void* addr, uint32_t len, bool write)
+{
+    uint32_t start = (uint32_t) addr;
+    if (start < USER_BASE || start >= USER_TOP || len > USER_TOP - start)
+        return false;
+
+    for (uint32_t page = start & FRAME_MASK; page < start + len; page += PAGE_SIZE)
+    {
+        uint32_t* pte = find_pte(task->page_directory, page, false);
+        if (!pte || !(*pte & PAGE_PRESENT)) {
+            if (!elf_handle_fault(task, page))
+                return false;
+            pte = find_pte(task->page_directory, page, false);
+        }
+        if (!(*pte & PAGE_USER) || (write && !(*pte & PAGE_WRITE)))
+            return false;
+    }
+    return true;
+}
+
+/// @brief checks a string a task hands the kernel like user_range_ok, up to its end
+/// @param task 
+/// @param str 
+/// @param max the longest the string may be, with its terminator
+/// @return false if it isnt the task's or doesnt end within max
+bool user_string_ok(task_t* task, const char* str, uint32_t max)
+{
+    const char* byte = 0;
+    for (uint32_t i = 0; i < max; i++)
+    {
+        uint32_t addr = (uint32_t) str + i;
+        if (i == 0 || !(addr & ~FRAME_MASK)) {
+            if (!user_range_ok(task, (const void*) addr, 1, false))
+                return false;
+            // read through the 1:1 map, the window may be another directory's
+            byte = (const char*) paging_translate(task->page_directory, addr);
+        }
+        if (!*byte++)
+            return true;
+    }
+    return false;
+}
+
+/// @brief backs a user window page with a new zeroed frame
+/// @param directory 
+/// @param virt 
+/// @param flags 
+/// @return false if out of frames
+bool map_user_page(uint32_t* directory, uint32_t virt, uint32_t flags)
+{
+    uint32_t frame = frame_alloc_zeroed();
+    if (!frame)
+        return false;
+    if (!paging_map(directory, virt & FRAME_MASK, frame, flags)) {
+        frame_free(frame);
+        return false;
+    }
+    return true;
+}
+
+/// @brief gives the kernel an uncached pointer to device registers
+/// @param phys 
+/// @param size 
+/// @return the pointer, 0 if the range falls into the user window
+void* map_mmio(uint32_t phys, size_t size)
+{
+    // devices above USER_TOP are mapped uncached at boot, below USER_BASE
+    // the mtrrs mark device ranges uncacheable
+    if (phys + size > USER_BASE && phys < USER_TOP)
+        return 0;
+    return (void*) phys;
+}
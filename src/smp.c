@@ -0,0 +1,175 @@
+#include <smp.h>
+#include <common/tools.h>
+#include <hardwarecomms/acpi.h>
+#include <hardwarecomms/lapic.h>
+#include <hardwarecomms/isr.h>
+#include <hardwarecomms/idtdesc.h>
+#include <hardwarecomms/pit.h>
+#include <hardwarecomms/softirq.h>
+#include <io/screen.h>
+#include <memorymanagement.h>
+#include <multitasking.h>
+#include <syscalls.h>
+#include <paging.h>
+#include <hardwarecomms/fpu.h>
+
+#define TRAMPOLINE_BASE 0x8000 // must match trampoline.asm
+#define AP_STACK_SIZE 4096
+
+extern uint8_t trampoline_start[];
+extern uint8_t trampoline_end[];
+extern uint32_t trampoline_stack;
+extern uint32_t trampoline_entry;
+
+cpu_info_t cpus[MAX_CPUS];
+uint32_t num_cpus = 1;
+volatile uint32_t booting_cpu = 0;
+volatile bool ap_started = false;
+
+/// @brief finds a trampoline variable in the copy at TRAMPOLINE_BASE
+/// @param var the variable in the linked image
+/// @return its address in the copy
+static inline uint32_t* trampoline_var(uint32_t* var)
+{
+    return (uint32_t*) (TRAMPOLINE_BASE + ((uint8_t*) var - trampoline_start));
+}
+
+/// @brief the apic timer of an application processor, drives its time slices
+/// @param regs 
+void smp_timer_interrupt(registers_t* regs)
+{
+    (void) regs;
+    lapic_eoi();
+    scheduler_tick();
+    // bottom halves are only raised and run by the pic irqs of the boot cpu
+    if (!softirq_active())
+        schedule_if_needed();
+}
+
+/// @brief sent by another cpu that queued a task here
+/// @param regs 
+void smp_resched_interrupt(registers_t* regs)
+{
+    (void) regs;
+    lapic_eoi();
+    request_resched();
+    if (!softirq_active())
+        schedule_if_needed();
+}
+
+void smp_spurious_interrupt(registers_t* regs)
+{
+    (void) regs;
+}
+
+/// @brief the c entry of an application processor, runs on the stack from smp_boot_ap
+/// and becomes the idle task of the cpu
+void ap_main()
+{
+    uint32_t cpu = booting_cpu;
+    paging_enable_cpu();
+    gdt_load_cpu(cpu);
+    idt_load();
+    syscall_fast_init();
+    fpu_init();
+    lapic_enable();
+    init_cpu_scheduler(cpu);
+
+    cpus[cpu].online = true;
+    ap_started = true;
+
+    lapic_timer_start();
+    idle_main();
+}
+
+/// @brief starts one application processor with init, startup, startup
+/// @param cpu the index it gets
+/// @param apic_id 
+/// @return true if it reached ap_main
+bool smp_boot_ap(uint32_t cpu, uint8_t apic_id)
+{
+    uint8_t* stack = (uint8_t*) malloc(AP_STACK_SIZE);
+    if (!stack)
+        return false;
+
+    *trampoline_var(&trampoline_stack) = (uint32_t) (stack + AP_STACK_SIZE) & ~0xF;
+    *trampoline_var(&trampoline_entry) = (uint32_t) ap_main;
+    cpus[cpu].apic_id = apic_id;
+    booting_cpu = cpu;
+    ap_started = false;
+
+    lapic_send_init(apic_id);
+    lapic_send_init_deassert(apic_id);
+    timer_delay_ms(10);
+    lapic_send_startup(apic_id, TRAMPOLINE_BASE >> 12);
+    timer_delay_ms(1);
+    if (!ap_started)
+        lapic_send_startup(apic_id, TRAMPOLINE_BASE >> 12);
+
+    for (int i = 0; i < 100 && !ap_started; i++)
+        timer_delay_ms(1);
+    if (ap_started)
+        return true;
+
+    // put the cpu back into wait-for-sipi so it cant show up on the stack later
+    lapic_send_init(apic_id);
+    lapic_send_init_deassert(apic_id);
+    free(stack);
+    return false;
+}
+
+/// @brief starts every enabled cpu in the madt, needs interrupts and the pit running
+void smp_init(void)
+{
+    cpus[0].online = true;
+
+    acpi_madt* madt = (acpi_madt*) acpi_find_table("APIC");
+    if (!madt)
+        return;
+
+    lapic_init(madt->lapicAddress);
+    lapic_enable();
+    cpus[0].apic_id = lapic_id();
+    register_interrupt_handler(LAPIC_TIMER_VECTOR, smp_timer_interrupt);
+    register_interrupt_handler(RESCHED_VECTOR, smp_resched_interrupt);
+    register_interrupt_handler(LAPIC_SPURIOUS_VECTOR, smp_spurious_interrupt);
+    lapic_timer_calibrate(TIMER_HZ);
+
+    memcpy((void*) TRAMPOLINE_BASE, trampoline_start, trampoline_end - trampoline_start);
+
+    uint8_t* entry = (uint8_t*) (madt + 1);
+    uint8_t* end = (uint8_t*) madt + madt->header.length;
+    while (entry < end && num_cpus < MAX_CPUS)
+    {
+        madt_entry_header* header = (madt_entry_header*) entry;
+        if (header->length == 0)
+            break;
+        if (header->type == MADT_ENTRY_LAPIC) {
+            madt_lapic_entry* lapic_entry = (madt_lapic_entry*) entry;
+            if ((lapic_entry->flags & 1) && lapic_entry->apicId != cpus[0].apic_id) {
+                if (smp_boot_ap(num_cpus, lapic_entry->apicId)) {
+                    num_cpus++;
+                } else {
+                    terminal_write_string("cpu with apic id ");
+                    terminal_write_int(lapic_entry->apicId, 10);
+                    terminal_write_string(" didnt start\n");
+                }
+            }
+        }
+        entry += header->length;
+    }
+}
+
+/// @brief returns the amount of running cpus
+uint32_t cpu_count(void)
+{
+    return num_cpus;
+}
+
+/// @brief makes another cpu run its scheduler
+/// @param cpu 
+void smp_send_resched(uint32_t cpu)
+{
+    if (cpu != cpu_id() && cpus[cpu].online)
+        lapic_send_ipi(cpus[cpu].apic_id, RESCHED_VECTOR);
+}
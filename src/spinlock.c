@@ -0,0 +1,50 @@
+#include <spinlock.h>
+
+lock_stats_t* registered_locks = 0;
+
+/// @brief initializes an unlocked spinlock
+/// @param lock 
+/// @param name shown by the locks command, 0 to leave it out
+void spin_init(spinlock_t* lock, const char* name)
+{
+    lock->ticket = 0;
+    lock->stats.name = name;
+    lock->stats.registered = 0;
+    lock->stats.acquisitions = 0;
+    lock->stats.contended = 0;
+    lock->stats.wait_cycles = 0;
+    lock->stats.next = 0;
+}
+
+/// @brief waits for our ticket to come up, kept out of line so the
+/// uncontended path stays a single locked add
+/// @param lock 
+/// @param ticket 
+void spin_lock_contended(spinlock_t* lock, uint16_t ticket)
+{
+    uint64_t start = rdtsc();
+    while (lock->half.owner != ticket)
+        asm volatile("pause");
+    // the lock is ours now, so the counters are too
+    lock->stats.contended++;
+    lock->stats.wait_cycles += rdtsc() - start;
+}
+
+/// @brief adds a lock to the list shown by the locks command, once
+/// @param stats 
+void lock_stats_register(lock_stats_t* stats)
+{
+    if (!__sync_bool_compare_and_swap(&stats->registered, 0, 1))
+        return;
+    lock_stats_t* head;
+    do {
+        head = registered_locks;
+        stats->next = head;
+    } while (!__sync_bool_compare_and_swap(&registered_locks, head, stats));
+}
+
+/// @brief the named locks that were taken at least once, linked by next
+lock_stats_t* lock_stats_first(void)
+{
+    return registered_locks;
+}
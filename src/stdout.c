@@ -1,11 +1,14 @@
 #include <stdout.h>
 #include <common/str.h>
-#include <memorymanagement.h>
 #include <io/screen.h>
+#include <spinlock.h>
 stdout_desc stdout;
+spinlock_t stdout_lock = SPINLOCK_INIT("stdout");
 /// @brief sets stdout to terminal
 void set_stdout_to_terminal() {
+    uint32_t flags = spin_lock_irqsave(&stdout_lock);
     stdout.mode = STDOUT_SCREEN;
+    spin_unlock_irqrestore(&stdout_lock, flags);
 }
 
 /// @brief sets stdout to file type
@@ -14,27 +17,49 @@ void set_stdout_to_terminal() {
 /// @param part_desc 
 /// @param hd 
 /// @param rewrite to rewrite file or add to it
-void set_stdout_to_file(char* dirPath, char* fileName, partition_descr* part_desc, ata_drive hd, bool rewrite) {
+void set_stdout_to_file(char* dirPath, char* fileName, partition_descr* part_desc, block_device* hd, bool rewrite) {
+    if (strlen(dirPath) >= STDOUT_PATH_MAX || strlen(fileName) >= STDOUT_NAME_MAX) {
+        terminal_write_string("name too long");
+        return;
+    }
+    // the lookup goes to disk, so it is done before taking the lock
     if (is_file_exist(hd, dirPath, fileName, part_desc)) {
-        free(stdout.dirPath);
-        free(stdout.fileName);
-        
+        uint32_t flags = spin_lock_irqsave(&stdout_lock);
         stdout.mode = STDOUT_FILE;
-        stdout.dirPath = (char*) malloc(strlen(dirPath) + 1);
         strcpy(stdout.dirPath, dirPath);
-        stdout.fileName = (char*) malloc(strlen(fileName) + 1);
         strcpy(stdout.fileName, fileName);
         stdout.part_desc = part_desc;
         stdout.hd = hd;
         stdout.rewrite = rewrite;
+        spin_unlock_irqrestore(&stdout_lock, flags);
     } else {
         terminal_write_string("no such file or directory");
     }
 }
 
 void set_stdout_rewrite(bool rewrite) {
+    uint32_t flags = spin_lock_irqsave(&stdout_lock);
     stdout.rewrite = rewrite;
+    spin_unlock_irqrestore(&stdout_lock, flags);
 }
 stdout_desc get_stdout() {
-    return stdout;
+    uint32_t flags = spin_lock_irqsave(&stdout_lock);
+    stdout_desc current = stdout;
+    spin_unlock_irqrestore(&stdout_lock, flags);
+    return current;
+}
+
+/// @brief gets stdout for a write, a rewriting file switches to append
+/// so only the first write of a redirection truncates it
+/// @param out filled with stdout as it was before the write, only for a file
+/// @return the mode, screen writes dont need the rest
+stdout_mode get_stdout_for_write(stdout_desc* out) {
+    uint32_t flags = spin_lock_irqsave(&stdout_lock);
+    stdout_mode mode = stdout.mode;
+    if (mode == STDOUT_FILE) {
+        *out = stdout;
+        stdout.rewrite = false;
+    }
+    spin_unlock_irqrestore(&stdout_lock, flags);
+    return mode;
 }
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include <sync.h>
+#include <hardwarecomms/pit.h>
+
+/// @brief initializes an unlocked mutex
+/// @param mutex 
+/// @param name shown by the locks command, 0 to leave it out
+void mutex_init(mutex_t* mutex, const char* name)
+{
+    mutex->owner = 0;
+    mutex->depth = 0;
+    wait_queue_init(&mutex->waiters);
+    mutex->stats = (lock_stats_t) LOCK_STATS_INIT(name);
+}
+
+/// @brief takes a free mutex for a task, true if the task holds it afterwards
+/// @param mutex 
+/// @param self 
+static inline bool mutex_try_acquire(mutex_t* mutex, task_t* self)
+{
+    return mutex->owner == self || __sync_bool_compare_and_swap(&mutex->owner, 0, self);
+}
+
+/// @brief takes the mutex, sleeping while another task holds it
+/// @param mutex 
+void mutex_lock(mutex_t* mutex)
+{
+    uint32_t flags = irq_save();
+    task_t* self = get_current_task();
+    if (mutex->owner == self) {
+        mutex->depth++;
+        irq_restore(flags);
+        return;
+    }
+
+    if (!__sync_bool_compare_and_swap(&mutex->owner, 0, self)) {
+        uint64_t start = rdtsc();
+        wait_event(&mutex->waiters, mutex_try_acquire(mutex, self));
+        mutex->stats.contended++;
+        mutex->stats.wait_cycles += rdtsc() - start;
+    }
+    mutex->depth = 1;
+    lock_stats_acquired(&mutex->stats);
+    irq_restore(flags);
+}
+
+/// @brief takes the mutex only if nobody else holds it
+/// @param mutex 
+/// @return true if it was taken
+bool mutex_trylock(mutex_t* mutex)
+{
+    uint32_t flags = irq_save();
+    task_t* self = get_current_task();
+    bool taken = mutex_try_acquire(mutex, self);
+    if (taken && mutex->depth++ == 0)
+        lock_stats_acquired(&mutex->stats);
+    irq_restore(flags);
+    return taken;
+}
+
+/// @brief releases the mutex once every lock by the owner was undone
+/// @param mutex 
+void mutex_unlock(mutex_t* mutex)
+{
+    if (--mutex->depth)
+        return;
+    __sync_synchronize();
+    mutex->owner = 0;
+    wake_one(&mutex->waiters);
+}
+
+/// @brief initializes a semaphore
+/// @param sem 
+/// @param name shown by the locks command, 0 to leave it out
+/// @param count the amount of downs that dont block
+void semaphore_init(semaphore_t* sem, const char* name, int32_t count)
+{
+    sem->count = count;
+    wait_queue_init(&sem->waiters);
+    sem->stats = (lock_stats_t) LOCK_STATS_INIT(name);
+}
+
+/// @brief takes one from the count if it is positive
+/// @param sem 
+/// @return true if it was taken
+bool semaphore_trydown(semaphore_t* sem)
+{
+    int32_t count;
+    do {
+        count = sem->count;
+        if (count <= 0)
+            return false;
+    } while (!__sync_bool_compare_and_swap(&sem->count, count, count - 1));
+    return true;
+}
+
+/// @brief takes one from the count, sleeping while it is 0
+/// @param sem 
+void semaphore_down(semaphore_t* sem)
+{
+    uint32_t flags = irq_save();
+    if (!semaphore_trydown(sem)) {
+        uint64_t start = rdtsc();
+        bool taken = false;
+        // the condition can run twice, so it must not take twice
+        wait_event(&sem->waiters, taken || (taken = semaphore_trydown(sem)));
+        __sync_fetch_and_add(&sem->stats.contended, 1);
+        __sync_fetch_and_add(&sem->stats.wait_cycles, rdtsc() - start);
+    }
+    // several tasks can hold a semaphore, so the counters need atomics
+    __sync_fetch_and_add(&sem->stats.acquisitions, 1);
+    if (sem->stats.name && !sem->stats.registered)
+        lock_stats_register(&sem->stats);
+    irq_restore(flags);
+}
+
+/// @brief semaphore_down that gives up after a while
+/// @param sem 
+/// @param ns the longest time to wait, rounded up to timer ticks
+/// @return true if it was taken, false if it timed out
+bool semaphore_down_timeout(semaphore_t* sem, uint64_t ns)
+{
+    uint32_t flags = irq_save();
+    bool taken = semaphore_trydown(sem);
+    if (!taken) {
+        uint64_t start = rdtsc();
+        wait_event_timeout(&sem->waiters, taken || (taken = semaphore_trydown(sem)), ns_to_ticks(ns));
+        __sync_fetch_and_add(&sem->stats.contended, 1);
+        __sync_fetch_and_add(&sem->stats.wait_cycles, rdtsc() - start);
+        // an up may have picked this task just as it timed out, hands it on
+        if (!taken && sem->count > 0)
+            wake_one(&sem->waiters);
+    }
+    if (taken) {
+        __sync_fetch_and_add(&sem->stats.acquisitions, 1);
+        if (sem->stats.name && !sem->stats.registered)
+            lock_stats_register(&sem->stats);
+    }
+    irq_restore(flags);
+    return taken;
+}
+
+/// @brief adds one to the count and wakes a waiter, safe from irq context
+/// @param sem 
+void semaphore_up(semaphore_t* sem)
+{
+    __sync_fetch_and_add(&sem->count, 1);
+    wake_one(&sem->waiters);
+}
+
+/// @brief initializes a completion that didnt happen yet
+/// @param completion 
+void completion_init(completion_t* completion)
+{
+    completion->done = false;
+    wait_queue_init(&completion->waiters);
+}
+
+/// @brief arms a completion again before starting the work it waits for
+/// @param completion 
+void completion_reset(completion_t* completion)
+{
+    completion->done = false;
+}
+
+/// @brief marks the event as happened and wakes every waiter, safe from irq context
+/// @param completion 
+void complete(completion_t* completion)
+{
+    completion->done = true;
+    wake_all(&completion->waiters);
+}
+
+/// @brief sleeps until complete is called
+/// @param completion 
+/// @param ns the longest time to wait, rounded up to timer ticks
+/// @return false if it timed out
+bool wait_for_completion_timeout(completion_t* completion, uint64_t ns)
+{
+    uint32_t flags = irq_save();
+    bool done = wait_event_timeout(&completion->waiters, completion->done, ns_to_ticks(ns));
+    irq_restore(flags);
+    return done;
+}
@@ -1,39 +1,211 @@
+#include <syscalls.h>
+#include <syscallnums.h>
 #include <multitasking.h>
 #include <io/screen.h>
 #include <stdout.h>
 #include <filesystem/fat.h>
 #include <common/str.h>
 #include <memorymanagement.h>
+#include <gdtdesc.h>
+#include <hardwarecomms/cpu.h>
+#include <common/iovec.h>
+#include <common/tools.h>
+#include <filesystem/fsring.h>
+#include <userinter/syscall.h>
+
+#define IA32_SYSENTER_CS 0x174
+#define IA32_SYSENTER_ESP 0x175
+#define IA32_SYSENTER_EIP 0x176
+
+extern void sysenter_entry();
+
+/// @brief does nothing, used to measure the entry cost
+uint32_t sys_nop(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4) {
+    (void) arg0; (void) arg1; (void) arg2; (void) arg3; (void) arg4;
+    return 0;
+}
+
+/// @brief sets stdout back to the screen
+uint32_t sys_stdout_screen(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4) {
+    (void) arg0; (void) arg1; (void) arg2; (void) arg3; (void) arg4;
+    set_stdout_to_terminal();
+    return 0;
+}
+
+/// @brief redirects stdout to a file
+/// @param arg0 dir path
+/// @param arg1 file name
+/// @param arg2 partition descriptor
+/// @param arg3 the block device
+/// @param arg4 whether to rewrite the file
+uint32_t sys_stdout_file(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4) {
+    set_stdout_to_file((char*) arg0, (char*) arg1,  (partition_descr*) arg2, (block_device*) arg3, (bool) arg4);
+    return 0;
+}
+
 /// @brief writes data to stdout
-/// @param data data buff
-/// @param size the size of the data
-void sys_write(char* data, size_t size) {
-    stdout_desc stdout = get_stdout();
-    if(stdout.mode == STDOUT_SCREEN) {
+/// @param arg0 data buff
+/// @param arg1 the size of the data
+uint32_t sys_write(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4) {
+    (void) arg2; (void) arg3; (void) arg4;
+    char* data = (char*) arg0;
+    size_t size = arg1;
+    stdout_desc stdout;
+    if(get_stdout_for_write(&stdout) == STDOUT_SCREEN) {
         terminal_write(data, size);
     } else {
         write_to_file(stdout.hd, stdout.dirPath, stdout.fileName, data, size, stdout.rewrite, stdout.part_desc);
-        set_stdout_rewrite(false);
     }
+    return 0;
+}
+
+/// @brief writes several segments to stdout with a single screen write or file append
+/// @param arg0 pointer to an array of iovec_t
+/// @param arg1 amount of segments, at most IOV_MAX
+/// @return the amount of bytes written
+uint32_t sys_writev(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4) {
+    (void) arg2; (void) arg3; (void) arg4;
+    iovec_t* iov = (iovec_t*) arg0;
+    uint32_t count = arg1 > IOV_MAX ? IOV_MAX : arg1;
+
+    size_t total = 0;
+    for (uint32_t i = 0; i < count; i++)
+        total += iov[i].len;
+    if (total == 0)
+        return 0;
+
+    stdout_desc stdout;
+    if(get_stdout_for_write(&stdout) == STDOUT_SCREEN) {
+        for (uint32_t i = 0; i < count; i++)
+            terminal_write(iov[i].base, iov[i].len);
+        return total;
+    }
+
+    // merges the segments so the file is looked up and appended to once
+    char* merged = (char*) malloc(total);
+    if (!merged)
+        return 0;
+    size_t pos = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(merged + pos, iov[i].base, iov[i].len);
+        pos += iov[i].len;
+    }
+    write_to_file(stdout.hd, stdout.dirPath, stdout.fileName, merged, total, stdout.rewrite, stdout.part_desc);
+    free(merged);
+    return total;
+}
+
+/// @brief ends the calling task
+uint32_t sys_exit(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4) {
+    (void) arg0; (void) arg1; (void) arg2; (void) arg3; (void) arg4;
+    task_exit();
+    return 0;
+}
+
+/// @brief registers a filesystem ring
+/// @param arg0 the ring
+/// @param arg1 the block device
+/// @param arg2 partition descriptor
+/// @return the ring slot, -1 if none is free or the memory isnt the task's
+uint32_t sys_fsring_setup(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4) {
+    (void) arg3; (void) arg4;
+    return fsring_setup((fsring_t*) arg0, (block_device*) arg1, (partition_descr*) arg2);
+}
 
+/// @brief rings the doorbell of a filesystem ring
+/// @param arg0 the ring
+/// @return the amount of queued requests, -1 if the task hasnt registered it
+uint32_t sys_fsring_enter(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4) {
+    (void) arg1; (void) arg2; (void) arg3; (void) arg4;
+    return fsring_enter((fsring_t*) arg0);
 }
-/// @brief handles syscall
-/// @param regs the registers of the cpu when the sys was called
-void handle_syscall(registers_t regs) {
-
-    switch (regs.eax)
-    {
-    case 1:
-        set_stdout_to_terminal();
-        break;
-    case 2:
-        set_stdout_to_file((char*) regs.ebx, (char*) regs.ecx,  (partition_descr*) (regs.edx), *((ata_drive*)regs.esi), (bool) regs.edi);
-        break;
-    case 3:
-        sys_write((char*) regs.ebx, regs.ecx);
-        break;
+
+/// @brief unregisters a filesystem ring of the calling task
+/// @param arg0 the ring
+/// @return 0, -1 if the task hasnt registered it
+uint32_t sys_fsring_teardown(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4) {
+    (void) arg1; (void) arg2; (void) arg3; (void) arg4;
+    return fsring_teardown((fsring_t*) arg0);
+}
+
+typedef uint32_t (*syscall_handler_t)(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
+
+#define SYSCALL_TABLE_ENTRY(num, handler, args) [num] = handler,
+syscall_handler_t syscall_table[SYSCALL_COUNT] = {
+    SYSCALL_LIST(SYSCALL_TABLE_ENTRY)
+};
+
+#define SYSCALL_NAME_ENTRY(num, handler, args) [num] = #handler,
+const char* syscall_names[SYSCALL_COUNT] = {
+    SYSCALL_LIST(SYSCALL_NAME_ENTRY)
+};
+
+#define SYSCALL_ARGS_ENTRY(num, handler, args) [num] = args,
+const uint8_t syscall_arg_counts[SYSCALL_COUNT] = {
+    SYSCALL_LIST(SYSCALL_ARGS_ENTRY)
+};
+
+syscall_stats_t syscall_stats[SYSCALL_COUNT];
+
+/// @brief runs the requested syscall, shared by both entry paths
+/// @param num the syscall number
+/// @return the value handed back to the caller in eax
+uint32_t syscall_dispatch(uint32_t num, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4) {
+    if (num >= SYSCALL_COUNT)
+        return (uint32_t) -1;
+
+    // counted before the call, exit never returns
+    syscall_stats[num].calls++;
+    uint64_t start = rdtsc();
+    uint32_t ret = syscall_table[num](arg0, arg1, arg2, arg3, arg4);
+    syscall_stats[num].cycles += rdtsc() - start;
+    return ret;
+}
+
+/// @brief handles a syscall entered through int 0x80
+/// @param regs the registers of the cpu when the sys was called, eax gets the return value
+void handle_syscall(registers_t* regs) {
+    regs->eax = syscall_dispatch(regs->eax, regs->ebx, regs->ecx, regs->edx, regs->esi, regs->edi);
+}
+
+/// @brief handles a syscall entered through sysenter, only takes three arguments
+/// @param num the syscall number
+/// @return the value handed back to the caller in eax, -1 for calls that take more arguments
+uint32_t handle_fast_syscall(uint32_t num, uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+    // the missing arguments would reach the handler as zeros
+    if (num < SYSCALL_COUNT && syscall_arg_counts[num] > SYSCALL_FAST_MAX_ARGS)
+        return (uint32_t) -1;
+    // sysenter only comes from ring 3
+    account_kernel_entry();
+    uint32_t result = syscall_dispatch(num, arg0, arg1, arg2, 0, 0);
+    account_kernel_exit();
+    return result;
+}
+
+/// @brief returns the name of a syscall
+/// @param num the syscall number
+const char* syscall_name(uint32_t num) {
+    return num < SYSCALL_COUNT ? syscall_names[num] : "unknown";
+}
+
+/// @brief returns the call count and time spent in a syscall
+/// @param num the syscall number
+syscall_stats_t syscall_get_stats(uint32_t num) {
+    syscall_stats_t empty = {0};
+    return num < SYSCALL_COUNT ? syscall_stats[num] : empty;
+}
+
+/// @brief sets up the sysenter msrs if the cpu supports them
+void syscall_fast_init() {
+    if (!cpu_has_sysenter())
+        return;
     
-    default:
-        break;
-    }
-}
\ No newline at end of file
+    // sysenter loads ss = cs + 8, sysexit uses cs + 16 and cs + 24 for ring 3,
+    // which matches the gdt layout
+    wrmsr(IA32_SYSENTER_CS, KERNEL_CS);
+    // the entry stub reads the kernel stack out of the tss, so task switches
+    // dont need to rewrite this msr
+    wrmsr(IA32_SYSENTER_ESP, (uint32_t) get_tss_esp0_ptr());
+    wrmsr(IA32_SYSENTER_EIP, (uint32_t) sysenter_entry);
+    sysenter_supported = true;
+}
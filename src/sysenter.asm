@@ -0,0 +1,26 @@
+; fast syscall entry, reached by sysenter from ring 3
+; eax = syscall number, ebx, esi, edi = arguments
+; ecx = user esp, edx = user return eip, both needed by sysexit
+extern handle_fast_syscall
+global sysenter_entry
+sysenter_entry:
+	; IA32_SYSENTER_ESP points at tss.esp0, which holds the kernel stack
+	; of the running task
+	mov esp, [esp]
+
+	push ecx
+	push edx
+
+	push edi
+	push esi
+	push ebx
+	push eax
+	call handle_fast_syscall
+	add esp, 16
+
+	pop edx
+	pop ecx
+
+	; sysenter cleared IF, sti only takes effect after sysexit
+	sti
+	sysexit
@@ -0,0 +1,202 @@
+#include <timer.h>
+#include <hardwarecomms/pit.h>
+#include <hardwarecomms/softirq.h>
+#include <spinlock.h>
+
+// a hierarchical wheel, the first level has a slot per tick and every
+// level above it a slot per full turn of the one below. a timer sits in
+// the level its distance fits into and moves down a level whenever the
+// level below wraps, so adding and canceling never search
+#define TVR_BITS 8
+#define TVN_BITS 6
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVN_SIZE (1 << TVN_BITS)
+#define TVR_MASK (TVR_SIZE - 1)
+#define TVN_MASK (TVN_SIZE - 1)
+#define TVN_LEVELS 4
+
+// the slot of level n + 1 that covers the tick
+#define TVN_INDEX(tick, n) (((tick) >> (TVR_BITS + (n) * TVN_BITS)) & TVN_MASK)
+
+void run_timers(uint32_t data);
+
+ktimer_t* tv1[TVR_SIZE];
+ktimer_t* tvn[TVN_LEVELS][TVN_SIZE];
+uint32_t timer_jiffies = 0; // the next tick the wheel hasnt ran yet
+volatile uint32_t active_timers = 0;
+ktimer_t* volatile running_timer = 0; // its callback is running right now
+spinlock_t timer_lock = SPINLOCK_INIT("timers");
+tasklet_t timer_tasklet = { .func = run_timers, .data = 0, .scheduled = false, .next = 0 };
+
+/// @brief links a timer at the head of a slot
+/// @param timer 
+/// @param slot 
+static inline void slot_insert(ktimer_t* timer, ktimer_t** slot)
+{
+    timer->next = *slot;
+    if (*slot)
+        (*slot)->pprev = &timer->next;
+    timer->pprev = slot;
+    *slot = timer;
+}
+
+/// @brief unlinks a pending timer from whatever list it is on
+/// @param timer 
+static inline void slot_remove(ktimer_t* timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next)
+        timer->next->pprev = timer->pprev;
+    timer->next = 0;
+    timer->pprev = 0;
+}
+
+/// @brief puts a timer in the slot matching its distance from timer_jiffies,
+/// the timer lock must be held
+/// @param timer 
+void wheel_insert(ktimer_t* timer)
+{
+    uint32_t expires = timer->expires;
+    uint32_t distance = expires - timer_jiffies;
+
+    if (time_before(expires, timer_jiffies)) {
+        // already due, runs on the next tick the wheel handles
+        slot_insert(timer, &tv1[timer_jiffies & TVR_MASK]);
+    } else if (distance < TVR_SIZE) {
+        slot_insert(timer, &tv1[expires & TVR_MASK]);
+    } else {
+        int level = 0;
+        while (level < TVN_LEVELS - 1 && distance >= (1U << (TVR_BITS + (level + 1) * TVN_BITS)))
+            level++;
+        slot_insert(timer, &tvn[level][TVN_INDEX(expires, level)]);
+    }
+}
+
+/// @brief moves the timers of one upper slot down to the levels below
+/// @param level 
+/// @param index 
+/// @return the index, 0 means the level wrapped and the next one cascades too
+uint32_t cascade(int level, uint32_t index)
+{
+    ktimer_t* list = tvn[level][index];
+    tvn[level][index] = 0;
+    while (list) {
+        ktimer_t* timer = list;
+        list = timer->next;
+        wheel_insert(timer);
+    }
+    return index;
+}
+
+/// @brief sets up a timer that isnt pending
+/// @param timer 
+/// @param func ran from the timer bottom half with interrupts on
+/// @param data passed to func
+void timer_init(ktimer_t* timer, void (*func)(uint32_t), uint32_t data)
+{
+    timer->next = 0;
+    timer->pprev = 0;
+    timer->expires = 0;
+    timer->func = func;
+    timer->data = data;
+}
+
+/// @brief arms a timer, moving it if it was already pending
+/// @param timer 
+/// @param delay ticks from now, 0 fires on the next tick
+void timer_add(ktimer_t* timer, uint32_t delay)
+{
+    uint32_t flags = spin_lock_irqsave(&timer_lock);
+    if (timer->pprev)
+        slot_remove(timer);
+    else
+        active_timers++;
+
+    // the wheel stops turning while empty, catch it up to now
+    if (active_timers == 1)
+        timer_jiffies = get_ticks();
+    timer->expires = get_ticks() + delay;
+    wheel_insert(timer);
+    spin_unlock_irqrestore(&timer_lock, flags);
+}
+
+/// @brief disarms a timer, its callback may still be running on another cpu
+/// @param timer 
+/// @return true if it was pending
+bool timer_cancel(ktimer_t* timer)
+{
+    uint32_t flags = spin_lock_irqsave(&timer_lock);
+    bool pending = timer->pprev != 0;
+    if (pending) {
+        slot_remove(timer);
+        active_timers--;
+    }
+    spin_unlock_irqrestore(&timer_lock, flags);
+    return pending;
+}
+
+/// @brief disarms a timer and waits out a running callback,
+/// after it returns the timer memory can be reused
+/// @param timer 
+/// @return true if it was pending
+bool timer_cancel_sync(ktimer_t* timer)
+{
+    bool pending = timer_cancel(timer);
+    while (running_timer == timer)
+        asm volatile("pause");
+    return pending;
+}
+
+/// @brief checks if a timer is armed
+/// @param timer 
+bool timer_pending(ktimer_t* timer)
+{
+    return timer->pprev != 0;
+}
+
+/// @brief the timer bottom half, runs every tick the wheel is behind on
+/// @param data 
+void run_timers(uint32_t data)
+{
+    (void) data;
+    uint32_t flags = spin_lock_irqsave(&timer_lock);
+    while (active_timers && time_after_eq(get_ticks(), timer_jiffies)) {
+        uint32_t index = timer_jiffies & TVR_MASK;
+        if (index == 0) {
+            for (int level = 0; level < TVN_LEVELS; level++) {
+                if (cascade(level, TVN_INDEX(timer_jiffies, level)) != 0)
+                    break;
+            }
+        }
+        timer_jiffies++;
+
+        // moved to a local list first, a callback rearming for now lands in
+        // the current slot and waits for the next tick instead of looping
+        ktimer_t* expired = 0;
+        if (tv1[index]) {
+            expired = tv1[index];
+            expired->pprev = &expired;
+            tv1[index] = 0;
+        }
+        while (expired) {
+            ktimer_t* timer = expired;
+            slot_remove(timer);
+            active_timers--;
+            running_timer = timer;
+            spin_unlock_irqrestore(&timer_lock, flags);
+
+            timer->func(timer->data);
+
+            flags = spin_lock_irqsave(&timer_lock);
+            running_timer = 0;
+        }
+    }
+    spin_unlock_irqrestore(&timer_lock, flags);
+}
+
+/// @brief called on every timer interrupt of the boot cpu
+void timer_tick(void)
+{
+    if (active_timers)
+        tasklet_schedule(&timer_tasklet);
+}
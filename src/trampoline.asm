@@ -0,0 +1,57 @@
+; application processor startup code, copied to TRAMPOLINE_BASE by smp_init.
+; a startup ipi starts the cpu in real mode at that page, so every address
+; used here is relocated by hand instead of by the linker
+TRAMPOLINE_BASE equ 0x8000
+%define REL(label) (TRAMPOLINE_BASE + ((label) - trampoline_start))
+
+global trampoline_start
+global trampoline_end
+global trampoline_stack
+global trampoline_entry
+
+bits 16
+trampoline_start:
+	cli
+	cld
+	xor ax, ax
+	mov ds, ax
+
+	; a minimal flat gdt, ap_main loads the real one
+	lgdt [REL(trampoline_gdt_ptr)]
+	mov eax, cr0
+	or eax, 1
+	mov cr0, eax
+	jmp dword 0x08:REL(trampoline_32)
+
+bits 32
+trampoline_32:
+	mov ax, 0x10
+	mov ds, ax
+	mov es, ax
+	mov fs, ax
+	mov gs, ax
+	mov ss, ax
+
+	mov esp, [REL(trampoline_stack)]
+	mov eax, [REL(trampoline_entry)]
+	call eax
+.hang:
+	cli
+	hlt
+	jmp .hang
+
+align 8
+trampoline_gdt:
+	dq 0
+	dq 0x00CF9A000000FFFF ; ring 0 code
+	dq 0x00CF92000000FFFF ; ring 0 data
+trampoline_gdt_ptr:
+	dw trampoline_gdt_ptr - trampoline_gdt - 1
+	dd REL(trampoline_gdt)
+
+; filled in by smp_init before each startup ipi
+trampoline_stack:
+	dd 0
+trampoline_entry:
+	dd 0
+trampoline_end:
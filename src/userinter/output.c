@@ -1,14 +1,21 @@
 #include <userinter/output.h>
 #include <common/str.h>
 #include <common/tools.h>
+#include <userinter/syscall.h>
 
 /// @brief prints specifed data to stdout
 /// @param data the buffer containing the data
 /// @param size the size of the data
 void print(char* data, int size) {
-    asm("int $0x80" : : "a" (3), "b" (data), "c" (size));
+    syscall(SYS_WRITE, (uint32_t) data, size, 0);
 }
 
+/// @brief prints several buffers to stdout with one syscall
+/// @param iov the buffers
+/// @param count the amount of buffers, at most IOV_MAX
+void print_v(iovec_t* iov, int count) {
+    syscall(SYS_WRITEV, (uint32_t) iov, count, 0);
+}
 
 /// @brief prints the specfied string using syscall
 /// @param str 
@@ -32,11 +39,12 @@ void print_int(int i, int base)
 /// @param part_desc 
 /// @param hd 
 /// @param rewrite to rewrite or addon
-void change_stdout_to_file(char* dirPath, char* fileName, partition_descr* part_desc, ata_drive hd, bool rewrite) {
-    asm("int $0x80" : : "a" (2), "b" (dirPath), "c" (fileName), "d" (part_desc), "S" (&hd), "D" (rewrite));
+void change_stdout_to_file(char* dirPath, char* fileName, partition_descr* part_desc, block_device* hd, bool rewrite) {
+    // takes five arguments, more than the sysenter path passes
+    asm("int $0x80" : : "a" (SYS_STDOUT_FILE), "b" (dirPath), "c" (fileName), "d" (part_desc), "S" (hd), "D" (rewrite));
 }
 
 /// @brief changes stdout to screen
 void change_stdout_to_screen() {
-    asm("int $0x80" : : "a" (1));
+    syscall(SYS_STDOUT_SCREEN, 0, 0, 0);
 }
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include <userinter/ringtest.h>
+#include <userinter/syscall.h>
+#include <userinter/output.h>
+#include <common/tools.h>
+#include <common/str.h>
+#include <multitasking.h>
+#define RINGTEST_FILE "RINGTEST.TXT"
+#define RINGTEST_TIMEOUT_MS 5000
+
+// in the kernel's shared memory, where the fsring worker can reach it
+fsring_t ringtest_ring;
+char ringtest_data[] = "written and read back through the filesystem ring\n";
+char ringtest_check[sizeof(ringtest_data)];
+fat_stat_t ringtest_stat;
+
+/// @brief queues one request on the test ring
+/// @param opcode 
+/// @param flags 
+/// @param buff 
+/// @param len 
+void ringtest_queue(uint8_t opcode, uint8_t flags, void* buff, uint32_t len)
+{
+    fsring_sqe* sqe = fsring_get_sqe(&ringtest_ring);
+    sqe->opcode = opcode;
+    sqe->flags = flags;
+    sqe->dirPath = "";
+    sqe->fileName = RINGTEST_FILE;
+    sqe->buff = buff;
+    sqe->offset = 0;
+    sqe->len = len;
+    sqe->user_data = opcode;
+    fsring_queue_sqe(&ringtest_ring);
+}
+
+/// @brief waits for the next completion and prints it
+/// @param name the request's name
+/// @param expected its user data
+/// @return its result, -1 if it didnt come
+int32_t ringtest_reap(char* name, uint32_t expected)
+{
+    fsring_cqe* cqe;
+    for (int waited = 0; !(cqe = fsring_peek_cqe(&ringtest_ring)); waited++)
+    {
+        if (waited == RINGTEST_TIMEOUT_MS) {
+            print_string(name);
+            print_string(": no completion\n");
+            return -1;
+        }
+        task_sleep(1000000);
+    }
+    int32_t result = cqe->user_data == expected ? cqe->result : -1;
+    fsring_cqe_seen(&ringtest_ring);
+
+    print_string(name);
+    print_int(result, 10);
+    print_string("\n");
+    return result;
+}
+
+/// @brief runs create, write, stat and read through a ring and checks what came back
+/// @param hd 
+/// @param partDesc the partition, RINGTEST_FILE goes in its current dir
+void run_ring_test(block_device* hd, partition_descr* partDesc)
+{
+    if (fsring_register(&ringtest_ring, hd, partDesc) < 0) {
+        print_string("no free ring\n");
+        return;
+    }
+    if (fsring_register(&ringtest_ring, hd, partDesc) >= 0)
+        print_string("ERROR: registered the same ring twice\n");
+
+    // the worker runs them in order, so one doorbell is enough for all four
+    uint32_t len = sizeof(ringtest_data) - 1;
+    memset((unsigned char*) ringtest_check, 0, sizeof(ringtest_check));
+    ringtest_queue(FSRING_OP_CREATE, 0, 0, 0);
+    ringtest_queue(FSRING_OP_WRITE, 0, ringtest_data, len);
+    ringtest_queue(FSRING_OP_STAT, 0, &ringtest_stat, 0);
+    ringtest_queue(FSRING_OP_READ, 0, ringtest_check, len);
+    fsring_submit(&ringtest_ring);
+
+    // create fails when the file is left from an earlier run, the rest still works
+    ringtest_reap("create: ", FSRING_OP_CREATE);
+    bool ok = ringtest_reap("write:  ", FSRING_OP_WRITE) == (int32_t) len;
+    ok = ringtest_reap("stat:   ", FSRING_OP_STAT) == 0 && ok;
+    ok = ringtest_reap("read:   ", FSRING_OP_READ) == (int32_t) len && ok;
+    ok = ok && ringtest_stat.size == len && strcmp(ringtest_data, ringtest_check) == 0;
+
+    if (fsring_unregister(&ringtest_ring) < 0)
+        print_string("ERROR: unregister failed\n");
+    print_string(ok ? "ring test ok\n" : "ring test FAILED\n");
+}
@@ -0,0 +1,169 @@
+#include <userinter/schedbench.h>
+#include <userinter/output.h>
+#include <drivers/serial.h>
+#include <hardwarecomms/cpu.h>
+#include <hardwarecomms/pit.h>
+#include <multitasking.h>
+#include <sync.h>
+#define PINGPONG_ROUNDS 10000
+#define LATENCY_SAMPLES 100
+#define TICK_SAMPLE_MS 200
+#define TICK_GAP_CYCLES 1000 // a gap this long in a tight rdtsc loop was an interrupt
+#define BENCH_STACK_SIZE 4096
+
+uint8_t ping_kstack[BENCH_STACK_SIZE] __attribute__((aligned(16)));
+uint8_t pong_kstack[BENCH_STACK_SIZE] __attribute__((aligned(16)));
+task_t ping_task;
+task_t pong_task;
+// every round ends with both counts back at zero, so the benchmark can rerun
+semaphore_t ping_sem = SEMAPHORE_INIT("ping", 0);
+semaphore_t pong_sem = SEMAPHORE_INIT("pong", 0);
+uint64_t pingpong_cycles;
+volatile bool busy_stop;
+
+/// @brief writes a result line to the screen and COM1
+/// @param name 
+/// @param cycles 
+/// @param unit what the number is per
+void bench_report(const char* name, uint64_t cycles, const char* unit) {
+    uint32_t ns = (uint32_t) cycles_to_ns(cycles);
+
+    serial_write_string(name);
+    serial_write_string(": ");
+    serial_write_int((uint32_t) cycles, 10);
+    serial_write_string(" cycles ");
+    serial_write_int(ns, 10);
+    serial_write_string(" ns ");
+    serial_write_string(unit);
+    serial_write_string("\n");
+
+    print_string((char*) name);
+    print_string(": ");
+    print_int((int) cycles, 10);
+    print_string(" cycles ");
+    print_int((int) ns, 10);
+    print_string(" ns ");
+    print_string((char*) unit);
+    print_string("\n");
+}
+
+void ping_main() {
+    uint64_t start = rdtsc();
+    for (int i = 0; i < PINGPONG_ROUNDS; i++) {
+        semaphore_up(&pong_sem);
+        semaphore_down(&ping_sem);
+    }
+    pingpong_cycles = rdtsc() - start;
+}
+
+void pong_main() {
+    for (int i = 0; i < PINGPONG_ROUNDS; i++) {
+        semaphore_down(&pong_sem);
+        semaphore_up(&ping_sem);
+    }
+}
+
+/// @brief two tasks on one cpu hand a semaphore back and forth,
+/// every handoff is one block, one wakeup and one switch
+void bench_pingpong() {
+    ping_task = create_task((uint32_t) ping_main, 0, (uint32_t) (ping_kstack + BENCH_STACK_SIZE), true);
+    pong_task = create_task((uint32_t) pong_main, 0, (uint32_t) (pong_kstack + BENCH_STACK_SIZE), true);
+    set_task_name(&ping_task, "ping");
+    set_task_name(&pong_task, "pong");
+    // on separate cpus this would time cross cpu wakeups instead
+    ping_task.pinned = pong_task.pinned = true;
+    if (!add_task(&pong_task))
+        return;
+    if (!add_task(&ping_task)) {
+        // lets pong finish on its own
+        for (int i = 0; i < PINGPONG_ROUNDS; i++)
+            semaphore_up(&pong_sem);
+        task_join(&pong_task);
+        return;
+    }
+    task_join(&ping_task);
+    task_join(&pong_task);
+
+    bench_report("switch", pingpong_cycles / (2 * PINGPONG_ROUNDS), "per semaphore handoff");
+}
+
+void busy_main() {
+    while (!busy_stop)
+        asm volatile("pause");
+}
+
+/// @brief times from task_wake to running again for the shell,
+/// while busy lower priority tasks compete for the cpu
+/// @param busy the amount of busy tasks
+void bench_wakeup_latency(int busy) {
+    busy_stop = false;
+    for (int i = 0; i < busy; i++) {
+        task_t* task = spawn_kernel_task(busy_main, TASK_PRIO_DEFAULT);
+        if (task)
+            set_task_name(task, "busy");
+    }
+
+    task_t* self = get_current_task();
+    uint64_t total = 0;
+    uint64_t worst = 0;
+    for (int i = 0; i < LATENCY_SAMPLES; i++) {
+        task_sleep(1000000);
+        uint64_t latency = rdtsc() - self->wake_stamp;
+        total += latency;
+        if (latency > worst)
+            worst = latency;
+    }
+    busy_stop = true;
+
+    char name[32] = "wakeup, busy tasks ";
+    name[19] = '0' + busy % 10;
+    name[20] = 0;
+    bench_report(name, total / LATENCY_SAMPLES, "average");
+    bench_report(name, worst, "worst");
+}
+
+/// @brief spins on the tsc and counts the holes interrupts leave in it
+void bench_tick_overhead() {
+    uint64_t window = (uint64_t) get_tsc_khz() * TICK_SAMPLE_MS;
+    uint64_t start = rdtsc();
+    uint64_t prev = start;
+    uint64_t stolen = 0;
+    uint32_t gaps = 0;
+    while (prev - start < window) {
+        uint64_t now = rdtsc();
+        if (now - prev > TICK_GAP_CYCLES) {
+            stolen += now - prev;
+            gaps++;
+        }
+        prev = now;
+    }
+
+    if (gaps == 0) {
+        print_string("tick: no interrupts seen\n");
+        return;
+    }
+    bench_report("tick", stolen / gaps, "per interrupt");
+    serial_write_string("tick: ");
+    serial_write_int(gaps, 10);
+    serial_write_string(" interrupts, ");
+    serial_write_int((uint32_t) (stolen * 10000 / window), 10);
+    serial_write_string(" / 10000 of the cpu\n");
+}
+
+/// @brief runs the scheduler benchmarks, results go to the screen and COM1
+void run_sched_bench() {
+    if (get_tsc_khz() == 0) {
+        print_string("tsc not calibrated\n");
+        return;
+    }
+    serial_write_string("schedbench: tsc ");
+    serial_write_int(get_tsc_khz(), 10);
+    serial_write_string(" khz\n");
+
+    bench_pingpong();
+    bench_wakeup_latency(0);
+    bench_wakeup_latency(1);
+    bench_wakeup_latency(4);
+    bench_wakeup_latency(8);
+    bench_tick_overhead();
+}
@@ -1,14 +1,25 @@
 #include <userinter/shell.h>
 #include <userinter/output.h>
+#include <userinter/sysbench.h>
+#include <userinter/schedbench.h>
+#include <userinter/ringtest.h>
+#include <syscalls.h>
+#include <syscallnums.h>
 #include <io/screen.h>
 #include <drivers/keyboard.h>
 #include <filesystem/fat.h>
 #include <common/str.h>
 #include <memorymanagement.h>
+#include <spinlock.h>
+#include <common/tools.h>
+#include <multitasking.h>
+#include <elf.h>
+#include <drivers/blkqueue.h>
+#include <drivers/virtioblk.h>
 #define INPUTBUFFERSIZE 512
 #define TOKENBUFFSIZE 64
 
-ata_drive hd;
+block_device* hd;
 partition_descr *partDesc;
 
 void output_write(char* line) {
@@ -16,16 +27,21 @@ void output_write(char* line) {
 }
 
 void output_write_line(char* line) {
-    print_string(line);
-    print_string("\n");
+    iovec_t iov[] = {
+        { line, strlen(line) },
+        { "\n", 1 },
+    };
+    print_v(iov, 2);
 }
 
 /// @brief outputs the prompt
 void output_prompt() {
-    output_write_line("");
-    output_write("WavOS:");
-    output_write(partDesc->CWDString);
-    output_write("> ");
+    iovec_t iov[] = {
+        { "\nWavOS:", 7 },
+        { partDesc->CWDString, strlen(partDesc->CWDString) },
+        { "> ", 2 },
+    };
+    print_v(iov, 3);
 }
 
 /// @brief splits fileName from path
@@ -104,8 +120,16 @@ void cmd_help() {
     output_write_line("  rmdir <dir>  - Delete a directory");
     output_write_line("  touch <file> - Create an empty file");
     output_write_line("  cat <file>   - Show contents of a file");
+    output_write_line("  exec <file>  - Run an ELF program and wait for it");
     output_write_line("  echo <text>  - Print text");
     output_write_line("  rm <file>    - Delete a file");
+    output_write_line("  sysbench     - Time int 0x80 against sysenter");
+    output_write_line("  schedbench   - Time switches, wakeups and ticks, also to COM1");
+    output_write_line("  sysstat      - Show syscall counts and time spent");
+    output_write_line("  locks        - Show lock contention");
+    output_write_line("  top          - Show cpu use per task since the last top");
+    output_write_line("  blkstat      - Show merges and seeks of the disk queue, exits of virtio disks");
+    output_write_line("  ringtest     - Create, write, stat and read a file through an fsring");
     
 }
 
@@ -228,6 +252,30 @@ void cmd_cat(int argc, char** argv) {
     }
 }
 
+/// @brief runs a program from the filesystem
+/// @param argc 
+/// @param argv 
+void cmd_exec(int argc, char** argv) {
+    if (argc < 2) {
+        output_write_line("Usage: exec <file path>");
+        return;
+    }
+
+    bool ok;
+    char* fileName = split_path(argv[1]);
+    if(strcmp(fileName, argv[1])) {
+        if(*(argv[1])) { // if first char was /
+            ok = elf_exec(hd, argv[1], fileName, partDesc);
+        } else {
+            ok = elf_exec(hd, "/", fileName, partDesc);
+        }
+    } else {
+        ok = elf_exec(hd, "", argv[1], partDesc);
+    }
+    if (!ok)
+        output_write_line("exec: not an executable or out of memory");
+}
+
 /// @brief creates a new file
 /// @param argc 
 /// @param argv 
@@ -249,12 +297,123 @@ void cmd_touch(int argc, char** argv) {
 }
 
 
+/// @brief writes the call count and cycles spent per syscall
+void cmd_sysstat() {
+    output_write_line("syscall              calls      kcycles    avg cycles");
+    for (uint32_t num = 0; num < SYSCALL_COUNT; num++) {
+        syscall_stats_t stats = syscall_get_stats(num);
+        const char* name = syscall_name(num);
+        output_write((char*) name);
+        for (int i = strlen(name); i < 21; i++)
+            output_write(" ");
+        print_int(stats.calls, 10);
+        output_write("    ");
+        print_int((int) (stats.cycles / 1000), 10);
+        output_write("    ");
+        print_int(stats.calls ? (int) (stats.cycles / stats.calls) : 0, 10);
+        output_write("\n");
+    }
+}
+
+/// @brief prints the counters of every named lock that was taken
+void cmd_locks() {
+    output_write_line("lock                 acquired   contended  wait kcycles");
+    for (lock_stats_t* stats = lock_stats_first(); stats; stats = stats->next) {
+        output_write((char*) stats->name);
+        for (int i = strlen(stats->name); i < 21; i++)
+            output_write(" ");
+        print_int(stats->acquisitions, 10);
+        output_write("    ");
+        print_int(stats->contended, 10);
+        output_write("    ");
+        print_int((int) (stats->wait_cycles / 1000), 10);
+        output_write("\n");
+    }
+}
+
+/// @brief prints the counters of the drive's request queue
+void cmd_blkstat() {
+    blk_stats_t stats = blk_get_stats(hd);
+    output_write("requests: ");
+    print_int(stats.submitted, 10);
+    output_write("\nmerged:   ");
+    print_int(stats.merged, 10);
+    output_write("\ncommands: ");
+    print_int(stats.dispatched, 10);
+    output_write("\nexpired:  ");
+    print_int(stats.expired, 10);
+    output_write("\navg seek: ");
+    print_int(stats.dispatched ? (int) (stats.seekDistance / stats.dispatched) : 0, 10);
+    output_write(" sectors\n");
+
+    // virtio disks skip the queue, what counts there is exits per request
+    virtio_blk_stats_t virtio = virtio_blk_get_stats(hd);
+    if (virtio.requests) {
+        output_write("virtio requests:   ");
+        print_int(virtio.requests, 10);
+        output_write("\nvirtio notifies:   ");
+        print_int(virtio.notifies, 10);
+        output_write("\nvirtio interrupts: ");
+        print_int(virtio.interrupts, 10);
+        output_write("\n");
+    }
+}
+
+/// @brief writes text left aligned in a column
+/// @param text 
+/// @param width 
+void output_column(const char* text, int width) {
+    output_write((char*) text);
+    for (int i = strlen(text); i < width; i++)
+        output_write(" ");
+}
+
+/// @brief writes a number left aligned in a column
+/// @param value 
+/// @param width 
+void output_int_column(int value, int width) {
+    char buf[16];
+    itoa(value, buf, 10);
+    output_column(buf, width);
+}
+
+#define TOP_MAX_TASKS 64
+task_info_t top_tasks[TOP_MAX_TASKS];
+
+/// @brief shows the cpu share of every task since the previous top
+void cmd_top() {
+    static const char* state_names[] = { "run", "ready", "block", "dead" };
+    int count = task_snapshot(top_tasks, TOP_MAX_TASKS);
+
+    uint64_t window = 0;
+    for (int i = 0; i < count; i++)
+        window += top_tasks[i].window_cycles;
+    if (window == 0)
+        window = 1;
+
+    output_write_line("id   name        state  pri cpu  %cpu  user Mcyc  kern Mcyc  vcsw     ivcsw");
+    for (int i = 0; i < count; i++) {
+        task_info_t* info = &top_tasks[i];
+        output_int_column(info->id, 5);
+        output_column(info->name, 12);
+        output_column(state_names[info->state], 7);
+        output_int_column(info->priority, 4);
+        output_int_column(info->cpu, 5);
+        output_int_column((int) (info->window_cycles * 100 / window), 6);
+        output_int_column((int) (info->user_cycles / 1000000), 11);
+        output_int_column((int) (info->kernel_cycles / 1000000), 11);
+        output_int_column(info->voluntary_switches, 9);
+        output_int_column(info->involuntary_switches, 0);
+        output_write("\n");
+    }
+}
+
 /// @brief clears screen
 void cmd_clear() {
     terminal_init();
 }
 
-void start_shell(ata_drive hardDrive, partition_descr *partDescriptor) {
+void start_shell(block_device* hardDrive, partition_descr *partDescriptor) {
     hd = hardDrive;
     partDesc = partDescriptor;
     bool cont = true;
@@ -335,12 +494,28 @@ void start_shell(ata_drive hardDrive, partition_descr *partDescriptor) {
             terminal_init();
         } else if (strcmp(args[0], "echo") == 0) {
             cmd_echo(argc, args);
+        } else if (strcmp(args[0], "exec") == 0) {
+            cmd_exec(argc, args);
         } else if (strcmp(args[0], "cat") == 0) {
             cmd_cat(argc, args);
         } else if (strcmp(args[0], "touch") == 0) {
             cmd_touch(argc, args);
         } else if (strcmp(args[0], "clear") == 0) {
             cmd_clear();
+        } else if (strcmp(args[0], "sysbench") == 0) {
+            run_syscall_bench();
+        } else if (strcmp(args[0], "schedbench") == 0) {
+            run_sched_bench();
+        } else if (strcmp(args[0], "sysstat") == 0) {
+            cmd_sysstat();
+        } else if (strcmp(args[0], "locks") == 0) {
+            cmd_locks();
+        } else if (strcmp(args[0], "top") == 0) {
+            cmd_top();
+        } else if (strcmp(args[0], "blkstat") == 0) {
+            cmd_blkstat();
+        } else if (strcmp(args[0], "ringtest") == 0) {
+            run_ring_test(hd, partDesc);
         } else {
             output_write("Unknown command: ");
             output_write_line(args[0]);
@@ -0,0 +1,53 @@
+#include <userinter/sysbench.h>
+#include <userinter/syscall.h>
+#include <userinter/output.h>
+#include <hardwarecomms/cpu.h>
+#include <multitasking.h>
+#include <paging.h>
+#define BENCH_ROUNDS 10000
+#define BENCH_STACK_SIZE 4096
+
+uint8_t bench_kstack[BENCH_STACK_SIZE] __attribute__((aligned(16)));
+uint8_t bench_ustack[BENCH_STACK_SIZE] USER_DATA __attribute__((aligned(16)));
+task_t bench_task;
+
+/// @brief prints the average round trip of a syscall path
+/// @param name the name of the path
+/// @param cycles total cycles spent in BENCH_ROUNDS calls
+void print_bench_result(char* name, uint64_t cycles) {
+    print_string(name);
+    print_int((int) (cycles / BENCH_ROUNDS), 10);
+    print_string(" cycles per call\n");
+}
+
+/// @brief runs in ring 3, times empty syscalls through both entry paths
+void syscall_bench_task() {
+    bool fast = syscall_fast_usable();
+    uint64_t start = rdtsc();
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+        syscall_int(SYS_NOP, 0, 0, 0);
+    print_bench_result("int 0x80: ", rdtsc() - start);
+
+    if (fast) {
+        start = rdtsc();
+        for (int i = 0; i < BENCH_ROUNDS; i++)
+            syscall_fast(SYS_NOP, 0, 0, 0);
+        print_bench_result("sysenter: ", rdtsc() - start);
+    } else {
+        print_string("sysenter: not supported\n");
+    }
+
+    syscall_int(SYS_EXIT, 0, 0, 0);
+}
+
+/// @brief runs the syscall benchmark in a user task and waits for it to finish
+void run_syscall_bench() {
+    bench_task = create_task((uint32_t) syscall_bench_task, (uint32_t) (bench_ustack + BENCH_STACK_SIZE),
+                             (uint32_t) (bench_kstack + BENCH_STACK_SIZE), false);
+    set_task_name(&bench_task, "sysbench");
+    if (!add_task(&bench_task)) {
+        print_string("too many tasks\n");
+        return;
+    }
+    task_join(&bench_task);
+}
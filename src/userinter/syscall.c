@@ -0,0 +1,54 @@
+#include <userinter/syscall.h>
+#include <paging.h>
+
+// set once at boot after the msrs are up, so user mode never has to run cpuid
+bool sysenter_supported USER_DATA = false;
+
+/// @brief checks if the caller can use the sysenter path
+/// @return true if the cpu has sysenter and we are running in ring 3
+bool syscall_fast_usable(void)
+{
+    if (!sysenter_supported)
+        return false;
+
+    uint16_t cs;
+    asm volatile("mov %%cs, %0" : "=r" (cs));
+    return sysenter_supported && ((cs & 3) == 3);
+}
+
+/// @brief enters the kernel through the fastest path available to the caller
+/// @param num the syscall number
+/// @return the value returned by the kernel
+uint32_t syscall(uint32_t num, uint32_t arg0, uint32_t arg1, uint32_t arg2)
+{
+    if (syscall_fast_usable())
+        return syscall_fast(num, arg0, arg1, arg2);
+    return syscall_int(num, arg0, arg1, arg2);
+}
+
+
+/// @brief registers a filesystem ring with the kernel
+/// @param ring 
+/// @param hd the drive its requests go to
+/// @param partDesc the partition its requests go to
+/// @return the ring slot, -1 on failure
+int fsring_register(fsring_t* ring, block_device* hd, partition_descr* partDesc)
+{
+    return (int) syscall(SYS_FSRING_SETUP, (uint32_t) ring, (uint32_t) hd, (uint32_t) partDesc);
+}
+
+/// @brief hands the queued sqes to the kernel, completions show up later
+/// @param ring 
+/// @return the amount of requests waiting in the ring, -1 for a ring the task didnt register
+int fsring_submit(fsring_t* ring)
+{
+    return (int) syscall(SYS_FSRING_ENTER, (uint32_t) ring, 0, 0);
+}
+
+/// @brief unregisters a ring, the kernel doesnt touch it afterwards
+/// @param ring 
+/// @return 0, -1 if it wasnt registered by this task
+int fsring_unregister(fsring_t* ring)
+{
+    return (int) syscall(SYS_FSRING_TEARDOWN, (uint32_t) ring, 0, 0);
+}
@@ -0,0 +1,123 @@
+// runs the kernel's fat code on linux against a disk image, once straight
+// from the file and once from a copy in memory, and times file writes and reads.
+// the file pass modifies the image, use a scratch copy
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <filesystem/fat.h>
+#include <filesystem/msdospart.h>
+#include <drivers/ramdisk.h>
+#include "hostdisk.h"
+
+#define BENCH_FILE "FATBENCH.BIN"
+#define BENCH_CHUNK 4096
+
+/// @brief returns a monotonic time in seconds
+double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/// @brief finds the first fat partition of a disk, a disk without an mbr is one big partition
+/// @param dev 
+/// @param part gets the partition
+/// @return false if there is none
+bool find_partition(block_device* dev, partition_descr* part)
+{
+    partition_descr* parts = read_partitions(dev);
+    printf("\n");
+    for (int i = 0; parts && i < 4; i++)
+    {
+        if (parts[i].bpb.bytesPerSector) {
+            *part = parts[i];
+            free(parts);
+            return true;
+        }
+    }
+    free(parts);
+
+    *part = read_BPB(dev, 0);
+    return part->bpb.bytesPerSector == BLOCK_SECTOR_SIZE;
+}
+
+/// @brief writes a file in chunks, reads it back and deletes it
+/// @param dev 
+/// @param kib the size of the file
+/// @return false if the data read back doesnt match
+bool run_bench(block_device* dev, uint32_t kib)
+{
+    partition_descr part;
+    if (!find_partition(dev, &part)) {
+        printf("%s: no fat partition\n", dev->name);
+        return false;
+    }
+
+    uint32_t size = kib * 1024;
+    uint8_t* data = malloc(size);
+    uint8_t* check = malloc(size);
+    for (uint32_t i = 0; i < size; i++)
+        data[i] = (uint8_t) (i * 7 + i / 512);
+
+    if (is_file_exist(dev, "", BENCH_FILE, &part))
+        delete_file(dev, "", BENCH_FILE, &part);
+    create_file(dev, "", BENCH_FILE, &part);
+
+    double start = now();
+    for (uint32_t done = 0; done < size; done += BENCH_CHUNK)
+        write_to_file(dev, "", BENCH_FILE, (const char*) data + done, BENCH_CHUNK, false, &part);
+    bdev_flush(dev);
+    double written = now();
+    int32_t read = fat_read(dev, "", BENCH_FILE, 0, check, size, &part);
+    double done = now();
+
+    bool ok = read == (int32_t) size;
+    for (uint32_t i = 0; ok && i < size; i++)
+        ok = data[i] == check[i];
+    delete_file(dev, "", BENCH_FILE, &part);
+    bdev_flush(dev);
+
+    printf("%-10s write %8.2f MiB/s  read %8.2f MiB/s  %s\n", dev->name,
+           kib / 1024.0 / (written - start), kib / 1024.0 / (done - written), ok ? "ok" : "MISMATCH");
+    free(data);
+    free(check);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("usage: %s <disk image> [file size in KiB]\n", argv[0]);
+        return 2;
+    }
+    uint32_t kib = argc > 2 ? (uint32_t) atoi(argv[2]) : 4;
+    if (kib == 0 || kib % (BENCH_CHUNK / 1024)) {
+        printf("the size has to be a multiple of %d KiB\n", BENCH_CHUNK / 1024);
+        return 2;
+    }
+
+    block_device* file = hostdisk_open(argv[1]);
+    if (!file) {
+        printf("cant open %s\n", argv[1]);
+        return 1;
+    }
+
+    // the same image in memory, copied before the file pass creates, writes and
+    // deletes BENCH_FILE in the image itself and rewrites its fsinfo
+    uint64_t sectors = bdev_capacity(file);
+    uint8_t* image = malloc(sectors * BLOCK_SECTOR_SIZE);
+    if (!image || !bdev_read(file, 0, sectors, image)) {
+        printf("cant load %s\n", argv[1]);
+        return 1;
+    }
+    block_device* ram = ramdisk_create_from(image, sectors);
+
+    bool ok = run_bench(file, kib);
+    ok = run_bench(ram, kib) && ok;
+
+    ramdisk_destroy(ram);
+    free(image);
+    hostdisk_close(file);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+#include "hostdisk.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// a disk image on the build machine, only built into the host tools
+typedef struct {
+    block_device dev;
+    FILE* file;
+    uint64_t sectors;
+} hostdisk;
+
+/// @brief reads sectors out of the image
+bool hostdisk_read(block_device* dev, uint64_t lba, uint32_t count, uint8_t* buff)
+{
+    hostdisk* disk = (hostdisk*) dev->data;
+    if (fseeko(disk->file, (off_t) (lba * BLOCK_SECTOR_SIZE), SEEK_SET) != 0)
+        return false;
+    return fread(buff, BLOCK_SECTOR_SIZE, count, disk->file) == count;
+}
+
+/// @brief writes sectors into the image, they sit in the stdio buffer until a flush
+bool hostdisk_write(block_device* dev, uint64_t lba, uint32_t count, const uint8_t* data)
+{
+    hostdisk* disk = (hostdisk*) dev->data;
+    if (fseeko(disk->file, (off_t) (lba * BLOCK_SECTOR_SIZE), SEEK_SET) != 0)
+        return false;
+    return fwrite(data, BLOCK_SECTOR_SIZE, count, disk->file) == count;
+}
+
+/// @brief pushes the buffered writes down to the host's disk
+bool hostdisk_flush(block_device* dev)
+{
+    hostdisk* disk = (hostdisk*) dev->data;
+    return fflush(disk->file) == 0 && fsync(fileno(disk->file)) == 0;
+}
+
+uint32_t hostdisk_sector_size(block_device* dev)
+{
+    (void) dev;
+    return BLOCK_SECTOR_SIZE;
+}
+
+uint64_t hostdisk_capacity(block_device* dev)
+{
+    return ((hostdisk*) dev->data)->sectors;
+}
+
+const block_device_ops hostdisk_ops = {
+    .read = hostdisk_read,
+    .write = hostdisk_write,
+    .flush = hostdisk_flush,
+    .sector_size = hostdisk_sector_size,
+    .capacity = hostdisk_capacity,
+};
+
+/// @brief opens a disk image for reading and writing
+/// @param path 
+/// @return the image as a block device, 0 if it cant be opened
+block_device* hostdisk_open(const char* path)
+{
+    FILE* file = fopen(path, "r+b");
+    if (!file)
+        return 0;
+    if (fseeko(file, 0, SEEK_END) != 0) {
+        fclose(file);
+        return 0;
+    }
+
+    hostdisk* disk = (hostdisk*) malloc(sizeof(hostdisk));
+    if (!disk) {
+        fclose(file);
+        return 0;
+    }
+    disk->dev.name = path;
+    disk->dev.ops = &hostdisk_ops;
+    disk->dev.data = disk;
+    disk->file = file;
+    // a trailing partial sector isnt part of the disk
+    disk->sectors = (uint64_t) ftello(file) / BLOCK_SECTOR_SIZE;
+    return &disk->dev;
+}
+
+/// @brief flushes and closes an image
+/// @param dev 
+void hostdisk_close(block_device* dev)
+{
+    hostdisk* disk = (hostdisk*) dev->data;
+    fclose(disk->file);
+    free(disk);
+}
@@ -0,0 +1,7 @@
+#ifndef __WAVOS__TOOLS__HOSTDISK_H
+#define __WAVOS__TOOLS__HOSTDISK_H
+#include <drivers/blockdev.h>
+
+block_device* hostdisk_open(const char* path);
+void hostdisk_close(block_device* dev);
+#endif
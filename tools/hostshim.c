@@ -0,0 +1,41 @@
+// the kernel services the filesystem code calls, for running it as a host program
+#include <stdio.h>
+#include <sync.h>
+#include <common/iovec.h>
+
+/// @brief the host tools are single threaded, the fat lock has nothing to do
+void mutex_lock(mutex_t* mutex)
+{
+    (void) mutex;
+}
+
+void mutex_unlock(mutex_t* mutex)
+{
+    (void) mutex;
+}
+
+void print(char* data, int size)
+{
+    fwrite(data, 1, size, stdout);
+}
+
+void print_v(iovec_t* iov, int count)
+{
+    for (int i = 0; i < count; i++)
+        fwrite(iov[i].base, 1, iov[i].len, stdout);
+}
+
+void print_string(char* str)
+{
+    fputs(str, stdout);
+}
+
+void print_int(int i, int base)
+{
+    printf(base == 16 ? "%x" : "%d", i);
+}
+
+void terminal_write_string(const char* str)
+{
+    fputs(str, stdout);
+}